@@ -0,0 +1,157 @@
+#include "atc2310.h"
+// The internal headers are only included here so that programs using the
+// library only see the API above
+#include "mapper.h"
+#include "control.h"
+
+/**
+ * An in-process mapper2310.
+ * Members:
+ *  - data -> the same data a mapper2310 server keeps, without a port,
+ *      stats or capture
+ */
+struct AtcMapper {
+    Mapper data;
+};
+
+/**
+ * An in-process control2310.
+ * Members:
+ *  - airport -> the same data a control2310 server keeps for an airport,
+ *      without a port, stats or capture
+ */
+struct AtcControl {
+    Airport airport;
+};
+
+/* See atc2310.h */
+AtcMapper* atc_create_mapper(void) {
+    AtcMapper* mapper = calloc(1, sizeof(AtcMapper));
+    if (mapper == NULL) {
+        return NULL;
+    }
+    if (!create_mapper(&mapper->data)) {
+        free(mapper);
+        return NULL;
+    }
+
+    return mapper;
+}
+
+/* See atc2310.h */
+bool atc_add_to_mapper(AtcMapper* mapper, const char* id, int port) {
+    char* checkedId = (char*) id;
+    if (*checkedId == '\0' || string_contains_invalid_char(checkedId) ||
+            port < LOW_PORT || port > HIGH_PORT) {
+        return false;
+    }
+
+    // Requests made in-process aren't counted in the mapper's stats
+    RequestStats request;
+    start_request_stats(&request, MAPPER_ADD);
+    return add_to_mapper(&mapper->data, checkedId, port, &request);
+}
+
+/* See atc2310.h */
+int atc_search_mapper(AtcMapper* mapper, const char* id) {
+    RequestStats request;
+    start_request_stats(&request, MAPPER_SEARCH);
+    int port = search_mapper(&mapper->data, (char*) id, &request);
+
+    return port == REGISTRY_NOT_FOUND ? ATC_NOT_FOUND : port;
+}
+
+/* See atc2310.h */
+char* atc_get_mapper_airports(AtcMapper* mapper) {
+    RequestStats request;
+    start_request_stats(&request, MAPPER_PRINT);
+    RegistryOrderUpdate update = {0};
+    RegistrySnapshot snapshot = {0};
+    bool copied = take_mapper_snapshot(&mapper->data, &update, &snapshot,
+            &request);
+    destroy_registry_order_update(&update);
+    if (!copied) {
+        destroy_registry_snapshot(&snapshot);
+        return NULL;
+    }
+
+    // Each line is the id, the ':', a port of at most 5 digits and '\n'
+    size_t capacity = 1;
+    for (int i = 0; i < snapshot.length; i++) {
+        capacity += strlen(get_snapshot_id(&snapshot, i)) + 7;
+    }
+    char* text = malloc(capacity);
+    size_t length = 0;
+    for (int i = 0; text != NULL && i < snapshot.length; i++) {
+        length += sprintf(text + length, "%s:%d\n",
+                get_snapshot_id(&snapshot, i), snapshot.ports[i]);
+    }
+    destroy_registry_snapshot(&snapshot);
+
+    if (text != NULL) {
+        text[length] = '\0';
+    }
+    return text;
+}
+
+/* See atc2310.h */
+void atc_destroy_mapper(AtcMapper* mapper) {
+    destroy_mapper(&mapper->data);
+    free(mapper);
+}
+
+/* See atc2310.h */
+AtcControl* atc_create_control(const char* id, const char* info) {
+    AtcControl* control = calloc(1, sizeof(AtcControl));
+    if (control == NULL) {
+        return NULL;
+    }
+    if (setup_airport(&control->airport, (char*) id, (char*) info) !=
+            CONTROL_OK) {
+        atc_destroy_control(control);
+        return NULL;
+    }
+
+    return control;
+}
+
+/* See atc2310.h */
+const char* atc_check_in(AtcControl* control, const char* plane) {
+    char* checkedPlane = (char*) plane;
+    if (string_contains_invalid_char(checkedPlane) ||
+            !check_in_to_airport(&control->airport, checkedPlane)) {
+        return NULL;
+    }
+
+    return control->airport.info;
+}
+
+/* See atc2310.h */
+char* atc_get_visitor_log(AtcControl* control) {
+    PlaneNames planes;
+    get_visitor_log(&control->airport, &planes);
+
+    size_t capacity = 1;
+    for (int i = 0; i < planes.length; i++) {
+        capacity += strlen(planes.items[i]) + 1;
+    }
+    char* text = malloc(capacity);
+    size_t length = 0;
+    // As with "log", a log holding only an empty id has no lines
+    bool onlyEmpty = planes.length == 1 && planes.items[0][0] == '\0';
+    for (int i = 0; text != NULL && !onlyEmpty && i < planes.length; i++) {
+        length += sprintf(text + length, "%s\n", planes.items[i]);
+    }
+    destroy_plane_names(&planes);
+
+    if (text != NULL) {
+        text[length] = '\0';
+    }
+    return text;
+}
+
+/* See atc2310.h */
+void atc_destroy_control(AtcControl* control) {
+    destroy_airport(&control->airport);
+    free(control);
+}
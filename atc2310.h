@@ -0,0 +1,121 @@
+#ifndef ATC_2310_H
+#define ATC_2310_H
+
+#include <stdbool.h>
+
+/* Returned by atc_search_mapper when the id isn't mapped */
+#define ATC_NOT_FOUND -1
+/* Marks the functions below as the library's API. Everything else in the
+ * library is built hidden, and kept out of its symbol table */
+#define ATC_API __attribute__((visibility("default")))
+
+/**
+ * libatc2310: mapper2310 and control2310 instances that live inside the
+ * calling process and are queried with function calls instead of over a
+ * socket. They hold their data in the same structures and follow the same
+ * rules as the servers, so co-located services and tests can use them
+ * directly, and benchmarks can measure the structures without any I/O.
+ *
+ * Every function may be called from many threads at once on the same
+ * instance, except that an instance must not be used while, or after, it is
+ * destroyed.
+ */
+
+typedef struct AtcMapper AtcMapper;
+typedef struct AtcControl AtcControl;
+
+/**
+ * Creates an empty in-process mapper.
+ *
+ * Returns:
+ *  - the mapper, which must be freed with atc_destroy_mapper
+ *  - NULL -> if memory for it couldn't be allocated
+ */
+ATC_API AtcMapper* atc_create_mapper(void);
+
+/**
+ * Maps an airport id to a port, as the "!ID:PORT" command does. If the id is
+ * already mapped then the port it already has is kept.
+ *
+ * Parameters:
+ *  - mapper -> the mapper to add to
+ *  - id -> the id of the airport, which is copied
+ *  - port -> the port of the airport
+ *
+ * Returns:
+ *  - true -> if the id was mapped
+ *  - false -> if the id is empty or contains '\n', '\r' or ':', the port is
+ *      out of range, the id was already mapped or memory couldn't be
+ *      allocated
+ */
+ATC_API bool atc_add_to_mapper(AtcMapper* mapper, const char* id, int port);
+
+/**
+ * Gets the port mapped to an airport id, as the "?ID" command does.
+ *
+ * Returns:
+ *  - the port mapped to the id
+ *  - ATC_NOT_FOUND -> if the id isn't mapped
+ */
+ATC_API int atc_search_mapper(AtcMapper* mapper, const char* id);
+
+/**
+ * Gets every mapping as the "@" command prints them: an "ID:PORT" line per
+ * airport, in order of id.
+ *
+ * Returns:
+ *  - the lines, which the caller must free. An empty mapper gives "".
+ *  - NULL -> if memory for them couldn't be allocated
+ */
+ATC_API char* atc_get_mapper_airports(AtcMapper* mapper);
+
+/**
+ * Frees an in-process mapper and everything mapped in it.
+ */
+ATC_API void atc_destroy_mapper(AtcMapper* mapper);
+
+/**
+ * Creates an in-process control with an empty visitor log.
+ *
+ * Parameters:
+ *  - id -> the id of the airport, which is copied
+ *  - info -> the info string given to planes that check in, which is copied
+ *
+ * Returns:
+ *  - the control, which must be freed with atc_destroy_control
+ *  - NULL -> if the id or info contains '\n', '\r' or ':', or memory
+ *      couldn't be allocated
+ */
+ATC_API AtcControl* atc_create_control(const char* id, const char* info);
+
+/**
+ * Checks a plane in to a control, as sending its id to a control2310 does.
+ *
+ * Parameters:
+ *  - control -> the control to check in to
+ *  - plane -> the id of the plane, which is copied into the visitor log
+ *
+ * Returns:
+ *  - the control's info, which belongs to the control
+ *  - NULL -> if the plane's id contains '\n', '\r' or ':', or memory
+ *      couldn't be allocated. The plane isn't logged.
+ */
+ATC_API const char* atc_check_in(AtcControl* control, const char* plane);
+
+/**
+ * Gets the visitor log of a control as the "log" command prints it, without
+ * the final "." line: the id of each plane that has checked in on its own
+ * line, sorted.
+ *
+ * Returns:
+ *  - the lines, which the caller must free. An empty log gives "".
+ *  - NULL -> if memory for them couldn't be allocated
+ */
+ATC_API char* atc_get_visitor_log(AtcControl* control);
+
+/**
+ * Frees an in-process control and its visitor log.
+ */
+ATC_API void atc_destroy_control(AtcControl* control);
+
+#endif
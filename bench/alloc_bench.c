@@ -0,0 +1,246 @@
+#include "benchutil.h"
+#include "../options.h"
+
+/* The number of requests measured when --count isn't given */
+#define DEFAULT_REQUESTS 1000000
+/* The number of requests sent before measuring, so buffers can grow */
+#define WARMUP_REQUESTS 10000
+/* The number of airports registered with the mapper before measuring */
+#define NUM_AIRPORTS 1000
+/* One request in this many to the mapper is a '@' */
+#define PRINT_EVERY 1000
+/* control2310 may allocate at most once per this many check-ins, as blocks
+ * of names fill up */
+#define CHECK_INS_PER_ALLOCATION 1000
+/* The binaries and counting library used when not otherwise given */
+#define DEFAULT_MAPPER "./mapper2310"
+#define DEFAULT_CONTROL "./control2310"
+#define DEFAULT_PRELOAD "./bench/malloccount.so"
+
+/* The servers whose request path can be measured */
+enum AllocServer {
+    ALLOC_MAPPER,
+    ALLOC_CONTROL
+};
+typedef enum AllocServer AllocServer;
+
+/**
+ * Reads a reply line, exiting the benchmark if the server has gone.
+ */
+static void read_reply(Client* client, char* reply) {
+    if (!read_message(client->readFrom, reply)) {
+        bench_fail("Server closed the connection");
+    }
+}
+
+/**
+ * Sends the i'th request of the mapper mix: a '?' for a registered id, a
+ * '!' for an id that's already registered, a '?' for an unknown id, and
+ * every PRINT_EVERY requests a '@'.
+ */
+static void send_mapper_request(Client* client, long i) {
+    char reply[MESSAGE_BUFFER_SIZE];
+    int airport = i % NUM_AIRPORTS;
+    if (i % PRINT_EVERY == 0) {
+        fprintf(client->writeTo, "@\n");
+        fflush(client->writeTo);
+        for (int j = 0; j < NUM_AIRPORTS; j++) {
+            read_reply(client, reply);
+        }
+    } else if (i % 3 == 0) {
+        fprintf(client->writeTo, "?A%d\n", airport);
+        fflush(client->writeTo);
+        read_reply(client, reply);
+    } else if (i % 3 == 1) {
+        fprintf(client->writeTo, "!A%d:%d\n", airport, 1 + airport);
+    } else {
+        fprintf(client->writeTo, "?B%d\n", airport);
+        fflush(client->writeTo);
+        read_reply(client, reply);
+    }
+}
+
+/**
+ * Sends the i'th control2310 check-in and reads its info back.
+ */
+static void send_control_request(Client* client, long i) {
+    char reply[MESSAGE_BUFFER_SIZE];
+    fprintf(client->writeTo, "P%ld\n", i % NUM_AIRPORTS);
+    fflush(client->writeTo);
+    read_reply(client, reply);
+}
+
+/**
+ * Sends the i'th request to the server, over "client" or, if that's NULL,
+ * over a new connection to "port" that is closed once the request is done.
+ */
+static void send_request(AllocServer server, Client* client, char* port,
+        long i) {
+    Client requestClient;
+    if (client == NULL) {
+        if (setup_client_on_port(port, &requestClient) != CLIENT_OK) {
+            bench_fail("Failed to connect to the server");
+        }
+        client = &requestClient;
+    }
+
+    if (server == ALLOC_MAPPER) {
+        send_mapper_request(client, i);
+    } else {
+        send_control_request(client, i);
+    }
+
+    if (client == &requestClient) {
+        fflush(client->writeTo);
+        close_client(client);
+    }
+}
+
+/**
+ * Sends "count" requests to the server, then waits for every one of them to
+ * have been handled. "client" and "port" are as for send_request.
+ */
+static void send_requests(AllocServer server, Client* client, char* port,
+        long start, long count) {
+    for (long i = start; i < start + count; i++) {
+        send_request(server, client, port, i);
+    }
+    // Requests on a connection are handled in order, so once a reply to this
+    // arrives every '!' before it has been handled too
+    if (server == ALLOC_MAPPER) {
+        send_request(server, client, port, 3);
+    }
+}
+
+/**
+ * Reads the server's allocation count.
+ */
+static long long read_count(volatile long long* count) {
+    return __atomic_load_n(count, __ATOMIC_RELAXED);
+}
+
+/**
+ * alloc_bench.
+ *
+ * Starts a mapper2310 or control2310 with malloccount.so preloaded, warms
+ * it up with WARMUP_REQUESTS requests so that every per-connection buffer
+ * has grown, then counts the server's allocations across --count more
+ * requests. mapper2310 gets a mix of '?', duplicate '!' and '@' requests;
+ * control2310 gets check-ins.
+ *
+ * With --connections=persistent (the default) every request is sent on the
+ * same connection. mapper2310 must then not allocate at all, and
+ * control2310 may only allocate when a block of names fills up, at most
+ * once per CHECK_INS_PER_ALLOCATION check-ins; otherwise the benchmark
+ * fails, which is what "make test" checks. With --connections=per-request
+ * every request gets a connection of its own, the way roc2310 and
+ * control2310 send them. Each connection needs its own buffers and thread,
+ * so the allocations per request are only reported.
+ *
+ * Prints a CSV line of: server,requests,allocations,allocations_per_request
+ */
+int main(int argc, char** argv) {
+    Option options[] = {
+        {"count", NULL, false},
+        {"server", NULL, false},
+        {"mapper", NULL, false},
+        {"control", NULL, false},
+        {"preload", NULL, false},
+        {"connections", NULL, false}
+    };
+    parse_options(&argc, &argv, options, 6);
+
+    long count = DEFAULT_REQUESTS;
+    if (options[0].present && !parse_option_long(&options[0], 1,
+            1000000000, &count)) {
+        bench_fail("Invalid count");
+    }
+    char* serverName = options[1].present ? options[1].value : "mapper";
+    AllocServer server;
+    if (strcmp(serverName, "mapper") == 0) {
+        server = ALLOC_MAPPER;
+    } else if (strcmp(serverName, "control") == 0) {
+        server = ALLOC_CONTROL;
+    } else {
+        serverName = NULL;
+    }
+    char* connections = options[5].present ? options[5].value :
+            "persistent";
+    bool perRequest = connections != NULL &&
+            strcmp(connections, "per-request") == 0;
+    if (serverName == NULL || connections == NULL || (!perRequest &&
+            strcmp(connections, "persistent") != 0)) {
+        bench_fail("Usage: alloc_bench [--count=N] [--server=mapper|control]"
+                " [--connections=persistent|per-request] [--mapper=PATH]"
+                " [--control=PATH] [--preload=PATH]");
+    }
+    char* mapperPath = options[2].present ? options[2].value : DEFAULT_MAPPER;
+    char* controlPath = options[3].present ? options[3].value :
+            DEFAULT_CONTROL;
+    char* preload = options[4].present ? options[4].value : DEFAULT_PRELOAD;
+
+    char countPath[] = "/tmp/alloc_bench_XXXXXX";
+    int countFd = mkstemp(countPath);
+    if (countFd < 0) {
+        bench_fail("Couldn't create the count file");
+    }
+    close(countFd);
+
+    setenv("MALLOC_COUNT_FILE", countPath, 1);
+    setenv("LD_PRELOAD", preload, 1);
+    BenchServer benchServer;
+    char* mapperArgs[] = {mapperPath, NULL};
+    char* controlArgs[] = {controlPath, "C", "info", NULL};
+    bool started = start_bench_server(
+            server == ALLOC_MAPPER ? mapperArgs : controlArgs, &benchServer);
+    unsetenv("LD_PRELOAD");
+    unsetenv("MALLOC_COUNT_FILE");
+    if (!started) {
+        bench_fail("Failed to start the server");
+    }
+
+    countFd = open(countPath, O_RDONLY);
+    volatile long long* allocations = countFd < 0 ? MAP_FAILED :
+            mmap(NULL, sizeof(long long), PROT_READ, MAP_SHARED, countFd, 0);
+    unlink(countPath);
+    if (allocations == MAP_FAILED) {
+        stop_bench_server(&benchServer);
+        bench_fail("Couldn't map the count file");
+    }
+
+    Client client;
+    if (setup_client_on_port(benchServer.port, &client) != CLIENT_OK) {
+        stop_bench_server(&benchServer);
+        bench_fail("Failed to connect to the server");
+    }
+    if (server == ALLOC_MAPPER) {
+        for (int i = 0; i < NUM_AIRPORTS; i++) {
+            fprintf(client.writeTo, "!A%d:%d\n", i, 1 + i);
+        }
+        fflush(client.writeTo);
+    }
+    Client* requestClient = perRequest ? NULL : &client;
+    send_requests(server, requestClient, benchServer.port, 0,
+            WARMUP_REQUESTS);
+
+    long long before = read_count(allocations);
+    send_requests(server, requestClient, benchServer.port, WARMUP_REQUESTS,
+            count);
+    long long used = read_count(allocations) - before;
+
+    close_client(&client);
+    stop_bench_server(&benchServer);
+    printf("%s,%ld,%lld,%.6f\n", serverName, count, used,
+            used / (double) count);
+
+    if (perRequest) {
+        return 0;
+    }
+    if (server == ALLOC_MAPPER && used != 0) {
+        bench_fail("mapper2310 allocated on its request path");
+    }
+    if (server == ALLOC_CONTROL && used > count / CHECK_INS_PER_ALLOCATION) {
+        bench_fail("control2310 allocated on too many check-ins");
+    }
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include "benchutil.h"
+
+/* See benchutil.h */
+bool start_bench_server(char** argv, BenchServer* server) {
+    int output[2];
+    if (pipe(output)) {
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        return false;
+    }
+    if (pid == 0) {
+        dup2(output[1], STDOUT_FILENO);
+        close(output[0]);
+        close(output[1]);
+        execv(argv[0], argv);
+        _exit(EXIT_FAILURE);
+    }
+
+    close(output[1]);
+    FILE* from = fdopen(output[0], "r");
+    char line[80] = "";
+    if (fgets(line, sizeof(line), from) == NULL) {
+        fclose(from);
+        return false;
+    }
+    // Leave the pipe open so the server never sees SIGPIPE on stdout
+    line[strcspn(line, "\n")] = '\0';
+    if (!is_valid_port(line)) {
+        return false;
+    }
+
+    server->pid = pid;
+    strcpy(server->port, line);
+    return true;
+}
+
+/* See benchutil.h */
+void stop_bench_server(BenchServer* server) {
+    kill(server->pid, SIGTERM);
+    waitpid(server->pid, NULL, 0);
+}
+
+/* See benchutil.h */
+void bench_fail(char* message) {
+    fprintf(stderr, "%s\n", message);
+    fflush(stderr);
+    exit(EXIT_FAILURE);
+}
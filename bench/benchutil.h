@@ -0,0 +1,56 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "../utils.h"
+#include "../client.h"
+
+/**
+ * A server process (mapper2310 or control2310) started by a benchmark.
+ * Members:
+ *  - pid -> the process id of the server
+ *  - port -> the port the server printed on startup, as a string
+ */
+struct BenchServer {
+    pid_t pid;
+    char port[6];
+};
+typedef struct BenchServer BenchServer;
+
+/**
+ * Starts the program in argv[0] with the given args and waits for it to
+ * print the port it is listening on as its first line of output.
+ *
+ * Parameters:
+ *  - argv -> the NULL terminated args to start the server with
+ *  - server -> where to store the started server's details
+ *
+ * Returns:
+ *  - true -> if the server started and printed its port
+ *  - false -> otherwise
+ */
+bool start_bench_server(char** argv, BenchServer* server);
+
+/**
+ * Kills a server started by start_bench_server and waits for it to exit.
+ */
+void stop_bench_server(BenchServer* server);
+
+/**
+ * Prints a message to stderr and exits with a failure code. Marked noreturn
+ * so optimised builds know nothing after it runs.
+ */
+void bench_fail(char* message) __attribute__((noreturn));
+
+#endif
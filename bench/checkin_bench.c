@@ -0,0 +1,122 @@
+#include <pthread.h>
+
+#include "benchutil.h"
+#include "../list.h"
+#include "../options.h"
+
+/* The number of check-ins made when --count isn't given */
+#define DEFAULT_CHECKINS 4000000
+/* The number of threads checking in when --threads isn't given */
+#define DEFAULT_CHECKIN_THREADS 4
+/* The most threads that may check in at once */
+#define MAX_CHECKIN_THREADS 1024
+
+/**
+ * The visitor log being checked in to, as either a single List (the way
+ * control2310 kept it before) or a ShardedList (the way it keeps it now).
+ */
+struct VisitorLog {
+    bool sharded;
+    List list;
+    ShardedList shardedList;
+    long checkinsPerThread;
+};
+typedef struct VisitorLog VisitorLog;
+
+/**
+ * Checks in to the visitor log the way control2310 does for each roc2310:
+ * copies the plane's name to the heap and adds it to the log.
+ */
+static void* check_in(void* uncastedLog) {
+    VisitorLog* log = (VisitorLog*) uncastedLog;
+    char name[24];
+    for (long i = 0; i < log->checkinsPerThread; i++) {
+        sprintf(name, "P%ld", i);
+        char* copy = calloc(strlen(name) + 1, sizeof(char));
+        strcpy(copy, name);
+        ListError error = log->sharded ?
+                add_sharded_list_item(&log->shardedList, copy) :
+                add_list_item(&log->list, copy);
+        if (error != LIST_OK) {
+            bench_fail("Check-in failed");
+        }
+    }
+    return NULL;
+}
+
+/**
+ * checkin_bench.
+ *
+ * Measures check-in throughput to control2310's visitor log with --threads
+ * threads checking in at once, which is what a busy airport's connection
+ * threads do. --mode=list uses a single List guarded by one semaphore and
+ * --mode=sharded uses a ShardedList with --shards shards (2 per core by
+ * default). The names are then merged back into one array, as for "log".
+ *
+ * Prints a CSV line of:
+ *  mode,threads,count,seconds,checkins_per_second,merge_seconds
+ */
+int main(int argc, char** argv) {
+    Option options[] = {
+        {"threads", NULL, false},
+        {"count", NULL, false},
+        {"mode", NULL, false},
+        {"shards", NULL, false}
+    };
+    parse_options(&argc, &argv, options, 4);
+
+    long numThreads = DEFAULT_CHECKIN_THREADS;
+    long count = DEFAULT_CHECKINS;
+    long numShards = sysconf(_SC_NPROCESSORS_ONLN) * 2;
+    if ((options[0].present && !parse_option_long(&options[0], 1,
+            MAX_CHECKIN_THREADS, &numThreads)) ||
+            (options[1].present && !parse_option_long(&options[1], 1,
+            1000000000, &count)) ||
+            (options[3].present && !parse_option_long(&options[3], 1,
+            MAX_CHECKIN_THREADS, &numShards))) {
+        bench_fail("Invalid number");
+    }
+    char* modeName = options[2].present ? options[2].value : "sharded";
+    VisitorLog log;
+    if (strcmp(modeName, "list") == 0) {
+        log.sharded = false;
+    } else if (strcmp(modeName, "sharded") == 0) {
+        log.sharded = true;
+    } else {
+        bench_fail("Usage: checkin_bench [--threads=N] [--count=N] "
+                "[--mode=list|sharded] [--shards=N]");
+    }
+    create_list(&log.list, sizeof(ListItem), NULL, NULL);
+    create_sharded_list(&log.shardedList, numShards, sizeof(ListItem));
+    log.checkinsPerThread = count / numThreads;
+    count = log.checkinsPerThread * numThreads;
+
+    pthread_t* threads = calloc(numThreads, sizeof(pthread_t));
+    long long start = get_monotonic_ns();
+    for (int i = 0; i < numThreads; i++) {
+        if (pthread_create(&threads[i], NULL, check_in, &log)) {
+            bench_fail("Failed to start thread");
+        }
+    }
+    for (int i = 0; i < numThreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double seconds = (get_monotonic_ns() - start) / (double) NS_PER_SECOND;
+
+    start = get_monotonic_ns();
+    int numItems = log.list.length;
+    if (log.sharded) {
+        ListItem* items;
+        merge_sharded_list(&log.shardedList, &items, &numItems);
+        free(items);
+    }
+    double mergeSeconds = 
+            (get_monotonic_ns() - start) / (double) NS_PER_SECOND;
+    if (numItems != count) {
+        bench_fail("Check-ins went missing");
+    }
+
+    printf("%s,%ld,%ld,%.6f,%.0f,%.6f\n", modeName, numThreads, count,
+            seconds, count / seconds, mergeSeconds);
+    return 0;
+}
@@ -0,0 +1,82 @@
+#!/bin/bash
+#
+# compare.sh
+#
+# Builds each variant of the Makefile (see BUILD in the Makefile) in turn and
+# runs the same benchmarks against it: loadgen2310's default mix against a
+# mapper2310, and microbench's list and parsing primitives. Every result is
+# compared against the first variant. The default build is restored at the
+# end.
+#
+# Usage: bench/compare.sh [-v "VARIANT..."] [-n REQUESTS] [-m MS] [-o OUTPUT]
+#   -v -> the variants to compare (default "debug release lto pgo")
+#   -n -> the number of requests loadgen2310 sends (default 200000)
+#   -m -> how long each microbench measurement runs for (default 200)
+#   -o -> where to write the CSV (default stdout)
+#
+# Prints CSV of: variant,benchmark,metric,value,change_percent
+
+BIN_DIR=$(cd "$(dirname "$0")/.." && pwd)
+VARIANTS="debug release lto pgo"
+REQUESTS=200000
+MEASURE_MS=200
+OUTPUT=/dev/stdout
+MICRO_BENCHMARKS="search_list get_list_as_str parse_id_port"
+MICRO_SIZE=1000
+
+while getopts "v:n:m:o:" option; do
+    case $option in
+        v) VARIANTS=$OPTARG ;;
+        n) REQUESTS=$OPTARG ;;
+        m) MEASURE_MS=$OPTARG ;;
+        o) OUTPUT=$OPTARG ;;
+        *) sed -n '/^# Usage/,/^#   -o/s/^# \{0,1\}//p' "$0" >&2; exit 1 ;;
+    esac
+done
+
+# Builds variant $1 of the servers and the benchmarks run against them
+build_variant() {
+    if [ "$1" = "pgo" ]; then
+        make -s -C "$BIN_DIR" pgo || return 1
+    else
+        make -s -C "$BIN_DIR" BUILD="$1" || return 1
+    fi
+    make -s -C "$BIN_DIR" BUILD="$1" bench/loadgen2310 bench/microbench
+}
+
+# Runs every benchmark, printing "benchmark,metric,value" rows
+run_benchmarks() {
+    "$BIN_DIR/bench/loadgen2310" --mapper="$BIN_DIR/mapper2310" \
+            --requests="$REQUESTS" | awk -F, '$2 == "all" {
+        print "loadgen2310,throughput," $6
+        print "loadgen2310,p99_us," $11
+    }'
+    for benchmark in $MICRO_BENCHMARKS; do
+        "$BIN_DIR/bench/microbench" --benchmark="$benchmark" \
+                --ms="$MEASURE_MS" | awk -F, -v size="$MICRO_SIZE" \
+                '$2 == size && $3 == 1 { print $1 "_" $2 ",ns_per_op," $5 }'
+    done
+}
+
+declare -A BASELINE
+{
+    echo "variant,benchmark,metric,value,change_percent"
+    for variant in $VARIANTS; do
+        if ! build_variant "$variant" >&2; then
+            echo "Failed to build $variant" >&2
+            continue
+        fi
+        while IFS=, read -r benchmark metric value; do
+            key="$benchmark,$metric"
+            if [ -z "${BASELINE[$key]}" ]; then
+                BASELINE[$key]=$value
+            fi
+            change=$(awk -v value="$value" -v base="${BASELINE[$key]}" \
+                    'BEGIN { if (base != 0) {
+                        printf "%.1f", 100 * (value - base) / base } }')
+            echo "$variant,$key,$value,$change"
+        done < <(run_benchmarks)
+    done
+} > "$OUTPUT"
+
+make -s -C "$BIN_DIR" > /dev/null
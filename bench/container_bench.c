@@ -0,0 +1,194 @@
+#include "benchutil.h"
+#include "../list.h"
+#include "../options.h"
+#include "../mapper2310.h"
+#include "../control2310.h"
+#include "../fleet.h"
+
+/* The number of items in each container when --count isn't given */
+#define DEFAULT_ITEMS 1000000
+/* Spreads sequential indices out so ids don't arrive already sorted */
+#define ID_SCRAMBLE 2654435761u
+
+/* The key that MappedAirports were kept in order by */
+#define MAPPED_AIRPORT_ID(airport) ((airport).id)
+
+/* The sorted vector mapper2310 kept its airports in before Registry */
+DEFINE_SORTED_VECTOR(AirportMap, airport_map, MappedAirport, char*,
+        MAPPED_AIRPORT_ID, strcmp)
+
+/**
+ * The MappedAirport comparator that mapper2310 used with List, through a
+ * pointer to a pointer to each airport.
+ */
+static int list_airport_compare(const void* item1, const void* item2) {
+    const MappedAirport* airport1 = *(MappedAirport**) item1;
+    const MappedAirport* airport2 = *(MappedAirport**) item2;
+    return strcmp(airport1->id, airport2->id);
+}
+
+/**
+ * The VisitingPlaneName comparator that control2310 used with List.
+ */
+static int list_name_compare(const void* item1, const void* item2) {
+    return strcmp(*(char* const*) item1, *(char* const*) item2);
+}
+
+/**
+ * Prints one CSV line of results.
+ */
+static void report(char* operation, char* container, long count,
+        long long elapsedNs) {
+    printf("%s,%s,%ld,%.6f,%.1f\n", operation, container, count,
+            elapsedNs / (double) NS_PER_SECOND, elapsedNs / (double) count);
+}
+
+/**
+ * Makes "count" distinct ids, in a scrambled order.
+ */
+static char** make_ids(long count) {
+    char** ids = calloc(count, sizeof(char*));
+    for (long i = 0; i < count; i++) {
+        ids[i] = calloc(16, sizeof(char));
+        sprintf(ids[i], "A%08x", (unsigned int) (i * ID_SCRAMBLE));
+    }
+    return ids;
+}
+
+/**
+ * Times building a registry of airports and looking up every airport in it,
+ * with a sorted List, AirportMap, Registry and PortCache.
+ */
+static void bench_airports(char** ids, long count) {
+    List list;
+    create_list(&list, sizeof(MappedAirport*), NULL, list_airport_compare);
+    MappedAirport* listAirports = calloc(count, sizeof(MappedAirport));
+    for (long i = 0; i < count; i++) {
+        listAirports[i].id = ids[i];
+        listAirports[i].port = 1 + i % 65535;
+    }
+    long long start = get_monotonic_ns();
+    for (long i = 0; i < count; i++) {
+        add_list_item(&list, &listAirports[i]);
+    }
+    sort_list(&list);
+    report("build", "List", count, get_monotonic_ns() - start);
+
+    start = get_monotonic_ns();
+    long found = 0;
+    for (long i = 0; i < count; i++) {
+        MappedAirport searchAirport = {ids[i], -1};
+        MappedAirport* searchKey = &searchAirport;
+        found += bsearch(&searchKey, list.content, list.length,
+                sizeof(ListItem), list_airport_compare) != NULL;
+    }
+    report("search", "List", count, get_monotonic_ns() - start);
+
+    AirportMap map;
+    create_airport_map(&map);
+    int numAdded;
+    MappedAirport* airports = calloc(count, sizeof(MappedAirport));
+    for (long i = 0; i < count; i++) {
+        airports[i].id = ids[i];
+        airports[i].port = 1 + i % 65535;
+    }
+    start = get_monotonic_ns();
+    merge_into_airport_map(&map, airports, count, &numAdded);
+    report("build", "AirportMap", count, get_monotonic_ns() - start);
+
+    start = get_monotonic_ns();
+    for (long i = 0; i < count; i++) {
+        found += search_airport_map(&map, ids[i]) != NULL;
+    }
+    report("search", "AirportMap", count, get_monotonic_ns() - start);
+
+    Registry registry;
+    create_registry(&registry);
+    start = get_monotonic_ns();
+    for (long i = 0; i < count; i++) {
+        add_to_registry(&registry, ids[i], 1 + i % 65535);
+    }
+    report("build", "Registry", count, get_monotonic_ns() - start);
+
+    start = get_monotonic_ns();
+    for (long i = 0; i < count; i++) {
+        found += search_registry(&registry, ids[i]) != REGISTRY_NOT_FOUND;
+    }
+    report("search", "Registry", count, get_monotonic_ns() - start);
+
+    PortCache cache;
+    create_port_cache(&cache);
+    start = get_monotonic_ns();
+    for (long i = 0; i < count; i++) {
+        add_to_port_cache(&cache, ids[i], 1 + i % 65535);
+    }
+    report("build", "PortCache", count, get_monotonic_ns() - start);
+
+    start = get_monotonic_ns();
+    for (long i = 0; i < count; i++) {
+        found += get_from_port_cache(&cache, ids[i]) != NULL;
+    }
+    report("search", "PortCache", count, get_monotonic_ns() - start);
+
+    if (found != 4 * count) {
+        bench_fail("Lost an airport");
+    }
+}
+
+/**
+ * Times sorting a visitor log of plane names with List and with PlaneNames.
+ */
+static void bench_plane_names(char** ids, long count) {
+    List list;
+    create_list(&list, sizeof(VisitingPlaneName), NULL, list_name_compare);
+    PlaneNames names;
+    create_plane_names(&names);
+    for (long i = 0; i < count; i++) {
+        add_list_item(&list, ids[i]);
+        add_to_plane_names(&names, ids[i]);
+    }
+
+    long long start = get_monotonic_ns();
+    sort_list(&list);
+    report("sort", "List", count, get_monotonic_ns() - start);
+
+    start = get_monotonic_ns();
+    sort_plane_names(&names);
+    report("sort", "PlaneNames", count, get_monotonic_ns() - start);
+
+    for (long i = 1; i < count; i++) {
+        if (strcmp(names.items[i - 1], names.items[i]) > 0) {
+            bench_fail("PlaneNames isn't sorted");
+        }
+    }
+}
+
+/**
+ * container_bench.
+ *
+ * Compares the generic List with the macro-generated containers for the
+ * element types mapper2310, control2310 and roc2310 use: building and
+ * searching a registry of --count airports (List, the sorted AirportMap,
+ * mapper2310's Registry and the PortCache hash map) and sorting --count
+ * plane names (List and PlaneNames).
+ *
+ * Prints CSV lines of: operation,container,count,seconds,ns_per_item
+ */
+int main(int argc, char** argv) {
+    Option options[] = {
+        {"count", NULL, false}
+    };
+    parse_options(&argc, &argv, options, 1);
+
+    long count = DEFAULT_ITEMS;
+    if (options[0].present && !parse_option_long(&options[0], 1,
+            100000000, &count)) {
+        bench_fail("Usage: container_bench [--count=N]");
+    }
+
+    char** ids = make_ids(count);
+    printf("operation,container,count,seconds,ns_per_item\n");
+    bench_airports(ids, count);
+    bench_plane_names(ids, count);
+    return 0;
+}
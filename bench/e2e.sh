@@ -0,0 +1,170 @@
+#!/bin/bash
+#
+# e2e.sh
+#
+# End to end benchmark of a local mapper2310 + control2310 + roc2310
+# topology. For each configuration it starts one mapper2310 and a
+# control2310 hosting K airports registered with it, then flies R planes,
+# each with a route of L destinations, using roc2310's fleet mode. It also
+# times a single roc2310 process flying one route, which includes process
+# startup.
+#
+# Each of K, R and L is swept in turn while the other two are held at their
+# base value, giving a scaling curve for each.
+#
+# Usage: bench/e2e.sh [-k "K..."] [-r "R..."] [-l "L..."] [-c CONCURRENCY]
+#                     [-b "K R L"] [-o OUTPUT]
+#   -k, -r, -l -> the values to sweep each of K, R and L over
+#   -b -> the base values of K, R and L (default "10 200 4")
+#   -c -> the number of planes flown at once (default 32)
+#   -o -> where to write the CSV (default stdout)
+#
+# Prints CSV of: sweep,airports,planes,route_length,metric,count,errors,
+# min_us,mean_us,p50_us,p90_us,p99_us,p999_us,max_us,routes_per_second
+# with rows for each phase roc2310 reports (resolution, hop and route) and
+# a "process" row for the single roc2310 run.
+
+BIN_DIR=$(cd "$(dirname "$0")/.." && pwd)
+K_VALUES="1 10 100 1000"
+R_VALUES="10 100 1000"
+L_VALUES="1 4 16 64"
+BASE="10 200 4"
+CONCURRENCY=32
+OUTPUT=/dev/stdout
+
+while getopts "k:r:l:b:c:o:" option; do
+    case $option in
+        k) K_VALUES=$OPTARG ;;
+        r) R_VALUES=$OPTARG ;;
+        l) L_VALUES=$OPTARG ;;
+        b) BASE=$OPTARG ;;
+        c) CONCURRENCY=$OPTARG ;;
+        o) OUTPUT=$OPTARG ;;
+        *) sed -n '/^# Usage/,/^#   -o/s/^# \{0,1\}//p' "$0" >&2; exit 1 ;;
+    esac
+done
+read -r BASE_K BASE_R BASE_L <<< "$BASE"
+
+WORK_DIR=$(mktemp -d)
+SERVER_PIDS=()
+
+# Kills any servers still running and removes the working files
+cleanup() {
+    if [ ${#SERVER_PIDS[@]} -gt 0 ]; then
+        kill "${SERVER_PIDS[@]}" 2> /dev/null
+        wait "${SERVER_PIDS[@]}" 2> /dev/null
+    fi
+    SERVER_PIDS=()
+}
+trap 'cleanup; rm -rf "$WORK_DIR"' EXIT
+
+# Waits up to 10s until a file has at least $2 lines
+wait_for_lines() {
+    for _ in $(seq 1 1000); do
+        if [ -f "$1" ] && [ "$(wc -l < "$1")" -ge "$2" ]; then
+            return 0
+        fi
+        sleep 0.01
+    done
+    echo "Timed out waiting for $1" >&2
+    return 1
+}
+
+# Asks the mapper on port $1 for airport $2, printing its reply
+ask_mapper() {
+    exec 3<> "/dev/tcp/127.0.0.1/$1"
+    echo "?$2" >&3
+    read -r reply <&3
+    exec 3>&-
+    echo "$reply"
+}
+
+# Starts a mapper2310 and a control2310 hosting $1 airports, setting
+# MAPPER_PORT once every airport can be resolved
+start_topology() {
+    local airports=$1
+    "$BIN_DIR/mapper2310" > "$WORK_DIR/mapper.out" &
+    SERVER_PIDS+=($!)
+    wait_for_lines "$WORK_DIR/mapper.out" 1 || return 1
+    MAPPER_PORT=$(head -n 1 "$WORK_DIR/mapper.out")
+
+    for i in $(seq 1 "$airports"); do
+        echo "AP$i:info$i"
+    done > "$WORK_DIR/airports.txt"
+    "$BIN_DIR/control2310" --airports="$WORK_DIR/airports.txt" -- \
+            "$MAPPER_PORT" > "$WORK_DIR/control.out" &
+    SERVER_PIDS+=($!)
+    wait_for_lines "$WORK_DIR/control.out" "$airports" || return 1
+
+    # Registration is asynchronous, so wait for the last airport to resolve
+    for _ in $(seq 1 1000); do
+        if [ "$(ask_mapper "$MAPPER_PORT" "AP$airports")" != ";" ]; then
+            return 0
+        fi
+        sleep 0.01
+    done
+    echo "Timed out waiting for registration" >&2
+    return 1
+}
+
+# Writes a fleet file of $2 planes, each visiting $3 of the $1 airports
+write_fleet() {
+    awk -v airports="$1" -v planes="$2" -v stops="$3" 'BEGIN {
+        srand(2310)
+        for (i = 1; i <= planes; i++) {
+            line = "P" i
+            for (j = 0; j < stops; j++) {
+                line = line ":AP" int(rand() * airports + 1)
+            }
+            print line
+        }
+    }' > "$WORK_DIR/fleet.txt"
+}
+
+# Runs one configuration, printing a CSV row for each phase
+run_configuration() {
+    local sweep=$1 airports=$2 planes=$3 length=$4
+    local prefix="$sweep,$airports,$planes,$length"
+    if ! start_topology "$airports"; then
+        cleanup
+        return
+    fi
+    write_fleet "$airports" "$planes" "$length"
+
+    "$BIN_DIR/roc2310" --fleet="$WORK_DIR/fleet.txt" \
+            --concurrency="$CONCURRENCY" -- "$MAPPER_PORT" \
+            > "$WORK_DIR/fleet.csv"
+    local rate
+    rate=$(sed -n 's/^# .*(\([0-9.]*\) routes\/s)$/\1/p' \
+            "$WORK_DIR/fleet.csv")
+    grep -v '^metric\|^#' "$WORK_DIR/fleet.csv" | \
+            sed "s/^/$prefix,/;s/$/,$rate/"
+
+    # A single roc2310, from process start to landing
+    local route start end
+    route=$(head -n 1 "$WORK_DIR/fleet.txt" | cut -d: -f2- | tr ':' ' ')
+    start=$(date +%s%N)
+    # shellcheck disable=SC2086
+    "$BIN_DIR/roc2310" P0 "$MAPPER_PORT" $route > /dev/null
+    local errors=$?
+    end=$(date +%s%N)
+    local us=$(( (end - start) / 1000 ))
+    echo "$prefix,process,1,$((errors != 0)),$us,$us,$us,$us,$us,$us,$us,"
+
+    cleanup
+}
+
+HEADER="sweep,airports,planes,route_length,metric,count,errors,min_us,mean_us"
+HEADER="$HEADER,p50_us,p90_us,p99_us,p999_us,max_us,routes_per_second"
+{
+    echo "$HEADER"
+    for k in $K_VALUES; do
+        run_configuration airports "$k" "$BASE_R" "$BASE_L"
+    done
+    for r in $R_VALUES; do
+        run_configuration planes "$BASE_K" "$r" "$BASE_L"
+    done
+    for l in $L_VALUES; do
+        run_configuration route_length "$BASE_K" "$BASE_R" "$l"
+    done
+} > "$OUTPUT"
@@ -0,0 +1,98 @@
+#include "benchutil.h"
+#include "../list.h"
+#include "../options.h"
+
+/* The number of items appended when --count isn't given */
+#define DEFAULT_APPENDS 10000000
+
+/* The ways items can be appended */
+enum AppendMode {
+    APPEND_LEGACY,
+    APPEND_CONTIGUOUS,
+    APPEND_CHUNKED
+};
+typedef enum AppendMode AppendMode;
+
+/**
+ * Appends an item the way add_list_item did before Lists tracked their
+ * capacity: growing the array by exactly one item on every append.
+ */
+static ListError add_list_item_legacy(List* list, ListItem item) {
+    sem_wait(list->listAccessSemaphore);
+    ListItem* newContent = realloc(
+            list->content, (list->length + 1) * list->itemSize);
+    if (newContent == NULL) {
+        sem_post(list->listAccessSemaphore);
+        return LIST_NOT_OK;
+    }
+
+    list->content = newContent;
+    list->content[list->length] = item;
+    list->length++;
+
+    sem_post(list->listAccessSemaphore);
+    return LIST_OK;
+}
+
+/**
+ * list_bench.
+ *
+ * Measures how long it takes to append --count items to a List that grows by
+ * one item per append (legacy, the old behaviour), a contiguous List with
+ * geometric growth, or a chunked List.
+ *
+ * Prints a CSV line of: mode,count,seconds,appends_per_second
+ */
+int main(int argc, char** argv) {
+    Option options[] = {
+        {"count", NULL, false},
+        {"mode", NULL, false}
+    };
+    parse_options(&argc, &argv, options, 2);
+
+    long count = DEFAULT_APPENDS;
+    if (options[0].present && !parse_option_long(&options[0], 1,
+            1000000000, &count)) {
+        bench_fail("Invalid count");
+    }
+    char* modeName = options[1].present ? options[1].value : "contiguous";
+    AppendMode mode;
+    if (strcmp(modeName, "legacy") == 0) {
+        mode = APPEND_LEGACY;
+    } else if (strcmp(modeName, "contiguous") == 0) {
+        mode = APPEND_CONTIGUOUS;
+    } else if (strcmp(modeName, "chunked") == 0) {
+        mode = APPEND_CHUNKED;
+    } else {
+        bench_fail("Usage: list_bench [--count=N] "
+                "[--mode=legacy|contiguous|chunked]");
+    }
+
+    List list;
+    if (mode == APPEND_CHUNKED) {
+        create_chunked_list(&list, sizeof(ListItem), NULL, NULL);
+    } else {
+        create_list(&list, sizeof(ListItem), NULL, NULL);
+    }
+
+    long long start = get_monotonic_ns();
+    for (long i = 0; i < count; i++) {
+        ListError error = mode == APPEND_LEGACY ?
+                add_list_item_legacy(&list, (ListItem) i) :
+                add_list_item(&list, (ListItem) i);
+        if (error != LIST_OK) {
+            bench_fail("Append failed");
+        }
+    }
+    double seconds = (get_monotonic_ns() - start) / (double) NS_PER_SECOND;
+
+    // Make sure the items ended up where they should be
+    ListItem last;
+    if (get_list_item(&list, count - 1, &last) != LIST_OK ||
+            last != (ListItem) (count - 1)) {
+        bench_fail("Last item is wrong");
+    }
+
+    printf("%s,%ld,%.6f,%.0f\n", modeName, count, seconds, count / seconds);
+    return 0;
+}
@@ -0,0 +1,341 @@
+#include "benchutil.h"
+#include "../options.h"
+#include "../histogram.h"
+
+/* The mapper2310 binary used when --mapper isn't given */
+#define DEFAULT_MAPPER "./mapper2310"
+/* The number of airports registered before the load starts */
+#define DEFAULT_AIRPORTS 10000
+/* The number of connections driving load when --connections isn't given */
+#define DEFAULT_CONNECTIONS 16
+/* The most connections that may drive load at once */
+#define MAX_CONNECTIONS 4096
+/* The number of requests sent when --requests isn't given */
+#define DEFAULT_REQUESTS 100000
+/* The most requests per second an open loop may be driven at */
+#define MAX_RATE 10000000
+/* The relative weights of '?', '!' and '@' requests when --mix isn't given */
+#define DEFAULT_MIX "90,9,1"
+/* Spreads sequential indices out so ids and commands are well mixed */
+#define INDEX_SCRAMBLE 2654435761u
+/* The id '@' requests are followed by a lookup of, to find their end */
+#define END_OF_PRINT_ID "end-of-print"
+
+/* The kinds of request sent to the mapper */
+enum LoadCommand {
+    LOAD_SEARCH,
+    LOAD_ADD,
+    LOAD_PRINT,
+    NUM_LOAD_COMMANDS
+};
+typedef enum LoadCommand LoadCommand;
+
+/* The name each LoadCommand is reported as */
+static char* commandNames[] = {"search", "add", "print"};
+
+/**
+ * Everything shared by the threads driving load.
+ * Members:
+ *  - port -> the port of the mapper2310 under load
+ *  - numAirports -> the number of airports registered before the load
+ *  - mix -> the relative weight of each LoadCommand
+ *  - totalWeight -> the sum of mix
+ *  - numRequests -> the number of requests to send
+ *  - rate -> requests per second, or 0 to drive a closed loop
+ *  - nextRequest -> the index of the next request to send
+ *  - queueLock -> regulates access to nextRequest
+ *  - startNs -> when the load started
+ */
+struct Load {
+    char* port;
+    int numAirports;
+    int mix[NUM_LOAD_COMMANDS];
+    int totalWeight;
+    long numRequests;
+    long rate;
+    long nextRequest;
+    pthread_mutex_t queueLock;
+    long long startNs;
+};
+typedef struct Load Load;
+
+/**
+ * A connection driving load, along with the timings it recorded.
+ * Members:
+ *  - load -> the load being driven
+ *  - latencies -> the time each kind of request took
+ *  - errors -> the number of each kind of request that failed
+ */
+struct LoadWorker {
+    Load* load;
+    Histogram latencies[NUM_LOAD_COMMANDS];
+    long long errors[NUM_LOAD_COMMANDS];
+};
+typedef struct LoadWorker LoadWorker;
+
+/**
+ * Writes the id of the index'th airport to "buffer".
+ */
+static void airport_id(char* buffer, long index) {
+    sprintf(buffer, "A%08x", (unsigned int) (index * INDEX_SCRAMBLE));
+}
+
+/**
+ * Picks the kind of the index'th request according to the mix.
+ */
+static LoadCommand pick_command(Load* load, long index) {
+    int weight = (unsigned int) (index * INDEX_SCRAMBLE) % load->totalWeight;
+    LoadCommand command = LOAD_SEARCH;
+    while (weight >= load->mix[command]) {
+        weight -= load->mix[command];
+        command++;
+    }
+    return command;
+}
+
+/**
+ * Sends the index'th request and waits for its reply.
+ *  - search -> a '?' for one of the preloaded airports
+ *  - add -> a '!' for a new airport, followed by a '?' for it since '!' has
+ *      no reply of its own
+ *  - print -> a '@', followed by a '?' whose reply (unlike the lines of the
+ *      '@') has no ':', marking the end of the print
+ *
+ * Returns:
+ *  - true -> if the reply arrived
+ *  - false -> if the connection failed
+ */
+static bool send_request(Load* load, Client* client, LoadCommand command,
+        long index) {
+    char id[16];
+    char reply[MESSAGE_BUFFER_SIZE];
+    if (command == LOAD_SEARCH) {
+        airport_id(id, index % load->numAirports);
+        fprintf(client->writeTo, "?%s\n", id);
+    } else if (command == LOAD_ADD) {
+        airport_id(id, load->numAirports + index);
+        fprintf(client->writeTo, "!%s:%ld\n?%s\n", id, 1 + index % 65535,
+                id);
+    } else {
+        fprintf(client->writeTo, "@\n?%s\n", END_OF_PRINT_ID);
+    }
+    fflush(client->writeTo);
+
+    do {
+        if (!read_message(client->readFrom, reply)) {
+            return false;
+        }
+    } while (strchr(reply, ':') != NULL);
+    return true;
+}
+
+/**
+ * Sends requests on one connection until none are left. In a closed loop
+ * the next request is sent as soon as the last reply arrives. In an open
+ * loop each request waits for its scheduled time, and its latency is
+ * measured from then, so time spent queued behind a slow reply counts.
+ * Made to be called as a function pointer in order to start a new thread.
+ */
+static void* drive_load(void* uncastedWorker) {
+    LoadWorker* worker = (LoadWorker*) uncastedWorker;
+    Load* load = worker->load;
+    Client client;
+    bool connected = setup_client_on_port(load->port, &client) == CLIENT_OK;
+    while (true) {
+        pthread_mutex_lock(&load->queueLock);
+        long index = load->nextRequest++;
+        pthread_mutex_unlock(&load->queueLock);
+        if (index >= load->numRequests) {
+            break;
+        }
+
+        long long sendNs = get_monotonic_ns();
+        if (load->rate > 0) {
+            sendNs = load->startNs + index * NS_PER_SECOND / load->rate;
+            struct timespec send = {sendNs / NS_PER_SECOND,
+                    sendNs % NS_PER_SECOND};
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &send,
+                    NULL) != 0) {
+            }
+        }
+
+        LoadCommand command = pick_command(load, index);
+        if (!connected) {
+            connected = setup_client_on_port(load->port, &client) ==
+                    CLIENT_OK;
+        }
+        if (!connected || !send_request(load, &client, command, index)) {
+            worker->errors[command]++;
+            if (connected) {
+                close_client(&client);
+                connected = false;
+            }
+            continue;
+        }
+        record_histogram_value(&worker->latencies[command],
+                get_monotonic_ns() - sendNs);
+    }
+
+    if (connected) {
+        close_client(&client);
+    }
+    return NULL;
+}
+
+/**
+ * Registers the airports every search looks up in a single '&' batch, and
+ * waits until the last of them can be looked up.
+ */
+static void preload_airports(char* port, int numAirports) {
+    Client client;
+    if (setup_client_on_port(port, &client) != CLIENT_OK) {
+        bench_fail("Failed to connect to mapper");
+    }
+
+    char id[16];
+    fprintf(client.writeTo, "&\n");
+    for (int i = 0; i < numAirports; i++) {
+        airport_id(id, i);
+        fprintf(client.writeTo, "%s:%d\n", id, 1 + i % 65535);
+    }
+    fprintf(client.writeTo, ".\n");
+    airport_id(id, numAirports - 1);
+    fprintf(client.writeTo, "?%s\n", id);
+    fflush(client.writeTo);
+
+    char reply[MESSAGE_BUFFER_SIZE];
+    if (!read_message(client.readFrom, reply) || strcmp(";", reply) == 0) {
+        bench_fail("Failed to preload airports");
+    }
+    close_client(&client);
+}
+
+/**
+ * Parses --mix, a comma separated weight for each of '?', '!' and '@'.
+ */
+static bool parse_mix(char* text, Load* load) {
+    char* end = text;
+    load->totalWeight = 0;
+    for (int i = 0; i < NUM_LOAD_COMMANDS; i++) {
+        if (!isdigit(*end)) {
+            return false;
+        }
+        load->mix[i] = strtol(end, &end, BASE_10);
+        load->totalWeight += load->mix[i];
+        if (*end != (i == NUM_LOAD_COMMANDS - 1 ? '\0' : ',')) {
+            return false;
+        }
+        end++;
+    }
+    return load->totalWeight > 0;
+}
+
+/**
+ * Prints one line of the report, with times in microseconds.
+ */
+static void print_load_metric(char* mode, char* command,
+        Histogram* latencies, long long errors, double seconds) {
+    double percentiles[] = {50, 90, 99, 99.9};
+    printf("%s,%s,%lld,%lld,%.3f,%.1f,%.1f,%.1f", mode, command,
+            latencies->count, errors, seconds, latencies->count / seconds,
+            latencies->min / 1000.0, get_histogram_mean(latencies) / 1000.0);
+    for (int i = 0; i < sizeof(percentiles) / sizeof(double); i++) {
+        printf(",%.1f",
+                get_histogram_percentile(latencies, percentiles[i]) / 1000.0);
+    }
+    printf(",%.1f\n", latencies->max / 1000.0);
+}
+
+/**
+ * loadgen2310.
+ *
+ * Starts a mapper2310, registers --airports airports with it, then sends
+ * --requests requests from --connections connections at once, mixed by
+ * --mix (weights of '?', '!' and '@', default 90,9,1). With --rate=R the
+ * requests are sent in an open loop at R per second, otherwise in a closed
+ * loop as fast as the mapper replies.
+ *
+ * Prints CSV with a line per kind of request and one for all of them:
+ * mode,command,count,errors,seconds,throughput,min_us,mean_us,p50_us,
+ * p90_us,p99_us,p999_us,max_us
+ */
+int main(int argc, char** argv) {
+    Option options[] = {
+        {"mapper", NULL, false},
+        {"airports", NULL, false},
+        {"connections", NULL, false},
+        {"requests", NULL, false},
+        {"rate", NULL, false},
+        {"mix", NULL, false}
+    };
+    parse_options(&argc, &argv, options, 6);
+
+    Load* load = calloc(1, sizeof(Load));
+    char* mapperPath = options[0].present ? options[0].value : DEFAULT_MAPPER;
+    long numAirports = DEFAULT_AIRPORTS;
+    long numConnections = DEFAULT_CONNECTIONS;
+    load->numRequests = DEFAULT_REQUESTS;
+    if ((options[1].present && !parse_option_long(&options[1], 1,
+            10000000, &numAirports)) ||
+            (options[2].present && !parse_option_long(&options[2], 1,
+            MAX_CONNECTIONS, &numConnections)) ||
+            (options[3].present && !parse_option_long(&options[3], 1,
+            1000000000, &load->numRequests)) ||
+            (options[4].present && !parse_option_long(&options[4], 1,
+            MAX_RATE, &load->rate)) ||
+            !parse_mix(options[5].present ? options[5].value : DEFAULT_MIX,
+            load)) {
+        bench_fail("Usage: loadgen2310 [--mapper=PATH] [--airports=N] "
+                "[--connections=N] [--requests=N] [--rate=N] "
+                "[--mix=SEARCH,ADD,PRINT]");
+    }
+    load->numAirports = numAirports;
+    pthread_mutex_init(&load->queueLock, NULL);
+
+    BenchServer mapper;
+    char* mapperArgs[] = {mapperPath, NULL};
+    if (!start_bench_server(mapperArgs, &mapper)) {
+        bench_fail("Failed to start mapper");
+    }
+    load->port = mapper.port;
+    preload_airports(mapper.port, numAirports);
+
+    LoadWorker* workers = calloc(numConnections, sizeof(LoadWorker));
+    pthread_t* threads = calloc(numConnections, sizeof(pthread_t));
+    load->startNs = get_monotonic_ns();
+    for (int i = 0; i < numConnections; i++) {
+        workers[i].load = load;
+        if (pthread_create(&threads[i], NULL, drive_load, &workers[i])) {
+            bench_fail("Failed to start a connection thread");
+        }
+    }
+    for (int i = 0; i < numConnections; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double seconds = (get_monotonic_ns() - load->startNs) /
+            (double) NS_PER_SECOND;
+    stop_bench_server(&mapper);
+
+    // Merge every connection's timings, per command and overall
+    LoadWorker* total = calloc(1, sizeof(LoadWorker));
+    Histogram* all = calloc(1, sizeof(Histogram));
+    long long allErrors = 0;
+    for (int j = 0; j < NUM_LOAD_COMMANDS; j++) {
+        for (int i = 0; i < numConnections; i++) {
+            merge_histogram(&total->latencies[j], &workers[i].latencies[j]);
+            total->errors[j] += workers[i].errors[j];
+        }
+        merge_histogram(all, &total->latencies[j]);
+        allErrors += total->errors[j];
+    }
+
+    char* mode = load->rate > 0 ? "open" : "closed";
+    printf("mode,command,count,errors,seconds,throughput,min_us,mean_us,"
+            "p50_us,p90_us,p99_us,p999_us,max_us\n");
+    for (int j = 0; j < NUM_LOAD_COMMANDS; j++) {
+        print_load_metric(mode, commandNames[j], &total->latencies[j],
+                total->errors[j], seconds);
+    }
+    print_load_metric(mode, "all", all, allErrors, seconds);
+    return allErrors == 0 ? 0 : 1;
+}
@@ -0,0 +1,68 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/*
+ * malloccount.so, preloaded into a server with LD_PRELOAD, counts every call
+ * to malloc, calloc and realloc. If MALLOC_COUNT_FILE is set, the count is
+ * kept in that file (mapped shared) so another process can read it live.
+ */
+
+/* glibc's own allocator, which the wrappers pass every call through to */
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* pointer, size_t size);
+
+/* Counts allocations made before the count file is mapped */
+static long long startupCount = 0;
+/* The count of allocations, in the count file once it's mapped */
+static long long* allocationCount = &startupCount;
+
+/**
+ * Maps the count file when the library is loaded, carrying over anything
+ * counted before then.
+ */
+__attribute__((constructor)) static void map_count_file(void) {
+    char* path = getenv("MALLOC_COUNT_FILE");
+    if (path == NULL) {
+        return;
+    }
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0 || ftruncate(fd, sizeof(long long)) != 0) {
+        return;
+    }
+    void* count = mmap(NULL, sizeof(long long), PROT_READ | PROT_WRITE,
+            MAP_SHARED, fd, 0);
+    close(fd);
+    if (count == MAP_FAILED) {
+        return;
+    }
+    *(long long*) count = startupCount;
+    allocationCount = count;
+}
+
+void* malloc(size_t size) {
+    __atomic_add_fetch(allocationCount, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    __atomic_add_fetch(allocationCount, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) {
+    __atomic_add_fetch(allocationCount, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(pointer, size);
+}
+
+/**
+ * Gets the number of allocations counted so far, for benchmarks that are
+ * linked with this file rather than preloading it.
+ */
+long long get_allocation_count(void) {
+    return __atomic_load_n(allocationCount, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,608 @@
+#include "benchutil.h"
+#include "../list.h"
+#include "../atc2310.h"
+#include "../options.h"
+
+/* The shortest time each measurement runs for when --ms isn't given */
+#define DEFAULT_MEASURE_MS 200
+/* The number of threads contended benchmarks use when --threads isn't given */
+#define DEFAULT_CONTENDED_THREADS 4
+/* The most threads a contended benchmark can use */
+#define MAX_CONTENDED_THREADS 64
+/* The size of a generated plane id, including its terminator */
+#define PLANE_ID_SIZE 10
+/* The number of bytes of lines get_line reads through before starting over */
+#define MICRO_TEXT_SIZE (1 << 20)
+/* The ":PORT" ending the mappings parse_id_port parses */
+#define MICRO_MAPPING_PORT ":8080"
+/* The info of the control the libatc2310 benchmarks check in to */
+#define MICRO_CONTROL_INFO "micro"
+/* The port every id is mapped to by the libatc2310 benchmarks */
+#define MICRO_MAPPED_PORT 8080
+/* The number of sizes each benchmark is measured at */
+#define NUM_MICRO_SIZES 4
+
+/* The sizes each benchmark is measured at. What a size means depends on the
+ * benchmark, see main. */
+static const long microSizes[NUM_MICRO_SIZES] = {10, 100, 1000, 10000};
+
+/* Defined in malloccount.c, which this benchmark is linked with */
+long long get_allocation_count(void);
+
+typedef struct MicroState MicroState;
+
+/**
+ * A microbenchmark: something done "ops" times by each of state->numThreads
+ * threads, with everything it needs set up beforehand.
+ * Members:
+ *  - name -> the name of the benchmark, as printed and given to --benchmark
+ *  - contended -> whether the benchmark is also measured with many threads
+ *      sharing its state
+ *  - setup -> prepares the state for a measurement, untimed
+ *  - run -> does "ops" operations on one thread. Returns the nanoseconds
+ *      spent on the operations themselves, leaving out any time spent
+ *      getting each one ready.
+ *  - teardown -> frees anything setup allocated, untimed
+ */
+struct MicroBenchmark {
+    char* name;
+    bool contended;
+    void (*setup)(MicroState* state);
+    long long (*run)(MicroState* state, long ops);
+    void (*teardown)(MicroState* state);
+};
+typedef struct MicroBenchmark MicroBenchmark;
+
+/**
+ * Everything a benchmark works on, shared by all of its threads.
+ * Members:
+ *  - size -> the size being measured
+ *  - numThreads -> the number of threads running the benchmark
+ *  - ids -> size generated plane ids, in a scrambled order
+ *  - idBlock -> the block the ids are stored in
+ *  - list -> a List of the ids, for the list benchmarks
+ *  - mapper -> an in-process mapper with every id mapped, for the
+ *      libatc2310 benchmarks
+ *  - control -> an in-process control that every id has checked in to, for
+ *      the libatc2310 benchmarks
+ *  - text -> a string of size characters, or lines of size characters for
+ *      get_line
+ *  - textLength -> the length of text
+ *  - start -> waited on by every thread so they all start together
+ */
+struct MicroState {
+    long size;
+    int numThreads;
+    char** ids;
+    char* idBlock;
+    List list;
+    AtcMapper* mapper;
+    AtcControl* control;
+    char* text;
+    size_t textLength;
+    pthread_barrier_t start;
+};
+
+/**
+ * One thread's share of a measurement.
+ * Members:
+ *  - benchmark -> the benchmark being measured
+ *  - state -> the state the benchmark works on
+ *  - ops -> the number of operations to do
+ *  - elapsedNs -> the time the operations took, once the thread is done
+ */
+struct MicroThread {
+    MicroBenchmark* benchmark;
+    MicroState* state;
+    long ops;
+    long long elapsedNs;
+};
+typedef struct MicroThread MicroThread;
+
+/**
+ * Compares two plane ids, through pointers to them.
+ */
+static int compare_plane_ids(const void* id1, const void* id2) {
+    return strcmp(*(char**) id1, *(char**) id2);
+}
+
+/**
+ * Writes a plane id in a List as a string, for get_list_as_str.
+ */
+static int plane_id_to_str(char* buffer, size_t bufferSize, ListItem id) {
+    return snprintf(buffer, bufferSize, "%s", (char*) id);
+}
+
+/**
+ * Generates state->size plane ids in a scrambled order, and a List of them.
+ */
+static void setup_list(MicroState* state) {
+    state->idBlock = calloc(state->size, PLANE_ID_SIZE);
+    state->ids = calloc(state->size, sizeof(char*));
+    if (state->idBlock == NULL || state->ids == NULL) {
+        bench_fail("Out of memory");
+    }
+    create_list(&state->list, sizeof(ListItem), plane_id_to_str,
+            compare_plane_ids);
+    for (long i = 0; i < state->size; i++) {
+        // Multiplying by an odd constant scrambles the order of the ids
+        unsigned int number = (unsigned int) i * 2654435761u;
+        state->ids[i] = state->idBlock + i * PLANE_ID_SIZE;
+        snprintf(state->ids[i], PLANE_ID_SIZE, "P%08x", number);
+        if (add_list_item(&state->list, state->ids[i]) != LIST_OK) {
+            bench_fail("Out of memory");
+        }
+    }
+}
+
+/**
+ * Frees everything setup_list allocated.
+ */
+static void teardown_list(MicroState* state) {
+    destroy_list(&state->list);
+    free(state->ids);
+    free(state->idBlock);
+}
+
+/**
+ * Appends to a List already holding state->size ids.
+ */
+static long long run_add_list_item(MicroState* state, long ops) {
+    long long start = get_monotonic_ns();
+    for (long i = 0; i < ops; i++) {
+        if (add_list_item(&state->list, state->ids[i % state->size]) !=
+                LIST_OK) {
+            bench_fail("Append failed");
+        }
+    }
+    return get_monotonic_ns() - start;
+}
+
+/**
+ * Searches a List of state->size ids for ids spread across it, so each
+ * search scans half the List on average.
+ */
+static long long run_search_list(MicroState* state, long ops) {
+    long long start = get_monotonic_ns();
+    for (long i = 0; i < ops; i++) {
+        ListItem found = NULL;
+        char* key = state->ids[(i * 7919) % state->size];
+        search_list(&state->list, &key, &found);
+        if (found != key) {
+            bench_fail("Search missed");
+        }
+    }
+    return get_monotonic_ns() - start;
+}
+
+/**
+ * Sorts a List of state->size ids, scrambling it again before each sort.
+ */
+static long long run_sort_list(MicroState* state, long ops) {
+    long long elapsedNs = 0;
+    for (long i = 0; i < ops; i++) {
+        memcpy(state->list.content, state->ids, state->size * sizeof(char*));
+        long long start = get_monotonic_ns();
+        if (sort_list(&state->list) != LIST_OK) {
+            bench_fail("Sort failed");
+        }
+        elapsedNs += get_monotonic_ns() - start;
+    }
+    return elapsedNs;
+}
+
+/**
+ * Writes a List of state->size ids as a string, reusing one buffer like the
+ * servers reuse their scratch buffers.
+ */
+static long long run_get_list_as_str(MicroState* state, long ops) {
+    size_t capacity = PLANE_ID_SIZE;
+    char* buffer = calloc(capacity, sizeof(char));
+    long long start = get_monotonic_ns();
+    for (long i = 0; i < ops; i++) {
+        buffer[0] = '\0';
+        get_list_as_str(&state->list, &buffer, &capacity);
+    }
+    long long elapsedNs = get_monotonic_ns() - start;
+    if (strlen(buffer) != state->size * PLANE_ID_SIZE - 1) {
+        bench_fail("String is the wrong length");
+    }
+    free(buffer);
+    return elapsedNs;
+}
+
+/**
+ * Makes state->text a string of state->size digits, which is also free of
+ * any invalid characters.
+ */
+static void setup_digits(MicroState* state) {
+    state->textLength = state->size;
+    state->text = calloc(state->textLength + 1, sizeof(char));
+    if (state->text == NULL) {
+        bench_fail("Out of memory");
+    }
+    for (long i = 0; i < state->size; i++) {
+        state->text[i] = '1' + i % 9;
+    }
+}
+
+/**
+ * Frees the text made by setup_digits, setup_mapping or setup_lines.
+ */
+static void teardown_text(MicroState* state) {
+    free(state->text);
+}
+
+/**
+ * Checks whether a string of state->size digits is a valid port. Only
+ * strings of up to 5 digits can be, but every digit is looked at first.
+ */
+static long long run_is_valid_port(MicroState* state, long ops) {
+    long valid = 0;
+    long long start = get_monotonic_ns();
+    for (long i = 0; i < ops; i++) {
+        valid += is_valid_port(state->text);
+    }
+    long long elapsedNs = get_monotonic_ns() - start;
+    if (valid != 0) {
+        bench_fail("Port should be invalid");
+    }
+    return elapsedNs;
+}
+
+/**
+ * Checks a string of state->size characters, none of them invalid, for
+ * invalid characters.
+ */
+static long long run_string_contains_invalid_char(MicroState* state,
+        long ops) {
+    long invalid = 0;
+    long long start = get_monotonic_ns();
+    for (long i = 0; i < ops; i++) {
+        invalid += string_contains_invalid_char(state->text);
+    }
+    long long elapsedNs = get_monotonic_ns() - start;
+    if (invalid != 0) {
+        bench_fail("String should be valid");
+    }
+    return elapsedNs;
+}
+
+/**
+ * Makes state->text an "ID:PORT" mapping with an id of state->size
+ * characters.
+ */
+static void setup_mapping(MicroState* state) {
+    state->textLength = state->size + strlen(MICRO_MAPPING_PORT);
+    state->text = calloc(state->textLength + 1, sizeof(char));
+    if (state->text == NULL) {
+        bench_fail("Out of memory");
+    }
+    memset(state->text, 'A', state->size);
+    strcpy(state->text + state->size, MICRO_MAPPING_PORT);
+}
+
+/**
+ * Parses an "ID:PORT" mapping with an id of state->size characters.
+ */
+static long long run_parse_id_port(MicroState* state, long ops) {
+    long valid = 0;
+    StringView id;
+    int port;
+    long long start = get_monotonic_ns();
+    for (long i = 0; i < ops; i++) {
+        valid += parse_id_port(state->text, &id, &port);
+    }
+    long long elapsedNs = get_monotonic_ns() - start;
+    if (valid != ops || id.length != state->size) {
+        bench_fail("Mapping should be valid");
+    }
+    return elapsedNs;
+}
+
+/**
+ * Makes state->text about MICRO_TEXT_SIZE bytes of lines, each of
+ * state->size characters.
+ */
+static void setup_lines(MicroState* state) {
+    long numLines = MICRO_TEXT_SIZE / (state->size + 1) + 1;
+    state->textLength = numLines * (state->size + 1);
+    state->text = calloc(state->textLength + 1, sizeof(char));
+    if (state->text == NULL) {
+        bench_fail("Out of memory");
+    }
+    memset(state->text, 'x', state->textLength);
+    for (long i = 0; i < numLines; i++) {
+        state->text[i * (state->size + 1) + state->size] = '\n';
+    }
+}
+
+/**
+ * Reads lines of state->size characters from an in-memory file, reusing
+ * one buffer like a Connection does, and starting over at its end.
+ */
+static long long run_get_line(MicroState* state, long ops) {
+    FILE* from = fmemopen(state->text, state->textLength, "r");
+    size_t capacity = PLANE_ID_SIZE;
+    char* line = calloc(capacity, sizeof(char));
+    if (from == NULL || line == NULL) {
+        bench_fail("Out of memory");
+    }
+    long long start = get_monotonic_ns();
+    for (long i = 0; i < ops; i++) {
+        if (!get_line(&line, &capacity, from)) {
+            rewind(from);
+        }
+    }
+    long long elapsedNs = get_monotonic_ns() - start;
+    fclose(from);
+    free(line);
+    return elapsedNs;
+}
+
+/**
+ * Generates state->size plane ids, as setup_list does, and maps each of them
+ * in an in-process mapper.
+ */
+static void setup_atc_mapper(MicroState* state) {
+    setup_list(state);
+    state->mapper = atc_create_mapper();
+    if (state->mapper == NULL) {
+        bench_fail("Out of memory");
+    }
+    for (long i = 0; i < state->size; i++) {
+        if (!atc_add_to_mapper(state->mapper, state->ids[i],
+                MICRO_MAPPED_PORT)) {
+            bench_fail("Mapping failed");
+        }
+    }
+}
+
+/**
+ * Frees everything setup_atc_mapper allocated.
+ */
+static void teardown_atc_mapper(MicroState* state) {
+    atc_destroy_mapper(state->mapper);
+    teardown_list(state);
+}
+
+/**
+ * Searches an in-process mapper of state->size ids, without going through a
+ * socket.
+ */
+static long long run_atc_search_mapper(MicroState* state, long ops) {
+    long long start = get_monotonic_ns();
+    for (long i = 0; i < ops; i++) {
+        char* id = state->ids[(i * 7919) % state->size];
+        if (atc_search_mapper(state->mapper, id) != MICRO_MAPPED_PORT) {
+            bench_fail("Search missed");
+        }
+    }
+    return get_monotonic_ns() - start;
+}
+
+/**
+ * Generates state->size plane ids, as setup_list does, and checks each of
+ * them in to an in-process control.
+ */
+static void setup_atc_control(MicroState* state) {
+    setup_list(state);
+    state->control = atc_create_control("MICRO", MICRO_CONTROL_INFO);
+    if (state->control == NULL) {
+        bench_fail("Out of memory");
+    }
+    for (long i = 0; i < state->size; i++) {
+        if (atc_check_in(state->control, state->ids[i]) == NULL) {
+            bench_fail("Check in failed");
+        }
+    }
+}
+
+/**
+ * Frees everything setup_atc_control allocated.
+ */
+static void teardown_atc_control(MicroState* state) {
+    atc_destroy_control(state->control);
+    teardown_list(state);
+}
+
+/**
+ * Checks planes in to an in-process control whose log already holds
+ * state->size of them, without going through a socket.
+ */
+static long long run_atc_check_in(MicroState* state, long ops) {
+    long long start = get_monotonic_ns();
+    for (long i = 0; i < ops; i++) {
+        if (atc_check_in(state->control, state->ids[i % state->size]) ==
+                NULL) {
+            bench_fail("Check in failed");
+        }
+    }
+    return get_monotonic_ns() - start;
+}
+
+/**
+ * Gets the sorted visitor log of an in-process control that state->size
+ * planes have checked in to.
+ */
+static long long run_atc_get_visitor_log(MicroState* state, long ops) {
+    long long start = get_monotonic_ns();
+    for (long i = 0; i < ops; i++) {
+        char* log = atc_get_visitor_log(state->control);
+        if (log == NULL || strlen(log) != state->size * PLANE_ID_SIZE) {
+            bench_fail("Log is the wrong length");
+        }
+        free(log);
+    }
+    return get_monotonic_ns() - start;
+}
+
+/* Every benchmark, in the order they are run */
+static MicroBenchmark benchmarks[] = {
+    {"add_list_item", true, setup_list, run_add_list_item, teardown_list},
+    {"search_list", true, setup_list, run_search_list, teardown_list},
+    {"sort_list", false, setup_list, run_sort_list, teardown_list},
+    {"get_list_as_str", true, setup_list, run_get_list_as_str,
+            teardown_list},
+    {"get_line", false, setup_lines, run_get_line, teardown_text},
+    {"is_valid_port", false, setup_digits, run_is_valid_port,
+            teardown_text},
+    {"string_contains_invalid_char", false, setup_digits,
+            run_string_contains_invalid_char, teardown_text},
+    {"parse_id_port", false, setup_mapping, run_parse_id_port,
+            teardown_text},
+    {"atc_search_mapper", true, setup_atc_mapper, run_atc_search_mapper,
+            teardown_atc_mapper},
+    {"atc_check_in", true, setup_atc_control, run_atc_check_in,
+            teardown_atc_control},
+    {"atc_get_visitor_log", false, setup_atc_control,
+            run_atc_get_visitor_log, teardown_atc_control}
+};
+
+/**
+ * Runs one thread's share of a measurement, once every thread is ready.
+ * Made to be called as a function pointer in order to start a new thread.
+ */
+static void* run_micro_thread(void* uncastedThread) {
+    MicroThread* thread = (MicroThread*) uncastedThread;
+    pthread_barrier_wait(&thread->state->start);
+    thread->elapsedNs = thread->benchmark->run(thread->state, thread->ops);
+    return NULL;
+}
+
+/**
+ * Measures "ops" operations of a benchmark on each of numThreads threads,
+ * with freshly set up state.
+ *
+ * Parameters:
+ *  - benchmark -> the benchmark to measure
+ *  - size -> the size to measure it at
+ *  - numThreads -> the number of threads to run it on
+ *  - ops -> the number of operations each thread does
+ *  - allocations -> where to write the number of allocations made
+ *
+ * Returns:
+ *  - the mean time each thread spent on its operations, in nanoseconds
+ */
+static long long measure(MicroBenchmark* benchmark, long size,
+        int numThreads, long ops, long long* allocations) {
+    MicroState state;
+    memset(&state, 0, sizeof(MicroState));
+    state.size = size;
+    state.numThreads = numThreads;
+    benchmark->setup(&state);
+    pthread_barrier_init(&state.start, NULL, numThreads);
+
+    MicroThread threads[MAX_CONTENDED_THREADS];
+    pthread_t tids[MAX_CONTENDED_THREADS];
+    long long startAllocations = get_allocation_count();
+    for (int i = 0; i < numThreads; i++) {
+        threads[i].benchmark = benchmark;
+        threads[i].state = &state;
+        threads[i].ops = ops;
+        if (i > 0 && pthread_create(&tids[i], NULL, run_micro_thread,
+                &threads[i])) {
+            bench_fail("Failed to start a thread");
+        }
+    }
+    // The calling thread does the first share itself, so that a
+    // single-threaded measurement doesn't involve any other thread
+    run_micro_thread(&threads[0]);
+    long long elapsedNs = threads[0].elapsedNs;
+    for (int i = 1; i < numThreads; i++) {
+        pthread_join(tids[i], NULL);
+        elapsedNs += threads[i].elapsedNs;
+    }
+    *allocations = get_allocation_count() - startAllocations;
+
+    pthread_barrier_destroy(&state.start);
+    benchmark->teardown(&state);
+    return elapsedNs / numThreads;
+}
+
+/**
+ * Measures a benchmark at one size and thread count, doubling the number of
+ * operations until a measurement takes at least minNs, then prints it.
+ */
+static void run_benchmark(MicroBenchmark* benchmark, long size,
+        int numThreads, long long minNs) {
+    long ops = 1;
+    long long allocations;
+    long long elapsedNs;
+    while (elapsedNs = measure(benchmark, size, numThreads, ops,
+            &allocations), elapsedNs < minNs && ops < LONG_MAX / 2) {
+        // Jump most of the way there once the time is big enough to trust
+        ops = elapsedNs > minNs / 100 ?
+                (long) (ops * 1.2 * minNs / elapsedNs) + 1 : ops * 2;
+    }
+
+    printf("%s,%ld,%d,%ld,%.1f,%.3f\n", benchmark->name, size, numThreads,
+            ops, elapsedNs / (double) ops,
+            allocations / (double) (ops * numThreads));
+    fflush(stdout);
+}
+
+/**
+ * microbench.
+ *
+ * Measures the List and string primitives on every request path, each at a
+ * range of sizes. For the List benchmarks the size is the length of the
+ * List, for get_line it is the length of each line, for is_valid_port
+ * and string_contains_invalid_char it is the length of the string checked,
+ * and for parse_id_port it is the length of the id. The atc_ benchmarks
+ * measure whole requests to in-process instances from libatc2310, with no
+ * I/O, and their size is the number of ids mapped or checked in.
+ * Benchmarks that the servers run on shared Lists are measured again with
+ * --threads threads (default 4) sharing one List. Each measurement runs
+ * for at least --ms milliseconds (default 200). --benchmark=NAME measures
+ * only the named benchmark.
+ *
+ * Allocations are counted by malloccount.c, which is linked in, so only
+ * malloc, calloc and realloc are counted.
+ *
+ * Prints CSV lines of:
+ * benchmark,size,threads,ops,ns_per_op,allocs_per_op
+ * where ops is the number of operations done by each thread and ns_per_op
+ * is the time each thread took per operation.
+ */
+int main(int argc, char** argv) {
+    Option options[] = {
+        {"benchmark", NULL, false},
+        {"threads", NULL, false},
+        {"ms", NULL, false}
+    };
+    parse_options(&argc, &argv, options, 3);
+
+    long threads = DEFAULT_CONTENDED_THREADS;
+    long ms = DEFAULT_MEASURE_MS;
+    char* only = options[0].present ? options[0].value : NULL;
+    if (argc != 1 || (options[0].present && only == NULL) ||
+            (options[1].present && !parse_option_long(&options[1], 2,
+            MAX_CONTENDED_THREADS, &threads)) ||
+            (options[2].present && !parse_option_long(&options[2], 1,
+            60000, &ms))) {
+        bench_fail("Usage: microbench [--benchmark=NAME] [--threads=N] "
+                "[--ms=N]");
+    }
+
+    int numBenchmarks = sizeof(benchmarks) / sizeof(MicroBenchmark);
+    bool found = false;
+    printf("benchmark,size,threads,ops,ns_per_op,allocs_per_op\n");
+    for (int i = 0; i < numBenchmarks; i++) {
+        if (only != NULL && strcmp(only, benchmarks[i].name) != 0) {
+            continue;
+        }
+        found = true;
+        for (int j = 0; j < NUM_MICRO_SIZES; j++) {
+            run_benchmark(&benchmarks[i], microSizes[j], 1, ms * NS_PER_MS);
+            if (benchmarks[i].contended) {
+                run_benchmark(&benchmarks[i], microSizes[j], threads,
+                        ms * NS_PER_MS);
+            }
+        }
+    }
+    if (!found) {
+        bench_fail("Unknown benchmark");
+    }
+    return 0;
+}
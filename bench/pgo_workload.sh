@@ -0,0 +1,19 @@
+#!/bin/bash
+#
+# pgo_workload.sh
+#
+# The workload that "make pgo" profiles an instrumented build with: a
+# mapper2310 serving loadgen2310's default mix of '?', '!' and '@', then
+# small mapper2310 + control2310 + roc2310 topologies flying fleets through
+# e2e.sh, which covers check ins, logs and route lookups. Instrumented
+# servers write their profile when they are sent SIGTERM, which is how both
+# benchmarks stop them.
+#
+# Usage: bench/pgo_workload.sh
+
+BIN_DIR=$(cd "$(dirname "$0")/.." && pwd)
+
+"$BIN_DIR/bench/loadgen2310" --mapper="$BIN_DIR/mapper2310" \
+        --requests=100000 > /dev/null || exit 1
+"$BIN_DIR/bench/e2e.sh" -k "10 100" -r "200" -l "4 16" -b "10 200 4" \
+        > /dev/null || exit 1
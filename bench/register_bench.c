@@ -0,0 +1,136 @@
+#include "benchutil.h"
+#include "../options.h"
+
+/* The number of registrations sent when --count isn't given */
+#define DEFAULT_REGISTRATIONS 100000
+/* The mapper2310 binary used when --mapper isn't given */
+#define DEFAULT_MAPPER "./mapper2310"
+/* Spreads sequential indices out so ids don't arrive already sorted */
+#define ID_SCRAMBLE 2654435761u
+
+/* The ways registrations can be sent to the mapper */
+enum RegisterMode {
+    REGISTER_BULK,
+    REGISTER_SINGLE,
+    REGISTER_CONNECT
+};
+typedef enum RegisterMode RegisterMode;
+
+/**
+ * Writes the id of the index'th airport to "buffer".
+ */
+static void airport_id(char* buffer, unsigned int index) {
+    sprintf(buffer, "A%08x", index * ID_SCRAMBLE);
+}
+
+/**
+ * Connects to the mapper, exiting the benchmark if that fails.
+ */
+static void connect_to_bench_mapper(BenchServer* mapper, Client* client) {
+    if (setup_client_on_port(mapper->port, client) != CLIENT_OK) {
+        bench_fail("Failed to connect to mapper");
+    }
+}
+
+/**
+ * Sends every registration to the mapper using the given mode.
+ */
+static void send_registrations(BenchServer* mapper, Client* client,
+        RegisterMode mode, int count) {
+    char id[16];
+    if (mode == REGISTER_BULK) {
+        fprintf(client->writeTo, "&\n");
+    }
+    for (int i = 0; i < count; i++) {
+        airport_id(id, i);
+        int port = 1 + i % 65535;
+        if (mode == REGISTER_BULK) {
+            fprintf(client->writeTo, "%s:%d\n", id, port);
+        } else if (mode == REGISTER_SINGLE) {
+            fprintf(client->writeTo, "!%s:%d\n", id, port);
+        } else {
+            // The way control2310 registers: a connection per airport
+            Client single;
+            connect_to_bench_mapper(mapper, &single);
+            fprintf(single.writeTo, "!%s:%d\n", id, port);
+            close_client(&single);
+        }
+    }
+    if (mode == REGISTER_BULK) {
+        fprintf(client->writeTo, ".\n");
+    }
+    fflush(client->writeTo);
+}
+
+/**
+ * Waits until the last registration sent is visible to lookups. Commands on
+ * one connection are handled in order so this returns as soon as the mapper
+ * has applied everything sent on "client".
+ */
+static void wait_for_registrations(Client* client, int count) {
+    char id[16];
+    char response[80];
+    airport_id(id, count - 1);
+    do {
+        fprintf(client->writeTo, "?%s\n", id);
+        fflush(client->writeTo);
+        if (!read_message(client->readFrom, response)) {
+            bench_fail("Mapper disconnected");
+        }
+    } while (strcmp(";", response) == 0);
+}
+
+/**
+ * register_bench.
+ *
+ * Starts a mapper2310 and measures how long it takes to register --count
+ * airports with it, either as one '&' batch (bulk), as '!' commands on one
+ * connection (single) or with a connection per '!' command (connect).
+ *
+ * Prints a CSV line of: mode,count,seconds,registrations_per_second
+ */
+int main(int argc, char** argv) {
+    Option options[] = {
+        {"mapper", NULL, false},
+        {"count", NULL, false},
+        {"mode", NULL, false}
+    };
+    parse_options(&argc, &argv, options, 3);
+
+    char* mapperPath = options[0].present ? options[0].value : DEFAULT_MAPPER;
+    long count = DEFAULT_REGISTRATIONS;
+    if (options[1].present && !parse_option_long(&options[1], 1,
+            100000000, &count)) {
+        bench_fail("Invalid count");
+    }
+    char* modeName = options[2].present ? options[2].value : "bulk";
+    RegisterMode mode;
+    if (strcmp(modeName, "bulk") == 0) {
+        mode = REGISTER_BULK;
+    } else if (strcmp(modeName, "single") == 0) {
+        mode = REGISTER_SINGLE;
+    } else if (strcmp(modeName, "connect") == 0) {
+        mode = REGISTER_CONNECT;
+    } else {
+        bench_fail("Usage: register_bench [--mapper=PATH] [--count=N] "
+                "[--mode=bulk|single|connect]");
+    }
+
+    BenchServer mapper;
+    char* mapperArgs[] = {mapperPath, NULL};
+    if (!start_bench_server(mapperArgs, &mapper)) {
+        bench_fail("Failed to start mapper");
+    }
+    Client client;
+    connect_to_bench_mapper(&mapper, &client);
+
+    long long start = get_monotonic_ns();
+    send_registrations(&mapper, &client, mode, count);
+    wait_for_registrations(&client, count);
+    double seconds = (get_monotonic_ns() - start) / (double) NS_PER_SECOND;
+
+    printf("%s,%ld,%.6f,%.0f\n", modeName, count, seconds, count / seconds);
+
+    stop_bench_server(&mapper);
+    return 0;
+}
@@ -0,0 +1,163 @@
+#include "benchutil.h"
+#include "../list.h"
+#include "../options.h"
+#include "../mapper2310.h"
+
+/* The number of airports registered when --count isn't given */
+#define DEFAULT_AIRPORTS 1000000
+/* Spreads sequential indices out so ids don't arrive already sorted */
+#define ID_SCRAMBLE 2654435761u
+/* The size of the buffer each id is written to */
+#define ID_BUFFER_SIZE 32
+
+/* The key that MappedAirports were kept in order by */
+#define MAPPED_AIRPORT_ID(airport) ((airport).id)
+
+/* The sorted vector mapper2310 kept its airports in before Registry */
+DEFINE_SORTED_VECTOR(AirportMap, airport_map, MappedAirport, char*,
+        MAPPED_AIRPORT_ID, strcmp)
+
+/* The ways airports can be stored */
+enum StorageMode {
+    STORAGE_LIST,
+    STORAGE_AIRPORT_MAP,
+    STORAGE_REGISTRY
+};
+typedef enum StorageMode StorageMode;
+
+/**
+ * The MappedAirport comparator that mapper2310 used with List, through a
+ * pointer to a pointer to each airport.
+ */
+static int list_airport_compare(const void* item1, const void* item2) {
+    const MappedAirport* airport1 = *(MappedAirport**) item1;
+    const MappedAirport* airport2 = *(MappedAirport**) item2;
+    return strcmp(airport1->id, airport2->id);
+}
+
+/**
+ * Gets the resident set size of this process, in bytes.
+ */
+static long get_rss_bytes(void) {
+    long pages = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm == NULL || fscanf(statm, "%*d %ld", &pages) != 1) {
+        bench_fail("Couldn't read /proc/self/statm");
+    }
+    fclose(statm);
+    return pages * sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * Writes the id of the index'th airport to "buffer". Every --long'th id is
+ * made too long to be stored inline in a Registry.
+ */
+static void airport_id(char* buffer, long index, long longEvery) {
+    unsigned int number = (unsigned int) (index * ID_SCRAMBLE);
+    if (longEvery != 0 && index % longEvery == 0) {
+        sprintf(buffer, "AIRPORT-%08x-LONG", number);
+    } else {
+        sprintf(buffer, "A%08x", number);
+    }
+}
+
+/**
+ * registry_bench.
+ *
+ * Registers --count airports the way mapper2310 has stored them: a List of
+ * pointers to separately allocated MappedAirports (list), a sorted vector of
+ * MappedAirports (airportmap), or a Registry (registry). Then looks every
+ * airport up again in a different order. Every --long'th id (default none)
+ * is too long to be inline in a Registry.
+ *
+ * Prints a CSV line of: mode,count,rss_bytes,bytes_per_airport,ns_per_search
+ */
+int main(int argc, char** argv) {
+    Option options[] = {
+        {"count", NULL, false},
+        {"mode", NULL, false},
+        {"long", NULL, false}
+    };
+    parse_options(&argc, &argv, options, 3);
+
+    long count = DEFAULT_AIRPORTS;
+    if (options[0].present && !parse_option_long(&options[0], 1,
+            100000000, &count)) {
+        bench_fail("Invalid count");
+    }
+    char* modeName = options[1].present ? options[1].value : "registry";
+    StorageMode mode;
+    if (strcmp(modeName, "list") == 0) {
+        mode = STORAGE_LIST;
+    } else if (strcmp(modeName, "airportmap") == 0) {
+        mode = STORAGE_AIRPORT_MAP;
+    } else if (strcmp(modeName, "registry") == 0) {
+        mode = STORAGE_REGISTRY;
+    } else {
+        bench_fail("Usage: registry_bench [--count=N] [--long=N] "
+                "[--mode=list|airportmap|registry]");
+    }
+    long longEvery = 0;
+    if (options[2].present && !parse_option_long(&options[2], 1, count,
+            &longEvery)) {
+        bench_fail("Invalid long");
+    }
+
+    List list;
+    AirportMap map = {0};
+    Registry registry;
+    char id[ID_BUFFER_SIZE];
+    long startRss = get_rss_bytes();
+    if (mode == STORAGE_LIST) {
+        create_list(&list, sizeof(MappedAirport*), NULL,
+                list_airport_compare);
+        for (long i = 0; i < count; i++) {
+            airport_id(id, i, longEvery);
+            MappedAirport* airport = calloc(1, sizeof(MappedAirport));
+            airport->id = strdup(id);
+            airport->port = 1 + i % 65535;
+            add_list_item(&list, airport);
+        }
+        sort_list(&list);
+    } else if (mode == STORAGE_AIRPORT_MAP) {
+        create_airport_map(&map);
+        for (long i = 0; i < count; i++) {
+            airport_id(id, i, longEvery);
+            MappedAirport airport = {strdup(id), 1 + i % 65535};
+            add_to_airport_map(&map, airport);
+        }
+        sort_airport_map(&map);
+    } else {
+        create_registry(&registry);
+        for (long i = 0; i < count; i++) {
+            airport_id(id, i, longEvery);
+            add_to_registry(&registry, id, 1 + i % 65535);
+        }
+    }
+    long rss = get_rss_bytes() - startRss;
+
+    // Look the airports up in a different order to the one they were added
+    long found = 0;
+    long long start = get_monotonic_ns();
+    for (long i = 0; i < count; i++) {
+        airport_id(id, (i * 7919) % count, longEvery);
+        if (mode == STORAGE_LIST) {
+            MappedAirport searchAirport = {id, -1};
+            MappedAirport* searchKey = &searchAirport;
+            found += bsearch(&searchKey, list.content, list.length,
+                    sizeof(ListItem), list_airport_compare) != NULL;
+        } else if (mode == STORAGE_AIRPORT_MAP) {
+            found += search_airport_map(&map, id) != NULL;
+        } else {
+            found += search_registry(&registry, id) != REGISTRY_NOT_FOUND;
+        }
+    }
+    long long elapsedNs = get_monotonic_ns() - start;
+    if (found != count) {
+        bench_fail("Lost an airport");
+    }
+
+    printf("%s,%ld,%ld,%.1f,%.1f\n", modeName, count, rss,
+            rss / (double) count, elapsedNs / (double) count);
+    return 0;
+}
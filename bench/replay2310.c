@@ -0,0 +1,555 @@
+#include "benchutil.h"
+#include "../options.h"
+#include "../histogram.h"
+#include "../capture.h"
+
+/* The most servers (airports) a capture can be replayed against */
+#define MAX_REPLAY_SERVERS 4096
+/* The number of lines a connection makes room for when its first arrives */
+#define INITIAL_REPLAY_LINES 16
+/* The number of connections to make room for when reading starts */
+#define INITIAL_REPLAY_CONNECTIONS 64
+/* The most milliseconds to wait for each line of a reply */
+#define REPLY_TIMEOUT_MS 2000
+/* The length of the longest command name in a report */
+#define MAX_COMMAND_NAME_LENGTH 16
+
+/* The kinds of request a replayed line can be */
+enum ReplayCommand {
+    REPLAY_SEARCH,
+    REPLAY_ADD,
+    REPLAY_PRINT,
+    REPLAY_BULK_ADD,
+    REPLAY_STATS,
+    REPLAY_CHECK_IN,
+    REPLAY_LOG,
+    REPLAY_OTHER,
+    NUM_REPLAY_COMMANDS
+};
+typedef enum ReplayCommand ReplayCommand;
+
+/* The name each ReplayCommand is reported as */
+static char* commandNames[NUM_REPLAY_COMMANDS] = {"search", "add", "print",
+        "bulk_add", "stats", "check_in", "log", "other"};
+
+/**
+ * One captured line, to be sent again.
+ * Members:
+ *  - timeNs -> when the line was read, relative to the start of the capture
+ *  - replyLines -> the number of lines the server replied with
+ *  - text -> the line, without its newline
+ */
+struct ReplayLine {
+    long long timeNs;
+    long long replyLines;
+    char* text;
+};
+typedef struct ReplayLine ReplayLine;
+
+/**
+ * One captured connection, to be made again.
+ * Members:
+ *  - server -> the index of the server (airport) it was made to
+ *  - openNs -> when it was opened, relative to the start of the capture
+ *  - closeNs -> when it was closed, or -1 if the capture ended first
+ *  - lines -> the lines read from it, in order
+ *  - numLines -> the number of lines
+ *  - capacity -> the number of lines there is room for
+ *  - opened -> whether its open record has been read
+ */
+struct ReplayConnection {
+    int server;
+    long long openNs;
+    long long closeNs;
+    ReplayLine* lines;
+    int numLines;
+    int capacity;
+    bool opened;
+};
+typedef struct ReplayConnection ReplayConnection;
+
+/**
+ * Everything shared by the threads replaying connections.
+ * Members:
+ *  - ports -> the port of each server to replay against
+ *  - numPorts -> the number of ports. A single port is used for every
+ *      server.
+ *  - control -> whether the capture is of a control2310 rather than a
+ *      mapper2310, which changes how lines are told apart
+ *  - speed -> how many times faster than captured to replay, or 0 to
+ *      replay as fast as possible
+ *  - startNs -> when the replay started
+ *  - lock -> regulates access to the members below
+ *  - finished -> signalled each time a connection finishes
+ *  - numFinished -> the number of connections that have finished
+ *  - latencies -> the time each kind of request took to be replied to
+ *  - errors -> the number of each kind of request that failed
+ *  - numSent -> the number of lines sent
+ */
+struct Replay {
+    char** ports;
+    int numPorts;
+    bool control;
+    double speed;
+    long long startNs;
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+    int numFinished;
+    Histogram latencies[NUM_REPLAY_COMMANDS];
+    long long errors[NUM_REPLAY_COMMANDS];
+    long long numSent;
+};
+typedef struct Replay Replay;
+
+/**
+ * A connection being replayed by its own thread.
+ * Members:
+ *  - replay -> the replay the connection is part of
+ *  - connection -> the captured connection
+ */
+struct ReplayWorker {
+    Replay* replay;
+    ReplayConnection* connection;
+};
+typedef struct ReplayWorker ReplayWorker;
+
+/**
+ * Reads a whole capture file, grouping its lines by connection.
+ *
+ * Returns:
+ *  - the captured connections, indexed by id, or NULL if the file isn't a
+ *      capture. The number of them is written to numConnections.
+ */
+static ReplayConnection* read_capture(char* path, int* numConnections) {
+    FILE* from = fopen(path, "rb");
+    char magic[CAPTURE_MAGIC_LENGTH];
+    if (from == NULL || fread(magic, sizeof(char), CAPTURE_MAGIC_LENGTH,
+            from) != CAPTURE_MAGIC_LENGTH ||
+            memcmp(magic, CAPTURE_MAGIC, CAPTURE_MAGIC_LENGTH) != 0) {
+        return NULL;
+    }
+
+    int capacity = INITIAL_REPLAY_CONNECTIONS;
+    ReplayConnection* connections = calloc(capacity,
+            sizeof(ReplayConnection));
+    *numConnections = 0;
+    int kind;
+    uint64_t id, timeNs, value, length;
+    while (kind = fgetc(from), kind != EOF) {
+        if (!read_capture_varint(from, &id) ||
+                !read_capture_varint(from, &timeNs) ||
+                id >= INT_MAX || (kind != CAPTURE_CLOSE &&
+                !read_capture_varint(from, &value))) {
+            break;
+        }
+        while (id >= capacity) {
+            connections = realloc(connections,
+                    2 * capacity * sizeof(ReplayConnection));
+            memset(connections + capacity, 0,
+                    capacity * sizeof(ReplayConnection));
+            capacity *= 2;
+        }
+        if (id >= *numConnections) {
+            *numConnections = id + 1;
+        }
+        ReplayConnection* connection = &connections[id];
+
+        if (kind == CAPTURE_OPEN) {
+            connection->opened = true;
+            connection->server = value;
+            connection->openNs = timeNs;
+            connection->closeNs = -1;
+        } else if (kind == CAPTURE_CLOSE) {
+            connection->closeNs = timeNs;
+        } else if (kind == CAPTURE_LINE) {
+            if (!read_capture_varint(from, &length)) {
+                break;
+            }
+            char* text = calloc(length + 1, sizeof(char));
+            if (fread(text, sizeof(char), length, from) != length) {
+                free(text);
+                break;
+            }
+            if (connection->numLines == connection->capacity) {
+                connection->capacity = connection->capacity == 0 ?
+                        INITIAL_REPLAY_LINES : 2 * connection->capacity;
+                connection->lines = realloc(connection->lines,
+                        connection->capacity * sizeof(ReplayLine));
+            }
+            ReplayLine* line = &connection->lines[connection->numLines++];
+            line->timeNs = timeNs;
+            line->replyLines = value;
+            line->text = text;
+        } else {
+            break;
+        }
+    }
+
+    fclose(from);
+    return connections;
+}
+
+/**
+ * Works out which kind of request a line is, the way the captured server
+ * would have.
+ */
+static ReplayCommand get_command(Replay* replay, char* text) {
+    if (replay->control) {
+        // See CONTROL_STATS_COMMAND in control.h
+        if (strcmp(":stats", text) == 0) {
+            return REPLAY_STATS;
+        } else if (strcmp("log", text) == 0) {
+            return REPLAY_LOG;
+        }
+        return REPLAY_CHECK_IN;
+    }
+
+    switch (text[0]) {
+        case '?':
+            return REPLAY_SEARCH;
+        case '!':
+            return REPLAY_ADD;
+        case '@':
+            return REPLAY_PRINT;
+        case '&':
+            return REPLAY_BULK_ADD;
+        case '#':
+            return REPLAY_STATS;
+        default:
+            return REPLAY_OTHER;
+    }
+}
+
+/**
+ * Sleeps until a time relative to the start of the capture comes around
+ * again, scaled by the replay's speed. Doesn't sleep at all when replaying
+ * as fast as possible.
+ */
+static void wait_until(Replay* replay, long long captureNs) {
+    if (replay->speed == 0) {
+        return;
+    }
+    long long wakeNs = replay->startNs + (long long) (captureNs /
+            replay->speed);
+    struct timespec wake = {wakeNs / NS_PER_SECOND, wakeNs % NS_PER_SECOND};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake,
+            NULL) != 0) {
+    }
+}
+
+/**
+ * Reads the reply to a replayed line. Replies listing what other
+ * connections have done so far, such as a log, may differ in length from
+ * the captured ones however closely the replay keeps to the captured times,
+ * so those are read up to the "." ending them. Any other reply is read as
+ * the number of lines the captured server replied with.
+ *
+ * Returns:
+ *  - true if the whole reply was read, otherwise false
+ */
+static bool read_reply(Client* client, ReplayLine* line,
+        ReplayCommand command) {
+    char reply[MESSAGE_BUFFER_SIZE];
+    if (command == REPLAY_LOG || command == REPLAY_STATS) {
+        while (read_client_message(client, reply) == CLIENT_OK) {
+            if (strcmp(".", reply) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    for (long long i = 0; i < line->replyLines; i++) {
+        if (read_client_message(client, reply) != CLIENT_OK) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Replays one captured connection: connects to the same server, sends each
+ * line at its captured time and reads as many lines back as the captured
+ * server replied with, timing each request from its send until its last
+ * reply line. Made to be called as a function pointer in order to start a
+ * new thread.
+ */
+static void* replay_connection(void* uncastedWorker) {
+    ReplayWorker* worker = (ReplayWorker*) uncastedWorker;
+    Replay* replay = worker->replay;
+    ReplayConnection* connection = worker->connection;
+    free(worker);
+
+    Histogram* latencies[NUM_REPLAY_COMMANDS] = {NULL};
+    long long errors[NUM_REPLAY_COMMANDS] = {0};
+    Client client;
+    char* port = replay->ports[replay->numPorts == 1 ? 0 :
+            connection->server];
+    // A reply shorter than the captured one would otherwise leave the
+    // connection waiting forever
+    ClientTimeouts timeouts = {NO_TIMEOUT, REPLY_TIMEOUT_MS, NO_TIMEOUT};
+    bool connected = setup_client_with_timeouts(port, &client,
+            &timeouts) == CLIENT_OK;
+    int sent = 0;
+    for (int i = 0; i < connection->numLines; i++) {
+        ReplayLine* line = &connection->lines[i];
+        ReplayCommand command = get_command(replay, line->text);
+        if (!connected) {
+            errors[command]++;
+            continue;
+        }
+
+        wait_until(replay, line->timeNs);
+        long long sendNs = get_monotonic_ns();
+        connected = send_client_message(&client, line->text) == CLIENT_OK;
+        if (connected && line->replyLines > 0) {
+            connected = read_reply(&client, line, command);
+        }
+        if (!connected) {
+            // Nothing more can be read in step with the capture
+            errors[command]++;
+            close_client(&client);
+            continue;
+        }
+        sent++;
+        if (line->replyLines > 0) {
+            if (latencies[command] == NULL) {
+                latencies[command] = calloc(1, sizeof(Histogram));
+            }
+            record_histogram_value(latencies[command],
+                    get_monotonic_ns() - sendNs);
+        }
+    }
+    if (connection->closeNs >= 0) {
+        wait_until(replay, connection->closeNs);
+    }
+    if (connected) {
+        close_client(&client);
+    }
+
+    pthread_mutex_lock(&replay->lock);
+    for (int i = 0; i < NUM_REPLAY_COMMANDS; i++) {
+        if (latencies[i] != NULL) {
+            merge_histogram(&replay->latencies[i], latencies[i]);
+            free(latencies[i]);
+        }
+        replay->errors[i] += errors[i];
+    }
+    replay->numSent += sent;
+    replay->numFinished++;
+    pthread_cond_signal(&replay->finished);
+    pthread_mutex_unlock(&replay->lock);
+    return NULL;
+}
+
+/**
+ * Splits a comma separated list of ports into replay->ports.
+ */
+static bool parse_ports(char* text, Replay* replay) {
+    replay->ports = calloc(MAX_REPLAY_SERVERS, sizeof(char*));
+    replay->numPorts = 0;
+    char* leftOver;
+    for (char* port = strtok_r(text, ",", &leftOver); port != NULL;
+            port = strtok_r(NULL, ",", &leftOver)) {
+        if (replay->numPorts == MAX_REPLAY_SERVERS || !is_valid_port(port)) {
+            return false;
+        }
+        replay->ports[replay->numPorts++] = port;
+    }
+    return replay->numPorts > 0;
+}
+
+/**
+ * Reads a report written by an earlier replay, for comparing against.
+ * Commands missing from it are left with a count of 0.
+ */
+static void read_baseline(char* path, long long* counts, double* p50s,
+        double* p99s) {
+    FILE* from = fopen(path, "r");
+    if (from == NULL) {
+        bench_fail("Couldn't read the baseline");
+    }
+
+    char name[MAX_COMMAND_NAME_LENGTH + 1];
+    long long count;
+    double p50, p99;
+    // Skip the header, then read the columns compared from each line
+    fscanf(from, "%*[^\n]\n");
+    while (fscanf(from, "%16[^,],%lld,%*d,%*f,%lf,%*f,%lf%*[^\n]\n", name,
+            &count, &p50, &p99) == 4) {
+        for (int i = 0; i <= NUM_REPLAY_COMMANDS; i++) {
+            char* command = i == NUM_REPLAY_COMMANDS ? "all" :
+                    commandNames[i];
+            if (strcmp(command, name) == 0) {
+                counts[i] = count;
+                p50s[i] = p50;
+                p99s[i] = p99;
+            }
+        }
+    }
+    fclose(from);
+}
+
+/**
+ * Prints one line of the report, with times in microseconds. If there is a
+ * baseline to compare against, its p50 and p99 and the change in each, as a
+ * percentage, are added.
+ */
+static void print_replay_metric(char* command, Histogram* latencies,
+        long long errors, bool compare, long long baselineCount,
+        double baselineP50, double baselineP99) {
+    double p50 = get_histogram_percentile(latencies, 50) / 1000.0;
+    double p99 = get_histogram_percentile(latencies, 99) / 1000.0;
+    printf("%s,%lld,%lld,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f", command,
+            latencies->count, errors,
+            get_histogram_mean(latencies) / 1000.0, p50,
+            get_histogram_percentile(latencies, 90) / 1000.0, p99,
+            get_histogram_percentile(latencies, 99.9) / 1000.0,
+            latencies->max / 1000.0);
+    if (!compare) {
+        printf("\n");
+    } else if (baselineCount == 0 || baselineP50 == 0 || baselineP99 == 0) {
+        printf(",,,,\n");
+    } else {
+        printf(",%.1f,%.1f,%.1f,%.1f\n", baselineP50, baselineP99,
+                100 * (p50 - baselineP50) / baselineP50,
+                100 * (p99 - baselineP99) / baselineP99);
+    }
+}
+
+/**
+ * Orders ReplayConnections by when they were opened, through pointers.
+ */
+static int compare_open_times(const void* item1, const void* item2) {
+    const ReplayConnection* connection1 = *(ReplayConnection**) item1;
+    const ReplayConnection* connection2 = *(ReplayConnection**) item2;
+    return (connection1->openNs > connection2->openNs) -
+            (connection1->openNs < connection2->openNs);
+}
+
+/**
+ * replay2310.
+ *
+ * Replays a capture made with a mapper2310 or control2310's --capture
+ * against a fresh instance listening on PORT. For a control2310 hosting
+ * several airports, give each airport's port in the order of its airports
+ * file. Every captured connection is made again at its captured time, and
+ * its lines sent at theirs, scaled by --speed (default 1, "max" for as fast
+ * as possible). Each request is timed from its send until its last reply
+ * line, reading as many lines as the captured server replied with, so the
+ * replay is only meaningful against an instance started the same way as
+ * the captured one (see read_reply). A reply that doesn't arrive within
+ * REPLY_TIMEOUT_MS is counted as an error and ends its connection's replay.
+ * --server=control tells control2310 requests apart.
+ *
+ * With --baseline=FILE, the p50 and p99 of each kind of request are
+ * compared against an earlier report, such as one from another build.
+ *
+ * Prints CSV with a line per kind of request seen and one for all of them:
+ * command,count,errors,mean_us,p50_us,p90_us,p99_us,p999_us,max_us and,
+ * with a baseline, baseline_p50_us,baseline_p99_us,p50_change_percent,
+ * p99_change_percent
+ */
+int main(int argc, char** argv) {
+    Option options[] = {
+        {"speed", NULL, false},
+        {"server", NULL, false},
+        {"baseline", NULL, false}
+    };
+    parse_options(&argc, &argv, options, 3);
+
+    Replay* replay = calloc(1, sizeof(Replay));
+    replay->speed = 1;
+    char* end = NULL;
+    if (options[0].present && options[0].value != NULL) {
+        replay->speed = strcmp("max", options[0].value) == 0 ? 0 :
+                strtod(options[0].value, &end);
+    }
+    char* server = options[1].present ? options[1].value : "mapper";
+    if (argc != 3 || (options[0].present && (options[0].value == NULL ||
+            (end != NULL && (*end != '\0' || replay->speed <= 0)))) ||
+            server == NULL || (strcmp("mapper", server) != 0 &&
+            strcmp("control", server) != 0) ||
+            (options[2].present && options[2].value == NULL) ||
+            !parse_ports(argv[2], replay)) {
+        bench_fail("Usage: replay2310 [--speed=N|max] "
+                "[--server=mapper|control] [--baseline=FILE] CAPTURE "
+                "PORT[,PORT...]");
+    }
+    replay->control = strcmp("control", server) == 0;
+
+    int numConnections;
+    ReplayConnection* connections = read_capture(argv[1], &numConnections);
+    if (connections == NULL) {
+        bench_fail("Couldn't read the capture");
+    }
+    ReplayConnection** order = calloc(numConnections,
+            sizeof(ReplayConnection*));
+    int numOpened = 0;
+    for (int i = 0; i < numConnections; i++) {
+        if (connections[i].opened && (replay->numPorts == 1 ||
+                connections[i].server < replay->numPorts)) {
+            order[numOpened++] = &connections[i];
+        }
+    }
+    if (numOpened < numConnections) {
+        fprintf(stderr, "Skipping %d connections with no port to replay "
+                "against\n", numConnections - numOpened);
+    }
+    qsort(order, numOpened, sizeof(ReplayConnection*), compare_open_times);
+
+    // Each connection gets its own thread once its open time comes around,
+    // just as the servers give each connection a thread
+    pthread_mutex_init(&replay->lock, NULL);
+    pthread_cond_init(&replay->finished, NULL);
+    replay->startNs = get_monotonic_ns();
+    for (int i = 0; i < numOpened; i++) {
+        wait_until(replay, order[i]->openNs);
+        ReplayWorker* worker = calloc(1, sizeof(ReplayWorker));
+        worker->replay = replay;
+        worker->connection = order[i];
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, replay_connection, worker)) {
+            bench_fail("Failed to start a connection thread");
+        }
+        pthread_detach(tid);
+    }
+    pthread_mutex_lock(&replay->lock);
+    while (replay->numFinished < numOpened) {
+        pthread_cond_wait(&replay->finished, &replay->lock);
+    }
+    pthread_mutex_unlock(&replay->lock);
+    double seconds = (get_monotonic_ns() - replay->startNs) /
+            (double) NS_PER_SECOND;
+    fprintf(stderr, "Replayed %lld lines on %d connections in %.3fs\n",
+            replay->numSent, numOpened, seconds);
+
+    bool compare = options[2].present;
+    long long baselineCounts[NUM_REPLAY_COMMANDS + 1] = {0};
+    double baselineP50s[NUM_REPLAY_COMMANDS + 1] = {0};
+    double baselineP99s[NUM_REPLAY_COMMANDS + 1] = {0};
+    if (compare) {
+        read_baseline(options[2].value, baselineCounts, baselineP50s,
+                baselineP99s);
+    }
+
+    printf("command,count,errors,mean_us,p50_us,p90_us,p99_us,p999_us,"
+            "max_us%s\n", compare ? ",baseline_p50_us,baseline_p99_us,"
+            "p50_change_percent,p99_change_percent" : "");
+    Histogram* all = calloc(1, sizeof(Histogram));
+    long long allErrors = 0;
+    for (int i = 0; i < NUM_REPLAY_COMMANDS; i++) {
+        merge_histogram(all, &replay->latencies[i]);
+        allErrors += replay->errors[i];
+        if (replay->latencies[i].count > 0 || replay->errors[i] > 0) {
+            print_replay_metric(commandNames[i], &replay->latencies[i],
+                    replay->errors[i], compare, baselineCounts[i],
+                    baselineP50s[i], baselineP99s[i]);
+        }
+    }
+    print_replay_metric("all", all, allErrors, compare,
+            baselineCounts[NUM_REPLAY_COMMANDS],
+            baselineP50s[NUM_REPLAY_COMMANDS],
+            baselineP99s[NUM_REPLAY_COMMANDS]);
+    return allErrors == 0 ? 0 : 1;
+}
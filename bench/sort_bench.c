@@ -0,0 +1,109 @@
+#include "benchutil.h"
+#include "../list.h"
+#include "../stringsort.h"
+#include "../options.h"
+
+/* The number of plane ids sorted when --count isn't given */
+#define DEFAULT_SORT_COUNT 10000000
+/* The size of a generated plane id, including its terminator */
+#define PLANE_ID_SIZE 10
+
+/* The ways a List can be sorted */
+enum SortMode {
+    SORT_QSORT,
+    SORT_KEY
+};
+typedef enum SortMode SortMode;
+
+/**
+ * Compares two plane ids in a List, for sort_list.
+ */
+static int compare_plane_ids(const void* id1, const void* id2) {
+    return strcmp(*(char**) id1, *(char**) id2);
+}
+
+/**
+ * Gets the key of a plane id in a List, for sort_strings_by_key.
+ */
+static char* get_plane_id_key(void* id) {
+    return (char*) id;
+}
+
+/**
+ * sort_bench.
+ *
+ * Measures how long it takes to sort a List of --count plane ids in a
+ * scrambled order, either with sort_list (qsort calling strcmp) or by
+ * sorting its items with sort_strings_by_key on --threads threads. Every id shares the same first
+ * character, like a fleet's ids often do, and a tenth of them are repeated.
+ *
+ * Prints a CSV line of: mode,count,threads,seconds,items_per_second
+ */
+int main(int argc, char** argv) {
+    Option options[] = {
+        {"count", NULL, false},
+        {"threads", NULL, false},
+        {"mode", NULL, false}
+    };
+    parse_options(&argc, &argv, options, 3);
+
+    long count = DEFAULT_SORT_COUNT;
+    if (options[0].present && !parse_option_long(&options[0], 1,
+            100000000, &count)) {
+        bench_fail("Invalid count");
+    }
+    long threads = 1;
+    if (options[1].present && !parse_option_long(&options[1], 1,
+            MAX_SORT_THREADS, &threads)) {
+        bench_fail("Invalid threads");
+    }
+    char* modeName = options[2].present ? options[2].value : "key";
+    SortMode mode;
+    if (strcmp(modeName, "qsort") == 0) {
+        mode = SORT_QSORT;
+    } else if (strcmp(modeName, "key") == 0) {
+        mode = SORT_KEY;
+    } else {
+        bench_fail("Usage: sort_bench [--count=N] [--threads=N] "
+                "[--mode=qsort|key]");
+    }
+
+    // All the ids live in one block so that generating them doesn't dwarf
+    // the sort being measured
+    char* ids = calloc(count, PLANE_ID_SIZE);
+    List list;
+    create_list(&list, sizeof(ListItem), NULL, compare_plane_ids);
+    if (ids == NULL) {
+        bench_fail("Out of memory");
+    }
+    for (long i = 0; i < count; i++) {
+        // Multiplying by an odd constant scrambles the order of the ids
+        unsigned int number = (unsigned int) (i % (count - count / 10 + 1)) *
+                2654435761u;
+        char* id = ids + i * PLANE_ID_SIZE;
+        snprintf(id, PLANE_ID_SIZE, "P%08x", number);
+        if (add_list_item(&list, id) != LIST_OK) {
+            bench_fail("Out of memory");
+        }
+    }
+
+    long long start = get_monotonic_ns();
+    bool sorted = mode == SORT_QSORT ? sort_list(&list) == LIST_OK :
+            sort_strings_by_key(list.content, list.length, get_plane_id_key,
+            threads);
+    double seconds = (get_monotonic_ns() - start) / (double) NS_PER_SECOND;
+    if (!sorted) {
+        bench_fail("Sort failed");
+    }
+
+    // Make sure the ids ended up in order
+    for (long i = 1; i < count; i++) {
+        if (strcmp(list.content[i - 1], list.content[i]) > 0) {
+            bench_fail("Ids are out of order");
+        }
+    }
+
+    printf("%s,%ld,%ld,%.6f,%.0f\n", modeName, count,
+            mode == SORT_QSORT ? 1 : threads, seconds, count / seconds);
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include "capture.h"
+
+/* See capture.h */
+bool open_capture(Capture* capture, char* path) {
+    memset(capture, 0, sizeof(Capture));
+    capture->to = fopen(path, "wb");
+    if (capture->to == NULL) {
+        return false;
+    }
+    pthread_mutex_init(&capture->lock, NULL);
+    capture->startNs = get_monotonic_ns();
+    capture->flushedNs = capture->startNs;
+
+    fwrite(CAPTURE_MAGIC, sizeof(char), CAPTURE_MAGIC_LENGTH, capture->to);
+    fflush(capture->to);
+    return true;
+}
+
+/**
+ * Writes a varint to a capture file.
+ */
+static void write_varint(FILE* to, uint64_t value) {
+    unsigned char bytes[CAPTURE_MAX_VARINT_LENGTH];
+    int length = 0;
+    do {
+        bytes[length] = value & 0x7F;
+        value >>= 7;
+        if (value != 0) {
+            bytes[length] |= 0x80;
+        }
+        length++;
+    } while (value != 0);
+    fwrite(bytes, sizeof(unsigned char), length, to);
+}
+
+/**
+ * Writes the start of a record, which every kind of record shares. The
+ * capture's lock must be held.
+ */
+static void write_record_start(Capture* capture, CaptureRecord kind,
+        uint64_t connection, long long timeNs) {
+    fputc(kind, capture->to);
+    write_varint(capture->to, connection);
+    write_varint(capture->to, timeNs < capture->startNs ? 0 :
+            timeNs - capture->startNs);
+}
+
+/* See capture.h */
+uint64_t record_capture_open(Capture* capture, int server) {
+    long long now = get_monotonic_ns();
+    pthread_mutex_lock(&capture->lock);
+    uint64_t connection = capture->nextConnection++;
+    write_record_start(capture, CAPTURE_OPEN, connection, now);
+    write_varint(capture->to, server);
+    pthread_mutex_unlock(&capture->lock);
+
+    return connection;
+}
+
+/* See capture.h */
+void record_capture_line(Capture* capture, uint64_t connection,
+        long long readNs, char* line, uint64_t replyLines) {
+    size_t length = strlen(line);
+    long long now = get_monotonic_ns();
+    pthread_mutex_lock(&capture->lock);
+    write_record_start(capture, CAPTURE_LINE, connection, readNs);
+    write_varint(capture->to, replyLines);
+    write_varint(capture->to, length);
+    fwrite(line, sizeof(char), length, capture->to);
+
+    // Busy connections may stay open for a long time, so don't leave their
+    // lines sitting in the buffer
+    if (now - capture->flushedNs > CAPTURE_FLUSH_NS) {
+        fflush(capture->to);
+        capture->flushedNs = now;
+    }
+    pthread_mutex_unlock(&capture->lock);
+}
+
+/* See capture.h */
+void record_capture_close(Capture* capture, uint64_t connection) {
+    long long now = get_monotonic_ns();
+    pthread_mutex_lock(&capture->lock);
+    write_record_start(capture, CAPTURE_CLOSE, connection, now);
+    fflush(capture->to);
+    capture->flushedNs = now;
+    pthread_mutex_unlock(&capture->lock);
+}
+
+/* See capture.h */
+bool read_capture_varint(FILE* from, uint64_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 7 * CAPTURE_MAX_VARINT_LENGTH; shift += 7) {
+        int byte = fgetc(from);
+        if (byte == EOF) {
+            return false;
+        }
+        *value |= (uint64_t) (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,111 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "utils.h"
+
+/* The option naming the file a server captures its request lines to */
+#define CAPTURE_OPTION "capture"
+/* The bytes every capture file starts with, including the format version */
+#define CAPTURE_MAGIC "CAP2310\001"
+/* The number of bytes in CAPTURE_MAGIC */
+#define CAPTURE_MAGIC_LENGTH 8
+/* The most bytes a varint in a capture file can take up */
+#define CAPTURE_MAX_VARINT_LENGTH 10
+/* The longest buffered records may go unwritten for while lines are read */
+#define CAPTURE_FLUSH_NS (100 * NS_PER_MS)
+
+/**
+ * The kinds of record in a capture file.
+ *
+ * A capture file is CAPTURE_MAGIC followed by records, each starting with a
+ * kind byte, then the connection's id and the time of the record in
+ * nanoseconds since the capture was opened. Every number is an unsigned
+ * LEB128 varint. After that:
+ *  - CAPTURE_OPEN -> the index of the server (airport) that accepted the
+ *      connection
+ *  - CAPTURE_LINE -> the number of lines sent in reply before the next line
+ *      was read, the length of the line and then the line without its
+ *      newline
+ *  - CAPTURE_CLOSE -> nothing
+ * Records of different connections may be out of order, but each
+ * connection's records are in order.
+ */
+enum CaptureRecord {
+    CAPTURE_OPEN,
+    CAPTURE_LINE,
+    CAPTURE_CLOSE
+};
+typedef enum CaptureRecord CaptureRecord;
+
+typedef struct Capture Capture;
+
+/**
+ * A file that the request lines read by a server are recorded to, so they
+ * can be replayed later with bench/replay2310.
+ * Members:
+ *  - to -> the capture file
+ *  - lock -> regulates access to every other member
+ *  - startNs -> the get_monotonic_ns() time that record times are relative
+ *      to
+ *  - flushedNs -> when the capture file was last flushed
+ *  - nextConnection -> the id the next connection to open is given
+ */
+struct Capture {
+    FILE* to;
+    pthread_mutex_t lock;
+    long long startNs;
+    long long flushedNs;
+    uint64_t nextConnection;
+};
+
+/**
+ * Creates a capture file at the given path, replacing anything there.
+ *
+ * Returns:
+ *  - true if the file was created, otherwise false
+ */
+bool open_capture(Capture* capture, char* path);
+
+/**
+ * Records a new connection, accepted by the server at index "server".
+ *
+ * Returns:
+ *  - the id of the connection, which its other records are given under
+ */
+uint64_t record_capture_open(Capture* capture, int server);
+
+/**
+ * Records a line read from a connection.
+ *
+ * Parameters:
+ *  - capture -> the capture to record the line to
+ *  - connection -> the id of the connection the line was read from
+ *  - readNs -> the get_monotonic_ns() time the line was read at
+ *  - line -> the line, without its newline
+ *  - replyLines -> the number of lines sent in reply to it
+ */
+void record_capture_line(Capture* capture, uint64_t connection,
+        long long readNs, char* line, uint64_t replyLines);
+
+/**
+ * Records a connection closing, then flushes the capture file so that
+ * nothing from a finished connection is left unwritten.
+ */
+void record_capture_close(Capture* capture, uint64_t connection);
+
+/**
+ * Reads a varint from a capture file.
+ *
+ * Returns:
+ *  - true if one was read, or false at the end of the file
+ */
+bool read_capture_varint(FILE* from, uint64_t* value);
+
+#endif
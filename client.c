@@ -1,50 +1,211 @@
 #include "client.h"
 
+/* The address of "localhost", resolved the first time it is needed */
+static struct sockaddr_in localhostAddress;
+/* Whether resolving "localhost" succeeded */
+static bool localhostResolved = false;
+/* Makes sure "localhost" is only resolved once, even across threads */
+static pthread_once_t resolveLocalhostOnce = PTHREAD_ONCE_INIT;
+/* Whether new connections should try TCP Fast Open */
+static bool fastOpenEnabled = false;
+
+/**
+ * Resolves "localhost" into localhostAddress. Made to be called through
+ * pthread_once so that every connection made by this process shares a single
+ * lookup.
+ */
+static void resolve_localhost(void) {
+    struct addrinfo* ai = 0;
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (getaddrinfo("localhost", NULL, &hints, &ai) != 0) {
+        return;   // could not work out the address
+    }
+    memcpy(&localhostAddress, ai->ai_addr, sizeof(struct sockaddr_in));
+    localhostResolved = true;
+    freeaddrinfo(ai);
+}
+
 /**
  * Resolves the port provided. This function assumes that any port provided
- * is trying to connect to a localhost.
+ * is trying to connect to a localhost. "localhost" is only resolved the first
+ * time this is called and the cached address is reused after that.
  * 
  * Parameters:
- *  - ai -> address info to use to resolve the host a
+ *  - address -> the address to write the resolved host and port to
  *  - port -> port to resolve
  * 
  * Returns:
  *  - CLIENT_OK -> if the port was successfully resolved
  *  - CLIENT_NOT_OK -> if the port was not successfully resolved
  */
-ClientError resolve_port(struct addrinfo** ai, char* port) {
-    struct addrinfo hints;
-    memset(&hints, 0, sizeof(struct addrinfo));
-    hints.ai_family = AF_INET;
-    hints.ai_socktype = SOCK_STREAM;
-
-    int error = getaddrinfo("localhost", port, &hints, ai);
-    if (error != CLIENT_OK) {
+ClientError resolve_port(struct sockaddr_in* address, char* port) {
+    pthread_once(&resolveLocalhostOnce, resolve_localhost);
+    if (!localhostResolved) {
         return CLIENT_NOT_OK;   // could not work out the address
     }
 
+    char* end;
+    long parsedPort = strtol(port, &end, BASE_10);
+    if (port[0] == '\0' || *end != '\0' || parsedPort < 0 || 
+            parsedPort > UINT16_MAX) {
+        return CLIENT_NOT_OK;
+    }
+
+    *address = localhostAddress;
+    address->sin_port = htons(parsedPort);
+    return CLIENT_OK;
+}
+
+/**
+ * Sets whether connections made after this call should use TCP Fast Open. If
+ * they do, the connection's first message is sent along with the SYN when the
+ * server allows it, which saves a round trip on short exchanges. Connections
+ * fall back to a normal handshake when Fast Open isn't available. Either way
+ * connect() returns straight away and the handshake is left to the first
+ * write, so only the I/O timeout applies to it, not the connect timeout.
+ * 
+ * Parameters:
+ *  - enabled -> true to use TCP Fast Open
+ */
+void set_client_fast_open(bool enabled) {
+    fastOpenEnabled = enabled;
+}
+
+/**
+ * Sets the options used on every client socket. Nagle's algorithm is turned
+ * off because every message is a single short line that is waited on, so
+ * delaying it to batch with later writes only adds latency.
+ * 
+ * Parameters:
+ *  - socketFd -> the socket to set the options of
+ */
+static void set_client_socket_options(int socketFd) {
+    int enabled = 1;
+    setsockopt(socketFd, IPPROTO_TCP, TCP_NODELAY, &enabled, sizeof(int));
+#ifdef TCP_FASTOPEN_CONNECT
+    if (fastOpenEnabled) {
+        setsockopt(socketFd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &enabled,
+                sizeof(int));
+    }
+#endif
+}
+
+/**
+ * Works out how long the next operation may block for given its own limit
+ * and the overall deadline. This is exposed so that callers polling several
+ * Clients at once can honour the same limits.
+ * 
+ * Parameters:
+ *  - limitMs -> the operation's own limit, or NO_TIMEOUT
+ *  - deadlineNs -> the overall deadline, or NO_TIMEOUT
+ *  - timeoutMs -> where to store the time the operation may block for, or
+ *      NO_TIMEOUT if it may block forever
+ * 
+ * Returns:
+ *  - CLIENT_OK -> if the operation may go ahead
+ *  - CLIENT_TIMED_OUT -> if the deadline has already passed
+ */
+ClientError get_timeout_ms(long limitMs, long long deadlineNs,
+        long* timeoutMs) {
+    *timeoutMs = limitMs;
+    if (deadlineNs == NO_TIMEOUT) {
+        return CLIENT_OK;
+    }
+
+    long long remainingNs = deadlineNs - get_monotonic_ns();
+    if (remainingNs <= 0) {
+        return CLIENT_TIMED_OUT;
+    }
+    // Round up so that less than a millisecond left still waits a little
+    long remainingMs = (remainingNs + NS_PER_MS - 1) / NS_PER_MS;
+    if (*timeoutMs == NO_TIMEOUT || remainingMs < *timeoutMs) {
+        *timeoutMs = remainingMs;
+    }
+
     return CLIENT_OK;
 }
 
+/**
+ * Sets how long reads and writes on the socket may block for before failing
+ * with EAGAIN.
+ * 
+ * Parameters:
+ *  - socketFd -> the socket to set the timeouts of
+ *  - timeoutMs -> the timeout in milliseconds, or NO_TIMEOUT for none
+ */
+static void set_socket_io_timeout(int socketFd, long timeoutMs) {
+    struct timeval timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_usec = (timeoutMs % 1000) * 1000;
+    setsockopt(socketFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, 
+            sizeof(struct timeval));
+    setsockopt(socketFd, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+            sizeof(struct timeval));
+}
+
 /**
  * Creates a connection with the port and stores the socket's file descriptor
- * into socketFd.
+ * into socketFd. If a timeout applies, the connection is made without
+ * blocking and abandoned if it is not complete within the timeout.
  * 
  * Parameters:
- *  - ai -> the resolved address to connect to
+ *  - address -> the resolved address to connect to
  *  - socketFd -> a pointer to memory where the socketFd can be stored.
+ *  - timeouts -> the limits on how long connecting may take
  * 
  * Returns:
  *  - CLIENT_OK -> if the address is successfully connected to
  *  - CLIENT NOT_OK -> if the address is not successfully connected to
+ *  - CLIENT_TIMED_OUT -> if the connection wasn't made within the timeout
  */
-ClientError connect_to_port(struct addrinfo* ai, int* socketFd) {
+ClientError connect_to_port(struct sockaddr_in* address, int* socketFd,
+        ClientTimeouts* timeouts) {
+    long timeoutMs;
+    if (get_timeout_ms(timeouts->connectMs, timeouts->deadlineNs,
+            &timeoutMs) != CLIENT_OK) {
+        return CLIENT_TIMED_OUT;
+    }
+
     *socketFd = socket(AF_INET, SOCK_STREAM, 0); // 0 == use default protocol
-    int error = connect(*socketFd, (struct sockaddr*)ai->ai_addr,
-            sizeof(struct sockaddr));
-    if (error != CLIENT_OK) {
+    set_client_socket_options(*socketFd);
+    if (timeoutMs == NO_TIMEOUT) {
+        int error = connect(*socketFd, (struct sockaddr*)address,
+                sizeof(struct sockaddr_in));
+        if (error != CLIENT_OK) {
+            close(*socketFd);
+            return CLIENT_NOT_OK;
+        }
+        return CLIENT_OK;
+    }
+
+    int flags = fcntl(*socketFd, F_GETFL);
+    fcntl(*socketFd, F_SETFL, flags | O_NONBLOCK);
+    int error = connect(*socketFd, (struct sockaddr*)address,
+            sizeof(struct sockaddr_in));
+    if (error != 0 && errno == EINPROGRESS) {
+        struct pollfd connecting = {*socketFd, POLLOUT, 0};
+        int numReady = poll(&connecting, 1, timeoutMs);
+        if (numReady == 0) {
+            close(*socketFd);
+            return CLIENT_TIMED_OUT;
+        }
+
+        // Find out whether the connection was made or refused
+        socklen_t errorSize = sizeof(int);
+        if (numReady < 0 || getsockopt(*socketFd, SOL_SOCKET, SO_ERROR,
+                &error, &errorSize) != 0) {
+            error = -1;
+        }
+    }
+    if (error != 0) {
+        close(*socketFd);
         return CLIENT_NOT_OK;
     }
+    fcntl(*socketFd, F_SETFL, flags);
 
     return CLIENT_OK;
 }
@@ -67,6 +228,18 @@ void open_read_write_files(Client* client, int socketFd) {
     client->socket = socketFd;
 }
 
+/**
+ * Creates a Client that is connected to the given port and waiting for any
+ * input or output on the created FILE*'s. Operations on the Client may block
+ * forever.
+ * 
+ * See setup_client_with_timeouts.
+ */
+ClientError setup_client_on_port(char* port, Client* client) {
+    ClientTimeouts noTimeouts = {NO_TIMEOUT, NO_TIMEOUT, NO_TIMEOUT};
+    return setup_client_with_timeouts(port, client, &noTimeouts);
+}
+
 /**
  * Creates a Client that is connected to the given port and waiting for any
  * input or output on the created FILE*'s.
@@ -78,27 +251,133 @@ void open_read_write_files(Client* client, int socketFd) {
  * Parameters:
  *  - client -> client to store FILE* and socket information to
  *  - port -> port to connect the client to
+ *  - timeouts -> the limits on how long connecting, and later reading and
+ *      writing with the Client, may block for
  * 
  * Returns:
  *  - CLIENT_OK -> if the connection occurs successfully
  *  - CLIENT_NOT_OK -> if the connection fails to resolve the host at the port
  *      or if the connection to the resolved host fails.
+ *  - CLIENT_TIMED_OUT -> if the connection wasn't made within the timeout
  */
-ClientError setup_client_on_port(char* port, Client* client) {
+ClientError setup_client_with_timeouts(char* port, Client* client,
+        ClientTimeouts* timeouts) {
     int error = CLIENT_OK;
-    struct addrinfo* ai = 0;
-    error = resolve_port(&ai, port);
+    struct sockaddr_in address;
+    error = resolve_port(&address, port);
     if (error != CLIENT_OK) {
         return CLIENT_NOT_OK;
     }
 
     int socketFd = 0;
-    error = connect_to_port(ai, &socketFd);
+    TRACE1(client__connect__start, port);
+    error = connect_to_port(&address, &socketFd, timeouts);
+    TRACE2(client__connect__end, port, error);
     if (error != CLIENT_OK) {
-        return CLIENT_NOT_OK;
+        return error;
     }
 
     open_read_write_files(client, socketFd);
+    client->timeouts = *timeouts;
+
+    return CLIENT_OK;
+}
+
+/**
+ * Closes both of the Client's files, and with them its socket. The Client
+ * can't be used again afterwards.
+ * 
+ * Parameters:
+ *  - client -> the connected client to close
+ */
+void close_client(Client* client) {
+    fclose(client->writeTo);
+    fclose(client->readFrom);
+    client->writeTo = NULL;
+    client->readFrom = NULL;
+    client->socket = -1;
+}
+
+/**
+ * Applies the Client's io timeout, shortened to fit its deadline, to its
+ * socket ahead of a read or a write.
+ * 
+ * Returns:
+ *  - CLIENT_OK -> if the read or write may go ahead
+ *  - CLIENT_TIMED_OUT -> if the deadline has already passed
+ */
+static ClientError prepare_client_io(Client* client) {
+    long timeoutMs;
+    if (get_timeout_ms(client->timeouts.ioMs, client->timeouts.deadlineNs,
+            &timeoutMs) != CLIENT_OK) {
+        return CLIENT_TIMED_OUT;
+    }
+    if (timeoutMs != NO_TIMEOUT) {
+        set_socket_io_timeout(client->socket, timeoutMs);
+    }
+
+    return CLIENT_OK;
+}
+
+/**
+ * Sends a message followed by a newline to the server the Client is 
+ * connected to, within the Client's timeouts.
+ * 
+ * Parameters:
+ *  - client -> the connected client to send the message with
+ *  - message -> the message to send
+ * 
+ * Returns:
+ *  - CLIENT_OK -> if the message was sent
+ *  - CLIENT_NOT_OK -> if the connection failed while sending
+ *  - CLIENT_TIMED_OUT -> if the message couldn't be sent within the timeout
+ */
+ClientError send_client_message(Client* client, char* message) {
+    if (prepare_client_io(client) != CLIENT_OK) {
+        return CLIENT_TIMED_OUT;
+    }
+
+    errno = 0;
+    send_message(client->writeTo, message);
+    if (ferror(client->writeTo)) {
+        clearerr(client->writeTo);
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 
+                CLIENT_TIMED_OUT : CLIENT_NOT_OK;
+    }
+
+    return CLIENT_OK;
+}
+
+/**
+ * Reads a single line from the server the Client is connected to, within the
+ * Client's timeouts.
+ * 
+ * Parameters:
+ *  - client -> the connected client to read with
+ *  - messageBuffer -> the buffer to write the line to
+ * 
+ * Returns:
+ *  - CLIENT_OK -> if any input was read
+ *  - CLIENT_NOT_OK -> if the connection was closed before anything was read
+ *  - CLIENT_TIMED_OUT -> if nothing arrived within the timeout
+ */
+ClientError read_client_message(Client* client, char* messageBuffer) {
+    if (prepare_client_io(client) != CLIENT_OK) {
+        return CLIENT_TIMED_OUT;
+    }
+
+    errno = 0;
+    TRACE1(client__read__start, client->socket);
+    bool hasInput = read_message(client->readFrom, messageBuffer);
+    TRACE2(client__read__end, client->socket, messageBuffer);
+    if (ferror(client->readFrom)) {
+        clearerr(client->readFrom);
+        return errno == EAGAIN || errno == EWOULDBLOCK ?
+                CLIENT_TIMED_OUT : CLIENT_NOT_OK;
+    }
+    if (!hasInput && strlen(messageBuffer) == 0) {
+        return CLIENT_NOT_OK;
+    }
 
     return CLIENT_OK;
 }
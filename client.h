@@ -9,6 +9,35 @@
 #include <netinet/in.h>
 #include <netdb.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <netinet/tcp.h>
+
+#include "utils.h"
+#include "trace.h"
+
+/* A timeout of this many milliseconds means there is no timeout */
+#define NO_TIMEOUT 0
+
+/**
+ * Limits on how long a Client may block for. Any limit set to NO_TIMEOUT is
+ * not enforced.
+ * Members:
+ *  - connectMs -> the most milliseconds to wait for a connection to be made
+ *  - ioMs -> the most milliseconds to wait for a single read or write
+ *  - deadlineNs -> a get_monotonic_ns() time after which no operation may
+ *      block any longer, regardless of the other limits
+ */
+struct ClientTimeouts {
+    long connectMs;
+    long ioMs;
+    long long deadlineNs;
+};
 
 /**
  * A Client struct is used to store details of a connected port.
@@ -16,23 +45,47 @@
  *  - readFrom -> the FILE* to read input from the server from
  *  - writeTo -> the FILE* to write output to the server to
  *  - socket -> the file descriptor (fd) for the client's scocket
+ *  - timeouts -> the limits on how long operations on this Client may block
  */
 struct Client {
     FILE* readFrom;
     FILE* writeTo;
     int socket;
+    struct ClientTimeouts timeouts;
 };
 
 /* ClientError is an enum of Client-related errors */
 enum ClientError {
     CLIENT_OK,
-    CLIENT_NOT_OK
+    CLIENT_NOT_OK,
+    CLIENT_TIMED_OUT
 };
 
 typedef struct Client Client;
+typedef struct ClientTimeouts ClientTimeouts;
 typedef enum ClientError ClientError;
 
 /* See client.c */
 ClientError setup_client_on_port(char* port, Client* client);
 
+/* See client.c */
+ClientError setup_client_with_timeouts(char* port, Client* client,
+        ClientTimeouts* timeouts);
+
+/* See client.c */
+void set_client_fast_open(bool enabled);
+
+/* See client.c */
+void close_client(Client* client);
+
+/* See client.c */
+ClientError get_timeout_ms(long limitMs, long long deadlineNs,
+        long* timeoutMs);
+
+/* See client.c */
+ClientError send_client_message(Client* client, char* message);
+
+/* See client.c */
+ClientError read_client_message(Client* client, char* messageBuffer);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,375 @@
+#ifndef CONTAINERS_H
+#define CONTAINERS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* The number of items a container makes room for when it first grows */
+#define CONTAINER_INITIAL_CAPACITY 8
+/* How much a container's capacity is multiplied by when it's full */
+#define CONTAINER_GROWTH_FACTOR 2
+/* Runs of this many items are insertion sorted before being merged */
+#define CONTAINER_SORT_RUN 16
+
+/*
+ * Type-specialized containers, generated by macros for each element type.
+ * Unlike List they store items by value and compare them with macros that
+ * are expanded in place, so there are no function pointer calls or casts
+ * from void* when searching or sorting. They don't lock, so a container
+ * shared between threads has to be guarded by its owner.
+ *
+ * Each DEFINE_ macro generates a struct called "Name" and static inline
+ * functions named after "name". For example DEFINE_VECTOR(PlaneNames,
+ * plane_names, ...) gives a PlaneNames struct along with create_plane_names,
+ * add_to_plane_names, sort_plane_names and destroy_plane_names.
+ *
+ * Items are ordered with KEY and COMPARE: KEY(item) gets the key of an item
+ * and COMPARE(key1, key2) compares two keys the same way strcmp does.
+ */
+
+/* A KEY for containers whose items are their own keys */
+#define CONTAINER_IDENTITY(item) (item)
+/* An EQUALS for hash maps keyed by strings */
+#define CONTAINER_STRING_EQUALS(key1, key2) (strcmp((key1), (key2)) == 0)
+
+/**
+ * Hashes a string for a hash map keyed by strings (FNV-1a).
+ */
+static inline unsigned int container_hash_string(const char* key) {
+    unsigned int hash = 2166136261u;
+    for (; *key != '\0'; key++) {
+        hash = (hash ^ (unsigned char) *key) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Generates a stable sort for arrays of Type:
+ *  - sort_<name>_items(items, scratch, numItems) -> sorts "items" into
+ *      ascending order, using "scratch" (room for numItems items) as working
+ *      space. Items with equal keys keep their order.
+ */
+#define DEFINE_SORT(name, Type, KEY, COMPARE) \
+static inline void sort_##name##_items(Type* items, Type* scratch, \
+        int numItems) { \
+    for (int start = 0; start < numItems; start += CONTAINER_SORT_RUN) { \
+        int end = start + CONTAINER_SORT_RUN < numItems ? \
+                start + CONTAINER_SORT_RUN : numItems; \
+        for (int i = start + 1; i < end; i++) { \
+            Type item = items[i]; \
+            int j = i; \
+            for (; j > start && COMPARE(KEY(item), KEY(items[j - 1])) < 0; \
+                    j--) { \
+                items[j] = items[j - 1]; \
+            } \
+            items[j] = item; \
+        } \
+    } \
+    \
+    Type* from = items; \
+    Type* to = scratch; \
+    for (int width = CONTAINER_SORT_RUN; width < numItems; width *= 2) { \
+        for (int left = 0; left < numItems; left += 2 * width) { \
+            int middle = left + width < numItems ? left + width : numItems; \
+            int right = middle + width < numItems ? \
+                    middle + width : numItems; \
+            int i = left; \
+            int j = middle; \
+            int k = left; \
+            while (i < middle && j < right) { \
+                if (COMPARE(KEY(from[j]), KEY(from[i])) < 0) { \
+                    to[k++] = from[j++]; \
+                } else { \
+                    to[k++] = from[i++]; \
+                } \
+            } \
+            while (i < middle) { \
+                to[k++] = from[i++]; \
+            } \
+            while (j < right) { \
+                to[k++] = from[j++]; \
+            } \
+        } \
+        Type* swap = from; \
+        from = to; \
+        to = swap; \
+    } \
+    if (from != items) { \
+        memcpy(items, from, numItems * sizeof(Type)); \
+    } \
+}
+
+/**
+ * Generates a growable array of Type, "Name", with:
+ *  - create_<name>(vector) -> sets up an empty vector
+ *  - reserve_<name>(vector, needed) -> makes room for "needed" items,
+ *      returning false if the memory couldn't be allocated
+ *  - add_to_<name>(vector, item) -> adds an item to the end, returning
+ *      false if the memory couldn't be allocated
+ *  - sort_<name>(vector) -> stable sorts the items by KEY, returning false
+ *      if the scratch memory couldn't be allocated
+ *  - destroy_<name>(vector) -> frees the vector's memory (but not anything
+ *      its items point to)
+ * Members of Name:
+ *  - items -> the items, in order
+ *  - length -> the number of items
+ *  - capacity -> the number of items there is room for
+ */
+#define DEFINE_VECTOR(Name, name, Type, KEY, COMPARE) \
+typedef struct Name Name; \
+struct Name { \
+    Type* items; \
+    int length; \
+    int capacity; \
+}; \
+\
+DEFINE_SORT(name, Type, KEY, COMPARE) \
+\
+static inline void create_##name(Name* vector) { \
+    vector->items = NULL; \
+    vector->length = 0; \
+    vector->capacity = 0; \
+} \
+\
+static inline bool reserve_##name(Name* vector, int needed) { \
+    if (needed <= vector->capacity) { \
+        return true; \
+    } \
+    int newCapacity = vector->capacity == 0 ? CONTAINER_INITIAL_CAPACITY : \
+            vector->capacity; \
+    while (newCapacity < needed) { \
+        newCapacity *= CONTAINER_GROWTH_FACTOR; \
+    } \
+    Type* newItems = realloc(vector->items, newCapacity * sizeof(Type)); \
+    if (newItems == NULL) { \
+        return false; \
+    } \
+    vector->items = newItems; \
+    vector->capacity = newCapacity; \
+    return true; \
+} \
+\
+static inline bool add_to_##name(Name* vector, Type item) { \
+    if (!reserve_##name(vector, vector->length + 1)) { \
+        return false; \
+    } \
+    vector->items[vector->length++] = item; \
+    return true; \
+} \
+\
+static inline bool sort_##name(Name* vector) { \
+    Type* scratch = calloc(vector->length, sizeof(Type)); \
+    if (scratch == NULL && vector->length != 0) { \
+        return false; \
+    } \
+    sort_##name##_items(vector->items, scratch, vector->length); \
+    free(scratch); \
+    return true; \
+} \
+\
+static inline void destroy_##name(Name* vector) { \
+    free(vector->items); \
+    create_##name(vector); \
+}
+
+/**
+ * Generates a vector of Type that is kept sorted by KEY with no two items
+ * having the same key. Everything DEFINE_VECTOR generates is generated too,
+ * though add_to_<name> shouldn't be used as it doesn't keep the order. Also:
+ *  - find_position_in_<name>(vector, key) -> the index of the first item
+ *      whose key is not less than "key"
+ *  - search_<name>(vector, key) -> a pointer to the item with "key", or NULL
+ *      if there isn't one. Only valid until the vector next changes.
+ *  - insert_into_<name>(vector, item) -> adds an item in order, returning
+ *      false if an item with its key is already there or the memory
+ *      couldn't be allocated
+ *  - merge_into_<name>(vector, items, numItems, numAdded) -> adds a batch of
+ *      items in any order, skipping any whose key is already in the vector
+ *      or earlier in the batch. The first *numAdded entries of "items" are
+ *      left as the items that were added and the rest are the rejected
+ *      duplicates. Returns false if the memory couldn't be allocated, in
+ *      which case nothing is added.
+ */
+#define DEFINE_SORTED_VECTOR(Name, name, Type, KeyType, KEY, COMPARE) \
+DEFINE_VECTOR(Name, name, Type, KEY, COMPARE) \
+\
+static inline int find_position_in_##name(Name* vector, KeyType key) { \
+    int low = 0; \
+    int high = vector->length; \
+    while (low < high) { \
+        int middle = low + (high - low) / 2; \
+        if (COMPARE(KEY(vector->items[middle]), key) < 0) { \
+            low = middle + 1; \
+        } else { \
+            high = middle; \
+        } \
+    } \
+    return low; \
+} \
+\
+static inline Type* search_##name(Name* vector, KeyType key) { \
+    int position = find_position_in_##name(vector, key); \
+    if (position == vector->length || \
+            COMPARE(KEY(vector->items[position]), key) != 0) { \
+        return NULL; \
+    } \
+    return &vector->items[position]; \
+} \
+\
+static inline bool insert_into_##name(Name* vector, Type item) { \
+    int position = find_position_in_##name(vector, KEY(item)); \
+    if (position < vector->length && \
+            COMPARE(KEY(vector->items[position]), KEY(item)) == 0) { \
+        return false; \
+    } \
+    if (!reserve_##name(vector, vector->length + 1)) { \
+        return false; \
+    } \
+    memmove(&vector->items[position + 1], &vector->items[position], \
+            (vector->length - position) * sizeof(Type)); \
+    vector->items[position] = item; \
+    vector->length++; \
+    return true; \
+} \
+\
+static inline bool merge_into_##name(Name* vector, Type* items, \
+        int numItems, int* numAdded) { \
+    *numAdded = 0; \
+    Type* scratch = calloc(numItems, sizeof(Type)); \
+    if (scratch == NULL && numItems != 0) { \
+        return false; \
+    } \
+    sort_##name##_items(items, scratch, numItems); \
+    \
+    int numNew = 0; \
+    int numRejected = 0; \
+    for (int i = 0; i < numItems; i++) { \
+        bool duplicate = numNew > 0 && \
+                COMPARE(KEY(items[i]), KEY(items[numNew - 1])) == 0; \
+        if (!duplicate) { \
+            int position = find_position_in_##name(vector, KEY(items[i])); \
+            duplicate = position < vector->length && COMPARE( \
+                    KEY(vector->items[position]), KEY(items[i])) == 0; \
+        } \
+        if (duplicate) { \
+            scratch[numRejected++] = items[i]; \
+        } else { \
+            items[numNew++] = items[i]; \
+        } \
+    } \
+    \
+    if (!reserve_##name(vector, vector->length + numNew)) { \
+        memcpy(items + numNew, scratch, numRejected * sizeof(Type)); \
+        free(scratch); \
+        return false; \
+    } \
+    int i = vector->length - 1; \
+    int j = numNew - 1; \
+    for (int k = vector->length + numNew - 1; j >= 0; k--) { \
+        if (i >= 0 && \
+                COMPARE(KEY(vector->items[i]), KEY(items[j])) > 0) { \
+            vector->items[k] = vector->items[i--]; \
+        } else { \
+            vector->items[k] = items[j--]; \
+        } \
+    } \
+    vector->length += numNew; \
+    \
+    memcpy(items + numNew, scratch, numRejected * sizeof(Type)); \
+    free(scratch); \
+    *numAdded = numNew; \
+    return true; \
+}
+
+/**
+ * Generates an open addressing hash map from KeyType to ValueType, "Name",
+ * using linear probing. HASH(key) hashes a key to an unsigned int and
+ * EQUALS(key1, key2) checks if two keys are the same.
+ *  - create_<name>(map) -> sets up an empty map
+ *  - get_from_<name>(map, key) -> a pointer to the value for "key", or NULL
+ *      if there isn't one. Only valid until the map next changes.
+ *  - add_to_<name>(map, key, value) -> adds a value for "key" unless it
+ *      already has one, returning false if the memory couldn't be allocated
+ *  - destroy_<name>(map) -> frees the map's memory (but not anything its
+ *      keys or values point to)
+ * Members of Name:
+ *  - entries -> the slots of the table
+ *  - length -> the number of slots in use
+ *  - capacity -> the number of slots, always 0 or a power of 2
+ */
+#define DEFINE_HASH_MAP(Name, name, KeyType, ValueType, HASH, EQUALS) \
+typedef struct Name##Entry Name##Entry; \
+typedef struct Name Name; \
+struct Name##Entry { \
+    bool used; \
+    KeyType key; \
+    ValueType value; \
+}; \
+struct Name { \
+    Name##Entry* entries; \
+    int length; \
+    int capacity; \
+}; \
+\
+static inline void create_##name(Name* map) { \
+    map->entries = NULL; \
+    map->length = 0; \
+    map->capacity = 0; \
+} \
+\
+static inline Name##Entry* find_##name##_entry(Name* map, KeyType key) { \
+    unsigned int mask = map->capacity - 1; \
+    unsigned int slot = HASH(key) & mask; \
+    while (map->entries[slot].used && \
+            !EQUALS(map->entries[slot].key, key)) { \
+        slot = (slot + 1) & mask; \
+    } \
+    return &map->entries[slot]; \
+} \
+\
+static inline ValueType* get_from_##name(Name* map, KeyType key) { \
+    if (map->capacity == 0) { \
+        return NULL; \
+    } \
+    Name##Entry* entry = find_##name##_entry(map, key); \
+    return entry->used ? &entry->value : NULL; \
+} \
+\
+static inline bool add_to_##name(Name* map, KeyType key, ValueType value) { \
+    if ((map->length + 1) * 2 > map->capacity) { \
+        Name##Entry* oldEntries = map->entries; \
+        int oldCapacity = map->capacity; \
+        int newCapacity = oldCapacity == 0 ? CONTAINER_INITIAL_CAPACITY : \
+                oldCapacity * 2; \
+        Name##Entry* newEntries = calloc(newCapacity, sizeof(Name##Entry)); \
+        if (newEntries == NULL) { \
+            return false; \
+        } \
+        map->entries = newEntries; \
+        map->capacity = newCapacity; \
+        for (int i = 0; i < oldCapacity; i++) { \
+            if (oldEntries[i].used) { \
+                *find_##name##_entry(map, oldEntries[i].key) = oldEntries[i]; \
+            } \
+        } \
+        free(oldEntries); \
+    } \
+    \
+    Name##Entry* entry = find_##name##_entry(map, key); \
+    if (!entry->used) { \
+        entry->used = true; \
+        entry->key = key; \
+        entry->value = value; \
+        map->length++; \
+    } \
+    return true; \
+} \
+\
+static inline void destroy_##name(Name* map) { \
+    free(map->entries); \
+    create_##name(map); \
+}
+
+#endif
@@ -0,0 +1,206 @@
+#include "control.h"
+
+/* The names each ControlRequest is reported under by the ":stats" command */
+static const char* const controlRequestNames[NUM_CONTROL_REQUESTS] = {
+    "check_in", "log", "stats", "invalid"
+};
+
+/* See control.h */
+bool create_control_stats(ServerStats* stats) {
+    return create_server_stats(stats, controlRequestNames,
+            NUM_CONTROL_REQUESTS);
+}
+
+/* See control.h */
+bool check_in_to_airport(Airport* data, char* plane) {
+    return add_sharded_list_copy(data->visitingPlaneNames, plane,
+            strlen(plane) + 1) == LIST_OK;
+}
+
+/**
+ * Gets the key a VisitingPlaneName is sorted by, which is the name itself.
+ * Made to be called as a function pointer by sort_strings_by_key.
+ */
+static char* get_plane_name_key(void* name) {
+    return (char*) name;
+}
+
+/* See control.h */
+void get_visitor_log(Airport* data, PlaneNames* planes) {
+    create_plane_names(planes);
+    ListItem* names;
+    merge_sharded_list(data->visitingPlaneNames, &names, &planes->length);
+    planes->items = (VisitingPlaneName*) names;
+    planes->capacity = planes->length;
+
+    // Long logs are split between a thread per CPU to sort
+    if (!sort_strings_by_key((void**) planes->items, planes->length,
+            get_plane_name_key, sysconf(_SC_NPROCESSORS_ONLN))) {
+        sort_plane_names(planes);
+    }
+}
+
+/**
+ * Prints a sorted visitor log to a connection, one plane id per line and
+ * followed by a "." line. A log holding only an empty id prints just the
+ * ".", as the log's lines joined together would be empty.
+ * 
+ * Parameters:
+ *  - connection -> the connection to write the log to
+ *  - planes -> the ids of the planes that have visited, in order
+ */
+static void print_visitor_log(Connection* connection, PlaneNames* planes) {
+    if (planes->length > 1 || 
+            (planes->length == 1 && strlen(planes->items[0]) > 0)) {
+        for (int i = 0; i < planes->length; i++) {
+            add_to_connection_scratch(connection, "%s\n", planes->items[i]);
+        }
+    }
+    add_to_connection_scratch(connection, ".\n");
+    send_connection_scratch(connection);
+}
+
+/**
+ * Prints a "NAME:VALUE" line for each of this control2310's stats, followed
+ * by a "." line. Along with the stats shared by every hosted airport, the
+ * size of this airport's visitor log and how long check-ins have waited on
+ * each other to add to it are printed.
+ * 
+ * Parameters:
+ *  - connection -> the connection to write the stats to
+ *  - data -> the airport the stats were asked for from
+ */
+static void print_stats(Connection* connection, Airport* data) {
+    int logLength;
+    long long logWaits, logWaitNs;
+    get_sharded_list_counts(data->visitingPlaneNames, &logLength, &logWaits,
+            &logWaitNs);
+
+    add_server_stats(data->stats, connection);
+    add_to_connection_scratch(connection,
+            "log:%d\nlog_lock_waits:%lld\nlog_lock_wait_ns:%lld\n.\n",
+            logLength, logWaits, logWaitNs);
+    send_connection_scratch(connection);
+}
+
+/**
+ * Handles input from a "client" (generally a roc2310) connected to the port.
+ * 
+ * If the received input is:
+ *  - "log" -> print the log of all plane (roc2310) id's that have visited
+ *      this control2310 to "to". This log is located in "data".
+ *  - ":stats" -> print this control2310's stats.
+ *  - anything else -> add the provided input to the log of plane's that have
+ *      visited, unless it isn't a valid plane id.
+ * 
+ * The request__start and request__end probes are fired around every
+ * command, the latter with the name it is counted under in the stats.
+ * 
+ * Parameters:
+ *  - connection -> the connection the input was read from, with the input
+ *      in connection->line. Any output is written back to it.
+ *  - data -> the data for this control2310 instance
+ *  - stats -> the stats of the thread handling the connection
+ */
+static void handle_control_command(Connection* connection, Airport* data,
+        ThreadStats* stats) {
+    char* message = connection->line;
+    RequestStats request;
+    TRACE1(request__start, message);
+    if (strcmp(CONTROL_STATS_COMMAND, message) == 0) {
+        start_request_stats(&request, CONTROL_STATS);
+        print_stats(connection, data);
+    } else if (string_contains_invalid_char(message)) {
+        start_request_stats(&request, CONTROL_INVALID);
+        request.suppressedErrors++;
+    } else if (strcmp("log", message) == 0) {
+        start_request_stats(&request, CONTROL_LOG);
+        PlaneNames planes;
+        get_visitor_log(data, &planes);
+        print_visitor_log(connection, &planes);
+        destroy_plane_names(&planes);
+    } else {
+        start_request_stats(&request, CONTROL_CHECK_IN);
+        check_in_to_airport(data, message);
+        send_connection_message(connection, data->info);
+    }
+    finish_request_stats(stats, &request, connection);
+    TRACE2(request__end, request.type, controlRequestNames[request.type]);
+}
+
+/* See control.h */
+void* handle_control_connection(void* uncastedArgs) {
+    ConnectionHandlerArgs* args = (ConnectionHandlerArgs*) uncastedArgs;
+    Airport* data = (Airport*) args->data;
+    Connection connection;
+    ServerError error = open_connection(args->connFd, &connection);
+    free(args);
+    if (error != SERVER_OK) {
+        return NULL;
+    }
+    if (data->capture != NULL) {
+        capture_connection(&connection, data->capture, data->index);
+    }
+    ThreadStats stats;
+    open_thread_stats(data->stats, &stats);
+
+    // Read any commands from the client
+    while (read_connection_line(&connection)) {
+        handle_control_command(&connection, data, &stats);
+    }
+
+    close_thread_stats(data->stats, &stats);
+    close_connection(&connection);
+    return NULL;
+}
+
+/* See control.h */
+ControlError setup_airport(Airport* data, char* id, char* info) {
+    if (string_contains_invalid_char(id)) {
+        return CONTROL_INVALID_ARGS;
+    }
+    data->id = calloc(strlen(id) + 1, sizeof(char));
+    if (data->id == NULL) {
+        return CONTROL_INVALID_ARGS;
+    }
+    strcpy(data->id, id);
+
+    if (string_contains_invalid_char(info)) {
+        return CONTROL_INVALID_ARGS;
+    }
+    data->info = calloc(strlen(info) + 1, sizeof(char));
+    if (data->info == NULL) {
+        return CONTROL_INVALID_ARGS;
+    }
+    strcpy(data->info, info);
+
+    long numShards = sysconf(_SC_NPROCESSORS_ONLN) *
+            VISITOR_LOG_SHARDS_PER_CPU;
+    if (numShards < 1) {
+        numShards = 1;
+    } else if (numShards > MAX_VISITOR_LOG_SHARDS) {
+        numShards = MAX_VISITOR_LOG_SHARDS;
+    }
+    ShardedList* visitingPlaneNames = calloc(1, sizeof(ShardedList));
+    if (visitingPlaneNames == NULL) {
+        return CONTROL_INVALID_ARGS;
+    }
+    if (create_sharded_list(visitingPlaneNames, numShards,
+            sizeof(VisitingPlaneName)) != LIST_OK) {
+        free(visitingPlaneNames);
+        return CONTROL_INVALID_ARGS;
+    }
+    data->visitingPlaneNames = visitingPlaneNames;
+
+    return CONTROL_OK;
+}
+
+/* See control.h */
+void destroy_airport(Airport* data) {
+    free(data->id);
+    free(data->info);
+    if (data->visitingPlaneNames != NULL) {
+        destroy_sharded_list(data->visitingPlaneNames);
+        free(data->visitingPlaneNames);
+    }
+}
@@ -0,0 +1,143 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "server.h"
+#include "list.h"
+#include "stringsort.h"
+#include "utils.h"
+#include "containers.h"
+#include "stats.h"
+
+/* The number of visitor log shards per core, see ShardedList */
+#define VISITOR_LOG_SHARDS_PER_CPU 2
+/* The most visitor log shards an airport may have */
+#define MAX_VISITOR_LOG_SHARDS 64
+/* The command that prints a control2310's stats. Plane ids can't contain a
+ * ':', so this can never be mistaken for a check-in */
+#define CONTROL_STATS_COMMAND ":stats"
+
+/* The types of request a control2310 counts in its stats */
+enum ControlRequest {
+    CONTROL_CHECK_IN,
+    CONTROL_LOG,
+    CONTROL_STATS,
+    CONTROL_INVALID,
+    NUM_CONTROL_REQUESTS
+};
+typedef enum ControlRequest ControlRequest;
+
+typedef struct Airport Airport;
+typedef char* VisitingPlaneName;
+
+/* A vector of VisitingPlaneNames, for sorting the visitor log */
+DEFINE_VECTOR(PlaneNames, plane_names, VisitingPlaneName, CONTAINER_IDENTITY,
+        strcmp)
+
+/**
+ * A struct to store all of the data for a control2310 instance.
+ * Members:
+ *  - id -> the id of this control2310
+ *  - info -> the info string of this control2310
+ *  - visitingPlaneNames -> a list of VisitingPlaneName. i.e. a list of
+ *      strings of the ids of the roc2310s that have connected to this
+ *      control2310. It is sharded so that concurrent check-ins don't wait
+ *      on each other, and only merged and sorted when the log is asked for.
+ *  - mapperPort -> the port of the mapper2310 this control2310 should connect
+ *      to
+ *  - port -> the port this airport is listening on for roc2310s
+ *  - stats -> the stats of every connection to this control2310 instance,
+ *      shared by all of the airports it hosts
+ *  - capture -> where request lines are captured to, or NULL if they
+ *      aren't. Shared by all of the airports hosted.
+ *  - index -> the position of this airport among those hosted
+ */
+struct Airport {
+    char* id;
+    char* info;
+    ShardedList* visitingPlaneNames;
+    int mapperPort;
+    int port;
+    ServerStats* stats;
+    Capture* capture;
+    int index;
+};
+
+/**
+ * Sets up the data struct for a single airport hosted by a control2310.
+ * Checks that the id and info follow the provided conventions before
+ * storing them into the data struct for later use. The airport has no port,
+ * stats or capture until they are given to it.
+ *
+ * Parameters:
+ *  - data -> the struct to store the data into
+ *  - id -> the id of the airport
+ *  - info -> the info string of the airport
+ *
+ * Returns:
+ *  - CONTROL_OK -> if the id and info are valid and stored successfully.
+ *  - CONTROL_INVALID_ARGS -> if the id or info is invalid as per the
+ *      assignment spec, or memory for them or the visitor log couldn't be
+ *      allocated. Whatever was set up is freed by destroy_airport.
+ */
+ControlError setup_airport(Airport* data, char* id, char* info);
+
+/**
+ * Creates the ServerStats shared by the airports of a control2310.
+ *
+ * Returns:
+ *  - true if the ServerStats was created, otherwise false
+ */
+bool create_control_stats(ServerStats* stats);
+
+/**
+ * Adds a plane to an airport's visitor log. The plane's id is copied into
+ * the log's shard, so a check-in only allocates when a block fills up.
+ *
+ * Parameters:
+ *  - data -> the airport being checked in to
+ *  - plane -> the id of the plane checking in
+ *
+ * Returns:
+ *  - true -> if the plane was added to the log
+ *  - false -> if memory for the log couldn't be allocated
+ */
+bool check_in_to_airport(Airport* data, char* plane);
+
+/**
+ * Gets the ids of every plane that has checked in to an airport, sorted.
+ *
+ * Parameters:
+ *  - data -> the airport to get the visitor log of
+ *  - planes -> where to store the ids, which point into the airport's log.
+ *      The vector itself belongs to the caller, who must destroy it.
+ */
+void get_visitor_log(Airport* data, PlaneNames* planes);
+
+/**
+ * Handler for connections to a control2310 airport. Made to be called as a
+ * function pointer in order to start a new thread.
+ *
+ * Parameters:
+ *  - uncastedArgs -> this struct is casted to a ConnectionHandlerArgs which
+ *      contains an Airport* struct for the data and a socketFd for the
+ *      connected roc2310.
+ *
+ * Return:
+ *  NULL - if the connection is ended successfully.
+ */
+void* handle_control_connection(void* uncastedArgs);
+
+/**
+ * Frees everything set up by setup_airport. The airport must no longer have
+ * any connections.
+ */
+void destroy_airport(Airport* data);
+
+#endif
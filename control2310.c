@@ -1,114 +1,5 @@
 #include "control2310.h"
 
-/**
- * Handles input from a "client" (generally a roc2310) connected to the port.
- * 
- * If the received input is:
- *  - "log" -> print the log of all plane (roc2310) id's that have visited
- *      this control2310 to "to". This log is located in "data".
- *  - anything else -> add the provided input to the log of plane's that have
- *      visited.
- * 
- * Parameters:
- *  - to -> the file to write output to
- *  - message -> the input from the connected client
- *  - data -> the data for this control2310 instance
- */
-void handle_client_command(FILE* to, char* message, Airport* data) {
-    if (string_contains_invalid_char(message)) {
-        return;
-    }
-
-    if (strcmp("log", message) == 0) {
-        char* planesAsString = calloc(1, sizeof(char));
-        size_t capacity = 1;
-
-        sort_list(data->visitingPlaneNames);
-        get_list_as_str(data->visitingPlaneNames, &planesAsString, &capacity);
-
-        if (strlen(planesAsString) > 0) {
-            send_message(to, planesAsString);
-        }
-        send_message(to, ".");
-    } else {
-        VisitingPlaneName name = calloc(strlen(message) + 1, sizeof(char));
-        strcpy(name, message);
-
-        add_list_item(data->visitingPlaneNames, name);
-        send_message(to, data->info);
-    }
-}
-
-/**
- * Handler for connections to this control2310 instance. Takes the arg
- * Made to be called as a function pointer in order to start a new thread.
- * 
- * Parameters:
- *  - uncastedArgs -> this struct is casted to a ConnectionHandlerArgs which
- *      contains an Airport* struct for the data and a socketFd for the
- *      connected roc2310.
- * 
- * Return:
- *  NULL - if the connection is ended successfully.
- */
-void* handle_control_connection(void* uncastedArgs) {
-    // Create a FILE* to read and write from the connected client
-    ConnectionHandlerArgs* args = (ConnectionHandlerArgs*) uncastedArgs;
-    FILE* readFrom = fdopen(dup(args->connFd), "r");
-    FILE* writeTo = fdopen(args->connFd, "w");
-
-    // Read any commands from the client
-    char* commandMessage = calloc(80, sizeof(char));
-    while(read_message(readFrom, commandMessage)) {
-        Airport* commandData = (Airport*) args->data;
-        handle_client_command(writeTo, commandMessage, commandData);
-    }
-
-    fclose(readFrom);
-    fclose(writeTo);
-    return NULL;
-}
-
-/**
- * A wrapper around strcmp. 
- * 
- * For use with searching and sorting List structs of type VisitedAirportInfo
- * (aka char*).
- * 
- * Parameters:
- *  - item1 -> the first item to compare
- *  - item2 -> the second item to compare
- * 
- * Returns:
- *  - negative integer -> if item1 < item2
- *  - zero -> if item1 == item2
- *  - positive integer -> if item1 > item2
- */
-int visiting_plane_name_compare(const void* item1, const void* item2) {
-    return strcmp(*(char* const*) item1, *(char* const*) item2);
-}
-
-/**
- * A wrapper around snprintf. 
- * 
- * For use with printing List structs of type VisitedAirportInfo (aka char*).
- * 
- * Parameters:
- *  - buffer -> the buffer to write to using snprintf
- *  - capacity -> the size of the buffer
- *  - toConvert -> the item to be converted to a string
- * 
- * Returns:
- *  - The output of snprintf. Which is the number of characters written to the
- *      buffer excluding the null terminator. If the number of characters to be
- *      written is greater than the capacity then, the write is truncated and
- *      the number of characters that would have been written is returned.
- */
-int visiting_plane_name_to_string(char* buffer, size_t capacity,
-        ListItem toConvert) {
-    return snprintf(buffer, capacity, "%s", (char*) toConvert);
-}
-
 /**
  * Sets up this control2310 instance's data struct using the argv arguments.
  * Parses each argument and checks that it follows the provided conventions
@@ -124,64 +15,173 @@ int visiting_plane_name_to_string(char* buffer, size_t capacity,
  *      assignment spec.
  */
 ControlError setup_control_data(Airport* data, char** argv) {
-    if (string_contains_invalid_char(argv[1])) {
+    return setup_airport(data, argv[1], argv[2]);
+}
+
+/**
+ * Reads the airports to host from a file with one "ID:INFO" line per
+ * airport. Blank lines are skipped. The same rules apply to each ID and INFO
+ * as to the id and info args of a single control2310.
+ * 
+ * Parameters:
+ *  - path -> the path of the file to read
+ *  - airports -> where to store the array of set up airports
+ *  - numAirports -> where to store the number of airports read
+ * 
+ * Returns:
+ *  - CONTROL_OK -> if the file was read and every airport in it is valid.
+ *  - CONTROL_INVALID_ARGS -> if the file can't be read, has no airports,
+ *      any of its lines is not a valid "ID:INFO" pair with a non-empty ID,
+ *      or memory for the airports couldn't be allocated.
+ */
+ControlError load_airports(char* path, Airport** airports, int* numAirports) {
+    FILE* from = fopen(path, "r");
+    if (from == NULL) {
         return CONTROL_INVALID_ARGS;
     }
-    data->id = calloc(strlen(argv[1]) + 1, sizeof(char));
-    strcpy(data->id, argv[1]);
 
+    int capacity = INITIAL_AIRPORTS_CAPACITY;
+    *airports = calloc(capacity, sizeof(Airport));
+    *numAirports = 0;
 
-    if (string_contains_invalid_char(argv[2])) {
+    size_t lineCapacity = 80;
+    char* line = calloc(lineCapacity, sizeof(char));
+    if (*airports == NULL || line == NULL) {
+        free(*airports);
+        *airports = NULL;
+        free(line);
+        fclose(from);
         return CONTROL_INVALID_ARGS;
     }
-    data->info = calloc(strlen(argv[2]) + 1, sizeof(char));
-    strcpy(data->info, argv[2]);
+    ControlError error = CONTROL_OK;
+    bool moreInput = true;
+    while (moreInput && error == CONTROL_OK) {
+        moreInput = get_line(&line, &lineCapacity, from);
+        if (strlen(line) == 0) {
+            continue;
+        }
 
-    data->visitingPlaneNames = calloc(1, sizeof(List));
-    create_list(data->visitingPlaneNames, sizeof(VisitingPlaneName), 
-            visiting_plane_name_to_string, visiting_plane_name_compare); 
+        // INFO can't contain a ':' so the first one must end the ID
+        char* separator = strchr(line, ':');
+        if (separator == NULL) {
+            error = CONTROL_INVALID_ARGS;
+            break;
+        }
+        *separator = '\0';
+        if (strlen(line) == 0) {
+            error = CONTROL_INVALID_ARGS;
+            break;
+        }
 
-    return CONTROL_OK;
+        if (*numAirports == capacity) {
+            Airport* grown = realloc(*airports,
+                    capacity * 2 * sizeof(Airport));
+            if (grown == NULL) {
+                error = CONTROL_INVALID_ARGS;
+                break;
+            }
+            capacity *= 2;
+            *airports = grown;
+        }
+        error = setup_airport(&(*airports)[*numAirports], line,
+                separator + 1);
+        (*numAirports)++;
+    }
+
+    free(line);
+    fclose(from);
+
+    if (error == CONTROL_OK && *numAirports == 0) {
+        return CONTROL_INVALID_ARGS;
+    }
+    return error;
 }
 
 /**
- * Connects to the mapper2310 instance at the provided port and sends this
- * control2310 instance's control id and port as a formated !ID:PORT command.
- * After this, it disconnects from the mapper.
+ * Raises this process's open file limit as far as it is allowed to go. Every
+ * hosted airport needs its own listening socket on top of the sockets for
+ * connected roc2310s, so the default limit is too small for large networks.
+ */
+void raise_open_file_limit(void) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+/**
+ * Connects to the mapper2310 instance at the provided port and sends each
+ * airport's id and port to it, either as a formated !ID:PORT command or, for
+ * many airports, as a single bulk '&' command. After this, it disconnects
+ * from the mapper.
  * 
  * Parameters:
- *  - controlPort -> the string version of the port to send to the mapper
  *  - mapperPort -> the port to connect to the mapper
- *  - data -> further data including the id that is required to connect to the
- *      mapper and send it messages.
+ *  - airports -> the airports to register, each with its port already set
+ *  - numAirports -> the number of airports to register
  * 
  * Returns:
  *  - CONTROL_OK -> if the mapper was successfully connected to and the
- *      details of this control2310 instance were sent.
+ *      details of every airport were sent.
  *  - CONTROL_INVALID_MAPPER -> if an attempt was made to connect to the
  *      mapper2310 instance, however failed from a port that isn't used
  *      for a mapper2310 instance.
  */
-ControlError register_with_mapper(char* controlPort, char* mapperPort,
-        Airport* data) {
+ControlError register_with_mapper(char* mapperPort, Airport* airports,
+        int numAirports) {
     ControlError error = CONTROL_OK;
     Client* client = calloc(1, sizeof(Client));
     error = (ControlError) setup_client_on_port(mapperPort, client);
     if (error != CONTROL_OK) {
+        free(client);
         return CONTROL_INVALID_MAPPER;
     }
 
-    char* messageBuffer = calloc(strlen(data->id) + 
-            strlen(controlPort) + 3, sizeof(char));
-    sprintf(messageBuffer, "!%s:%s", data->id, controlPort);
-    send_message(client->writeTo, messageBuffer);
+    // A single airport uses the plain '!' command from the spec, while many
+    // airports are sent as one '&' batch so the mapper can add them all at
+    // once. Only flush once everything is buffered so it is sent in as few
+    // writes as possible.
+    if (numAirports == 1) {
+        fprintf(client->writeTo, "!%s:%d\n", airports[0].id,
+                airports[0].port);
+    } else {
+        fprintf(client->writeTo, "&\n");
+        for (int i = 0; i < numAirports; i++) {
+            fprintf(client->writeTo, "%s:%d\n", airports[i].id,
+                    airports[i].port);
+        }
+        fprintf(client->writeTo, ".\n");
+    }
+    fflush(client->writeTo);
 
-    shutdown(client->socket, 2);
+    close_client(client);
     free(client);
 
     return CONTROL_OK;
 }
 
+/**
+ * Prints the port of each airport hosted by this control2310 to stdout. A
+ * single airport's port is printed on its own as per the spec, while an
+ * instance hosting an airports file prints an "ID:PORT" line per airport.
+ * 
+ * Parameters:
+ *  - airports -> the hosted airports, each with its port already set
+ *  - numAirports -> the number of hosted airports
+ *  - fromFile -> true if the airports were read from an airports file
+ */
+void print_airport_ports(Airport* airports, int numAirports, bool fromFile) {
+    for (int i = 0; i < numAirports; i++) {
+        if (fromFile) {
+            fprintf(stdout, "%s:%d\n", airports[i].id, airports[i].port);
+        } else {
+            fprintf(stdout, "%d\n", airports[i].port);
+        }
+    }
+    fflush(stdout);
+}
+
 /**
  * control2310.
  * 
@@ -190,44 +190,92 @@ ControlError register_with_mapper(char* controlPort, char* mapperPort,
  * roc2310 instance's to connect to. Once a connection is detected, it is
  * passed to a thread and handled seperately from the main thread.
  * 
+ * Options go before the spec's arguments and are ended by "--", see
+ * parse_terminated_options, so that "control2310 --capture=FILE -- id info"
+ * still leaves "control2310 --capture=FILE id info" meaning what the spec
+ * says. The one command line this changes is an id that is exactly one of
+ * the options below followed by an info of "--".
+ *
+ * If "--airports=FILE" is given then every airport listed in FILE is hosted
+ * by this instance instead, each on its own port but sharing one accept loop.
+ * In that case the only positional argument is the optional mapper port.
+ * 
+ * If "--capture=FILE" is given then every request line read is recorded to
+ * FILE, see capture.h, so the traffic can be replayed with bench/replay2310.
+ * Connections are captured with the index of the airport they were made to.
+ * 
  * For exit conditions, see error.c.
  */
 int main(int argc, char** argv) {
     int error;
 
-    if (argc != 3 && argc != 4) {
-        handle_control_error(CONTROL_INVALID_NUM_ARGS);
-    }
+    Option options[NUM_CONTROL_OPTIONS] = {
+        {AIRPORTS_OPTION, NULL, false},
+        {CAPTURE_OPTION, NULL, false}
+    };
+    parse_terminated_options(&argc, &argv, options, NUM_CONTROL_OPTIONS);
+    bool fromFile = options[0].present;
 
-    // Creates a struct to store this airports id, info, port and mapper_port
-    Airport* data = calloc(1, sizeof(Airport));
-    error = setup_control_data(data, argv);
+    // Creates the structs to store each airport's id, info, port and
+    // mapper_port
+    Airport* airports;
+    int numAirports = 1;
+    char* mapperPort = NULL;
+    if (fromFile) {
+        if ((argc != 1 && argc != 2) || options[0].value == NULL) {
+            handle_control_error(CONTROL_INVALID_NUM_ARGS);
+        }
+        mapperPort = argc == 2 ? argv[1] : NULL;
+        error = load_airports(options[0].value, &airports, &numAirports);
+    } else {
+        if (argc != 3 && argc != 4) {
+            handle_control_error(CONTROL_INVALID_NUM_ARGS);
+        }
+        mapperPort = argc == 4 ? argv[3] : NULL;
+        airports = calloc(1, sizeof(Airport));
+        error = setup_control_data(airports, argv);
+    }
     if (error != CONTROL_OK) {
         handle_control_error(error);
     }
 
     // Start a server for clients (in this case rocs/planes) to connect to
-    Server* control = calloc(1, sizeof(Server));
-    error = setup_server(control);
+    if (numAirports > 1) {
+        raise_open_file_limit();
+    }
+    ServerGroup* controls = calloc(1, sizeof(ServerGroup));
+    error = setup_server_group(controls, numAirports);
     if (error != SERVER_OK) {
         handle_control_error(CONTROL_OK);
     }
+    ServerStats* stats = calloc(1, sizeof(ServerStats));
+    create_control_stats(stats);
+    Capture* capture = NULL;
+    if (options[1].present) {
+        capture = calloc(1, sizeof(Capture));
+        if (options[1].value == NULL ||
+                !open_capture(capture, options[1].value)) {
+            handle_control_error(CONTROL_INVALID_ARGS);
+        }
+    }
+    for (int i = 0; i < numAirports; i++) {
+        airports[i].port = controls->servers[i].port;
+        airports[i].stats = stats;
+        airports[i].capture = capture;
+        airports[i].index = i;
+    }
 
-    char port[6];
-    sprintf(port, "%d", control->port);
-
-    if (argc == 4) {
-        if (!is_valid_port(argv[3])) {
+    if (mapperPort != NULL) {
+        if (!is_valid_port(mapperPort)) {
             handle_control_error(CONTROL_INVALID_PORT);
         }
     }
 
-    fprintf(stdout, "%d\n", control->port);
-    fflush(stdout);
+    print_airport_ports(airports, numAirports, fromFile);
 
     // If a mapper port has been provided
-    if (argc == 4) {
-        error = register_with_mapper(port, argv[3], data);
+    if (mapperPort != NULL) {
+        error = register_with_mapper(mapperPort, airports, numAirports);
         if (error != CONTROL_OK) {
             handle_control_error(error);
         }
@@ -235,9 +283,11 @@ int main(int argc, char** argv) {
     
     // Wait for any connections and handle on another thread.
     int connFd;
-    while (connFd = connection_received(control), connFd >= 0) {
+    int airportIndex;
+    while (connFd = group_connection_received(controls, &airportIndex),
+            connFd >= 0) {
         error = start_connection_handling_thread(
-                handle_control_connection, data, connFd);
+                handle_control_connection, &airports[airportIndex], connFd);
     }
 
     return CONTROL_OK;
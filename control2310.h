@@ -4,32 +4,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <sys/resource.h>
 
 #include "error.h"
 #include "server.h"
+#include "control.h"
 #include "client.h"
 #include "list.h"
 #include "utils.h"
+#include "options.h"
 
-typedef struct Airport Airport;
-typedef char* VisitingPlaneName;
-
-/**
- * A struct to store all of the data for a control2310 instance.
- * Members:
- *  - id -> the id of this control2310
- *  - info -> the info string of this control2310
- *  - visitingPlaneNames -> a list of VisitingPlaneName. i.e. a list of
- *      strings of the ids of the roc2310s that have connected to this
- *      control2310.
- *  - mapperPort -> the port of the mapper2310 this control2310 should connect
- *      to
- */
-struct Airport {
-    char* id;
-    char* info;
-    List* visitingPlaneNames;
-    int mapperPort;
-};
+/* The option naming a file of "ID:INFO" lines to host in this process */
+#define AIRPORTS_OPTION "airports"
+/* The number of options understood by control2310 */
+#define NUM_CONTROL_OPTIONS 2
+/* The number of airports to make room for when reading an airports file */
+#define INITIAL_AIRPORTS_CAPACITY 16
 
 #endif
\ No newline at end of file
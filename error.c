@@ -46,6 +46,7 @@ void handle_control_error(ControlError errorCode) {
 /* See error.h */
 void handle_roc_error(RocError errorCode) {
     char* errorMessage = "";
+    int exitStatus = errorCode;
     switch (errorCode) {
         case ROC_OK:
             return;
@@ -67,10 +68,18 @@ void handle_roc_error(RocError errorCode) {
         case ROC_CONTROL_CONN_FAILURE:
             errorMessage = "Failed to connect to at least one destination";
             break;
+        case ROC_MAPPER_TIMED_OUT:
+            errorMessage = "Timed out waiting for mapper";
+            exitStatus = ROC_MAPPER_CONN_FAILURE;
+            break;
+        case ROC_CONTROL_TIMED_OUT:
+            errorMessage = "Timed out visiting at least one destination";
+            exitStatus = ROC_CONTROL_CONN_FAILURE;
+            break;
     }
 
     fprintf(stderr, "%s\n", errorMessage);
     fflush(stderr);
 
-    exit(errorCode);
+    exit(exitStatus);
 }
\ No newline at end of file
@@ -19,7 +19,9 @@ enum ControlError {
     CONTROL_INVALID_MAPPER
 };
 
-/* The error codes for roc2310 related errors */
+/* The error codes for roc2310 related errors. The TIMED_OUT errors are the
+ * CONN_FAILURE errors caused by a timeout: they are reported with their own
+ * message, but exit with the same status. */
 enum RocError {
     ROC_OK,
     ROC_INVALID_NUM_ARGS,
@@ -27,7 +29,9 @@ enum RocError {
     ROC_MAPPER_REQUIRED,
     ROC_MAPPER_CONN_FAILURE,
     ROC_MAPPER_NO_ENTRY,
-    ROC_CONTROL_CONN_FAILURE
+    ROC_CONTROL_CONN_FAILURE,
+    ROC_MAPPER_TIMED_OUT,
+    ROC_CONTROL_TIMED_OUT
 };
 
 typedef enum MapperError MapperError;
@@ -0,0 +1,384 @@
+#include "fleet.h"
+
+/**
+ * Reads a single "PLANEID:DEST1:DEST2:..." line of a fleet file into a
+ * FleetPlane. The line is split in place so the plane keeps pointers into it.
+ *
+ * Returns:
+ *  - true -> if the line names a plane and none of its fields are empty
+ *  - false -> otherwise
+ */
+static bool parse_fleet_plane(char* line, FleetPlane* plane) {
+    plane->id = strsep(&line, FLEET_SEPARATOR);
+    if (strlen(plane->id) == 0) {
+        return false;
+    }
+
+    int capacity = 1;
+    plane->destinations = calloc(capacity, sizeof(char*));
+    plane->numDestinations = 0;
+    char* destination;
+    while ((destination = strsep(&line, FLEET_SEPARATOR)) != NULL) {
+        if (strlen(destination) == 0) {
+            return false;
+        }
+        if (plane->numDestinations == capacity) {
+            capacity *= 2;
+            plane->destinations = realloc(plane->destinations,
+                    capacity * sizeof(char*));
+        }
+        plane->destinations[plane->numDestinations++] = destination;
+    }
+
+    return true;
+}
+
+/**
+ * Reads every plane in a fleet file, one "PLANEID:DEST1:DEST2:..." line per
+ * plane. Blank lines are skipped.
+ *
+ * Parameters:
+ *  - path -> the path of the fleet file
+ *  - fleet -> the fleet to store the planes in
+ *
+ * Returns:
+ *  - true -> if the file was read and has at least one valid plane
+ *  - false -> if the file can't be read or any line isn't a valid plane
+ */
+static bool load_fleet(char* path, Fleet* fleet) {
+    FILE* from = fopen(path, "r");
+    if (from == NULL) {
+        return false;
+    }
+
+    int capacity = INITIAL_FLEET_CAPACITY;
+    fleet->planes = calloc(capacity, sizeof(FleetPlane));
+    fleet->numPlanes = 0;
+
+    bool valid = true;
+    bool moreInput = true;
+    while (valid && moreInput) {
+        // Each plane keeps its own line so it can point into it
+        size_t lineCapacity = 80;
+        char* line = calloc(lineCapacity, sizeof(char));
+        moreInput = get_line(&line, &lineCapacity, from);
+        if (strlen(line) == 0) {
+            free(line);
+            continue;
+        }
+
+        if (fleet->numPlanes == capacity) {
+            capacity *= 2;
+            fleet->planes = realloc(fleet->planes,
+                    capacity * sizeof(FleetPlane));
+        }
+        valid = parse_fleet_plane(line, &fleet->planes[fleet->numPlanes++]);
+    }
+    fclose(from);
+
+    return valid && fleet->numPlanes > 0;
+}
+
+/**
+ * Looks up a control2310's port in the resolution cache.
+ *
+ * Returns:
+ *  - true -> if the id was cached and its port written to "port"
+ *  - false -> if the id hasn't been resolved yet
+ */
+static bool get_cached_port(ResolutionCache* cache, char* id, char* port) {
+    pthread_mutex_lock(&cache->lock);
+    int* cachedPort = get_from_port_cache(&cache->ports, id);
+    if (cachedPort != NULL) {
+        sprintf(port, "%d", *cachedPort);
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    return cachedPort != NULL;
+}
+
+/**
+ * Adds a resolved control2310 port to the resolution cache.
+ */
+static void cache_port(ResolutionCache* cache, char* id, char* port) {
+    pthread_mutex_lock(&cache->lock);
+    add_to_port_cache(&cache->ports, id, strtol(port, NULL, BASE_10));
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/**
+ * Resolves a destination to the port of its control2310. Destinations that
+ * are already ports are used as they are, then the cache is checked and only
+ * then is the shared mapper2310 connection asked.
+ *
+ * Parameters:
+ *  - worker -> the thread resolving the destination
+ *  - destination -> the id or port of the destination
+ *  - port -> the buffer to write the port to
+ *
+ * Returns:
+ *  - true -> if the destination was resolved
+ *  - false -> if the mapper2310 has no entry for it or didn't answer
+ */
+static bool resolve_fleet_destination(FleetWorker* worker, char* destination,
+        char* port) {
+    Fleet* fleet = worker->fleet;
+    if (is_valid_port(destination)) {
+        strcpy(port, destination);
+        return true;
+    }
+    if (get_cached_port(&fleet->cache, destination, port)) {
+        return true;
+    }
+
+    long long start = get_monotonic_ns();
+    pthread_mutex_lock(&fleet->mapperLock);
+    LookupError error = lookup_control_port(fleet->mappers, destination,
+            port);
+    pthread_mutex_unlock(&fleet->mapperLock);
+    record_histogram_value(&worker->resolutions, get_monotonic_ns() - start);
+
+    if (error != LOOKUP_OK) {
+        worker->resolutionErrors++;
+        return false;
+    }
+    cache_port(&fleet->cache, destination, port);
+    return true;
+}
+
+/**
+ * Flies a single plane: resolves every destination on its route and, if
+ * they all resolve, visits each of them in order just like a roc2310 would.
+ *
+ * Parameters:
+ *  - worker -> the thread flying the plane
+ *  - plane -> the plane to fly
+ *  - launchNs -> when the plane was scheduled to launch. The route's time
+ *      is measured from here so that planes held up waiting for a free
+ *      thread still count the wait.
+ */
+static void fly_plane(FleetWorker* worker, FleetPlane* plane,
+        long long launchNs) {
+    bool failed = false;
+    char** ports = calloc(plane->numDestinations, sizeof(char*));
+    for (int i = 0; i < plane->numDestinations && !failed; i++) {
+        ports[i] = calloc(6, sizeof(char));
+        failed = !resolve_fleet_destination(worker, plane->destinations[i],
+                ports[i]);
+    }
+
+    char destinationInfo[MESSAGE_BUFFER_SIZE];
+    for (int i = 0; i < plane->numDestinations && !failed; i++) {
+        long long start = get_monotonic_ns();
+        destinationInfo[0] = '\0';
+        if (visit_destination(plane->id, ports[i], destinationInfo,
+                worker->fleet->timeouts, NULL, i) != ROC_OK) {
+            worker->hopErrors++;
+            failed = true;
+        }
+        record_histogram_value(&worker->hops, get_monotonic_ns() - start);
+    }
+    record_histogram_value(&worker->routes, get_monotonic_ns() - launchNs);
+
+    if (failed) {
+        worker->routeErrors++;
+    }
+    for (int i = 0; i < plane->numDestinations; i++) {
+        free(ports[i]);
+    }
+    free(ports);
+}
+
+/**
+ * Flies planes from a Fleet until none are left, waiting for each plane's
+ * launch time if the fleet has a launch rate. Made to be called as a
+ * function pointer in order to start a new thread.
+ *
+ * Parameters:
+ *  - uncastedWorker -> the FleetWorker for this thread
+ *
+ * Return:
+ *  NULL - once every plane has been launched.
+ */
+static void* fly_queued_planes(void* uncastedWorker) {
+    FleetWorker* worker = (FleetWorker*) uncastedWorker;
+    Fleet* fleet = worker->fleet;
+    while (true) {
+        pthread_mutex_lock(&fleet->queueLock);
+        int index = fleet->nextPlane++;
+        pthread_mutex_unlock(&fleet->queueLock);
+        if (index >= fleet->numPlanes) {
+            return NULL;
+        }
+
+        long long launchNs = get_monotonic_ns();
+        if (fleet->rate > 0) {
+            launchNs = fleet->startNs + index * NS_PER_SECOND / fleet->rate;
+            struct timespec launch = {launchNs / NS_PER_SECOND,
+                    launchNs % NS_PER_SECOND};
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &launch,
+                    NULL) != 0) {
+            }
+        }
+        fly_plane(worker, &fleet->planes[index], launchNs);
+    }
+}
+
+/**
+ * Prints one line of the fleet report, with times in microseconds.
+ */
+static void print_fleet_metric(char* name, Histogram* histogram,
+        long long errors) {
+    double percentiles[] = {50, 90, 99, 99.9};
+    printf("%s,%lld,%lld,%.1f,%.1f", name, histogram->count, errors,
+            histogram->min / 1000.0, get_histogram_mean(histogram) / 1000.0);
+    for (int i = 0; i < sizeof(percentiles) / sizeof(double); i++) {
+        printf(",%.1f",
+                get_histogram_percentile(histogram, percentiles[i]) / 1000.0);
+    }
+    printf(",%.1f\n", histogram->max / 1000.0);
+}
+
+/**
+ * Merges every worker's timings and prints them to stdout as CSV, with one
+ * line each for mapper lookups, hops and whole routes.
+ */
+static void print_fleet_report(FleetWorker* workers, int numWorkers,
+        long long elapsedNs) {
+    FleetWorker* total = calloc(1, sizeof(FleetWorker));
+    for (int i = 0; i < numWorkers; i++) {
+        merge_histogram(&total->resolutions, &workers[i].resolutions);
+        merge_histogram(&total->hops, &workers[i].hops);
+        merge_histogram(&total->routes, &workers[i].routes);
+        total->resolutionErrors += workers[i].resolutionErrors;
+        total->hopErrors += workers[i].hopErrors;
+        total->routeErrors += workers[i].routeErrors;
+    }
+
+    printf("metric,count,errors,min_us,mean_us,p50_us,p90_us,p99_us,"
+            "p999_us,max_us\n");
+    print_fleet_metric("resolution", &total->resolutions,
+            total->resolutionErrors);
+    print_fleet_metric("hop", &total->hops, total->hopErrors);
+    print_fleet_metric("route", &total->routes, total->routeErrors);
+    printf("# %lld routes in %.3fs (%.1f routes/s)\n", total->routes.count,
+            elapsedNs / (double) NS_PER_SECOND,
+            total->routes.count / (elapsedNs / (double) NS_PER_SECOND));
+    fflush(stdout);
+
+    free(total);
+}
+
+/**
+ * Checks the mapper argument of a fleet simulation and connects to the
+ * mapper2310s, following the same rules as a single roc2310.
+ *
+ * Returns:
+ *  - ROC_OK -> if the mapper2310s were connected to, or none are needed
+ *  - ROC_MAPPER_REQUIRED -> if no mapper was given but some destination
+ *      isn't a port
+ *  - ROC_INVALID_MAPPER_PORT -> if a mapper port isn't valid
+ *  - ROC_MAPPER_TIMED_OUT -> if no mapper2310 could be connected to and
+ *      connecting to one timed out
+ *  - ROC_MAPPER_CONN_FAILURE -> if no mapper2310 could be connected to
+ *      otherwise
+ */
+static RocError connect_fleet_to_mapper(Fleet* fleet, char* mapperPorts,
+        Plane* settings) {
+    if (strcmp("-", mapperPorts) == 0) {
+        fleet->mappers = NULL;
+        for (int i = 0; i < fleet->numPlanes; i++) {
+            FleetPlane* plane = &fleet->planes[i];
+            for (int j = 0; j < plane->numDestinations; j++) {
+                if (!is_valid_port(plane->destinations[j])) {
+                    return ROC_MAPPER_REQUIRED;
+                }
+            }
+        }
+        return ROC_OK;
+    }
+
+    if (!is_valid_mapper_list(mapperPorts)) {
+        return ROC_INVALID_MAPPER_PORT;
+    }
+    fleet->mappers = settings->mappers;
+    LookupError error = connect_mapper_pool(fleet->mappers, mapperPorts,
+            &settings->timeouts);
+    if (error == LOOKUP_TIMED_OUT) {
+        return ROC_MAPPER_TIMED_OUT;
+    } else if (error != LOOKUP_OK) {
+        return ROC_MAPPER_CONN_FAILURE;
+    }
+
+    return ROC_OK;
+}
+
+/**
+ * Simulates a fleet of planes in this one process. Every plane in the fleet
+ * file is flown with the same logic as a roc2310, except that they all share
+ * one set of mapper2310 connections and a cache of resolved ports. Up to
+ * fleet->concurrency planes are flown at once, launched at fleet->rate planes
+ * per second (or as fast as possible if the rate is 0).
+ *
+ * Once every plane has landed, the latency percentiles of mapper2310
+ * lookups, individual hops and whole routes are printed to stdout as CSV.
+ * The planes' info strings are not printed.
+ *
+ * Parameters:
+ *  - fleetPath -> the fleet file, with a "PLANEID:DEST1:DEST2:..." line per
+ *      plane
+ *  - mapperPorts -> the mapper argument, as for a single roc2310
+ *  - fleet -> the fleet to fly, with its concurrency and rate set
+ *  - settings -> the options given to roc2310, used for every plane
+ *
+ * Returns:
+ *  - ROC_INVALID_NUM_ARGS -> if the fleet file can't be read or is invalid
+ *  - ROC_OK -> once every plane has been flown, even if some failed
+ *  - any error from connect_fleet_to_mapper
+ */
+RocError fly_fleet(char* fleetPath, char* mapperPorts, Fleet* fleet,
+        Plane* settings) {
+    if (!load_fleet(fleetPath, fleet)) {
+        return ROC_INVALID_NUM_ARGS;
+    }
+    RocError error = connect_fleet_to_mapper(fleet, mapperPorts, settings);
+    if (error != ROC_OK) {
+        return error;
+    }
+
+    fleet->timeouts = &settings->timeouts;
+    fleet->nextPlane = 0;
+    create_port_cache(&fleet->cache.ports);
+    pthread_mutex_init(&fleet->cache.lock, NULL);
+    pthread_mutex_init(&fleet->mapperLock, NULL);
+    pthread_mutex_init(&fleet->queueLock, NULL);
+
+    int numWorkers = fleet->concurrency < fleet->numPlanes ?
+            fleet->concurrency : fleet->numPlanes;
+    FleetWorker* workers = calloc(numWorkers, sizeof(FleetWorker));
+    pthread_t* threads = calloc(numWorkers, sizeof(pthread_t));
+    fleet->startNs = get_monotonic_ns();
+    int numStarted = 0;
+    for (; numStarted < numWorkers; numStarted++) {
+        workers[numStarted].fleet = fleet;
+        if (pthread_create(&threads[numStarted], NULL, fly_queued_planes,
+                &workers[numStarted])) {
+            break;
+        }
+    }
+    for (int i = 0; i < numStarted; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    // If no thread could be started, fly everything on this one
+    if (numStarted == 0) {
+        workers[0].fleet = fleet;
+        fly_queued_planes(&workers[0]);
+    }
+
+    print_fleet_report(workers, numStarted > 0 ? numStarted : 1,
+            get_monotonic_ns() - fleet->startNs);
+
+    free(threads);
+    free(workers);
+    return ROC_OK;
+}
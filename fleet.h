@@ -0,0 +1,115 @@
+#ifndef FLEET_H
+#define FLEET_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "roc2310.h"
+#include "histogram.h"
+#include "containers.h"
+
+/* Separates the plane id and each destination on a line of a fleet file */
+#define FLEET_SEPARATOR ":"
+/* The number of planes flown at once if not otherwise set */
+#define DEFAULT_FLEET_CONCURRENCY 64
+/* The most planes that may be flown at once */
+#define MAX_FLEET_CONCURRENCY 4096
+/* The most planes per second that may be launched */
+#define MAX_FLEET_RATE 10000000
+/* The number of planes to make room for when reading a fleet file */
+#define INITIAL_FLEET_CAPACITY 64
+
+typedef struct FleetPlane FleetPlane;
+typedef struct ResolutionCache ResolutionCache;
+typedef struct Fleet Fleet;
+typedef struct FleetWorker FleetWorker;
+
+/**
+ * A single plane read from a fleet file.
+ * Members:
+ *  - id -> the id of the plane, sent to each control2310 it visits
+ *  - numDestinations -> the number of destinations on its route
+ *  - destinations -> the id or port of each destination on its route
+ */
+struct FleetPlane {
+    char* id;
+    int numDestinations;
+    char** destinations;
+};
+
+/* A hash map from control2310 ids to the ports the mapper2310 gave */
+DEFINE_HASH_MAP(PortCache, port_cache, char*, int, container_hash_string,
+        CONTAINER_STRING_EQUALS)
+
+/**
+ * A thread-safe cache of resolved control2310 ports, shared by every plane in
+ * a fleet so each id is only looked up once.
+ * Members:
+ *  - ports -> the port of each control2310 id resolved so far
+ *  - lock -> regulates access to ports
+ */
+struct ResolutionCache {
+    PortCache ports;
+    pthread_mutex_t lock;
+};
+
+/**
+ * Everything shared by the threads flying a fleet of planes.
+ * Members:
+ *  - planes -> the planes read from the fleet file
+ *  - numPlanes -> the number of planes
+ *  - concurrency -> the most planes flown at once
+ *  - rate -> planes launched per second, or 0 to launch as fast as possible
+ *  - mappers -> the mapper2310s shared by every plane, or NULL if none was
+ *      given
+ *  - mapperLock -> regulates access to mappers
+ *  - cache -> the control2310 ports resolved so far
+ *  - timeouts -> the limits on how long any connection may block for
+ *  - nextPlane -> the index of the next plane to be launched
+ *  - queueLock -> regulates access to nextPlane
+ *  - startNs -> when the first plane was launched
+ */
+struct Fleet {
+    FleetPlane* planes;
+    int numPlanes;
+    int concurrency;
+    long rate;
+    MapperPool* mappers;
+    pthread_mutex_t mapperLock;
+    ResolutionCache cache;
+    ClientTimeouts* timeouts;
+    int nextPlane;
+    pthread_mutex_t queueLock;
+    long long startNs;
+};
+
+/**
+ * A thread flying planes from a Fleet, along with the timings it recorded.
+ * Members:
+ *  - fleet -> the fleet being flown
+ *  - resolutions -> the time each mapper2310 lookup took
+ *  - hops -> the time each visit to a control2310 took
+ *  - routes -> the time from each plane's launch to the end of its route
+ *  - resolutionErrors -> the number of lookups that failed
+ *  - hopErrors -> the number of visits that failed
+ *  - routeErrors -> the number of planes with any failed lookup or visit
+ */
+struct FleetWorker {
+    Fleet* fleet;
+    Histogram resolutions;
+    Histogram hops;
+    Histogram routes;
+    long long resolutionErrors;
+    long long hopErrors;
+    long long routeErrors;
+};
+
+/* See fleet.c */
+RocError fly_fleet(char* fleetPath, char* mapperPorts, Fleet* fleet,
+        Plane* settings);
+
+#endif
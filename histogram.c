@@ -0,0 +1,106 @@
+#include "histogram.h"
+
+/**
+ * Finds the bucket that a value belongs in. Values are split by their
+ * highest set bit, then by the HISTOGRAM_SUB_BITS bits below it.
+ */
+static int get_bucket(long long value) {
+    if (value < HISTOGRAM_SUB_BUCKETS) {
+        return value;
+    }
+
+    int exponent = 63 - __builtin_clzll(value);
+    if (exponent > HISTOGRAM_MAX_EXPONENT) {
+        return HISTOGRAM_BUCKETS - 1;
+    }
+    int mantissa = value >> (exponent - HISTOGRAM_SUB_BITS);
+    return (exponent - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS +
+            mantissa - HISTOGRAM_SUB_BUCKETS;
+}
+
+/**
+ * Gets the largest value that belongs in the given bucket.
+ */
+static long long get_bucket_upper_value(int bucket) {
+    if (bucket < HISTOGRAM_SUB_BUCKETS) {
+        return bucket;
+    }
+
+    int exponent = bucket / HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BITS - 1;
+    long long mantissa = HISTOGRAM_SUB_BUCKETS +
+            bucket % HISTOGRAM_SUB_BUCKETS;
+    return ((mantissa + 1) << (exponent - HISTOGRAM_SUB_BITS)) - 1;
+}
+
+/* See histogram.h */
+void reset_histogram(Histogram* histogram) {
+    memset(histogram, 0, sizeof(Histogram));
+}
+
+/* See histogram.h */
+void record_histogram_value(Histogram* histogram, long long value) {
+    if (value < 0) {
+        value = 0;
+    }
+
+    histogram->counts[get_bucket(value)]++;
+    if (histogram->count == 0 || value < histogram->min) {
+        histogram->min = value;
+    }
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+    histogram->count++;
+    histogram->sum += value;
+}
+
+/* See histogram.h */
+void merge_histogram(Histogram* into, Histogram* from) {
+    if (from->count == 0) {
+        return;
+    }
+
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        into->counts[i] += from->counts[i];
+    }
+    if (into->count == 0 || from->min < into->min) {
+        into->min = from->min;
+    }
+    if (from->max > into->max) {
+        into->max = from->max;
+    }
+    into->count += from->count;
+    into->sum += from->sum;
+}
+
+/* See histogram.h */
+long long get_histogram_percentile(Histogram* histogram, double percentile) {
+    if (histogram->count == 0) {
+        return 0;
+    }
+
+    // The rank of the value wanted, counting from 1
+    long long rank = (long long) (percentile / 100 * histogram->count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+
+    long long seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            long long value = get_bucket_upper_value(i);
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+
+    return histogram->max;
+}
+
+/* See histogram.h */
+double get_histogram_mean(Histogram* histogram) {
+    if (histogram->count == 0) {
+        return 0;
+    }
+    return (double) histogram->sum / histogram->count;
+}
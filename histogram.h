@@ -0,0 +1,75 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Each power of two is split into 2^HISTOGRAM_SUB_BITS buckets (~3% wide) */
+#define HISTOGRAM_SUB_BITS 5
+/* The number of buckets within each power of two */
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+/* The highest power of two that values are recorded up to */
+#define HISTOGRAM_MAX_EXPONENT 62
+/* The total number of buckets in a Histogram */
+#define HISTOGRAM_BUCKETS \
+        ((HISTOGRAM_MAX_EXPONENT - HISTOGRAM_SUB_BITS + 2) * \
+        HISTOGRAM_SUB_BUCKETS)
+
+typedef struct Histogram Histogram;
+
+/**
+ * A log-linear histogram of non-negative values (generally latencies in
+ * nanoseconds) in the style of HdrHistogram. Values below
+ * HISTOGRAM_SUB_BUCKETS are recorded exactly and larger values to within
+ * about 3%. A Histogram isn't thread-safe, so each thread should record into
+ * its own and merge them once recording is done.
+ * Members:
+ *  - counts -> the number of values recorded in each bucket
+ *  - count -> the total number of values recorded
+ *  - sum -> the sum of every value recorded
+ *  - min -> the smallest value recorded
+ *  - max -> the largest value recorded
+ */
+struct Histogram {
+    long long counts[HISTOGRAM_BUCKETS];
+    long long count;
+    long long sum;
+    long long min;
+    long long max;
+};
+
+/**
+ * Empties a Histogram so that it can be recorded into.
+ */
+void reset_histogram(Histogram* histogram);
+
+/**
+ * Records a value into a Histogram. Negative values are recorded as 0.
+ */
+void record_histogram_value(Histogram* histogram, long long value);
+
+/**
+ * Adds every value recorded in "from" to "into".
+ */
+void merge_histogram(Histogram* into, Histogram* from);
+
+/**
+ * Gets the value that the given percentage of recorded values are less than
+ * or equal to, to within the precision of the Histogram.
+ *
+ * Parameters:
+ *  - histogram -> the histogram to read
+ *  - percentile -> the percentage to read, from 0 to 100
+ *
+ * Returns:
+ *  - The value at the percentile, or 0 if nothing has been recorded.
+ */
+long long get_histogram_percentile(Histogram* histogram, double percentile);
+
+/**
+ * Gets the mean of the values recorded, or 0 if nothing has been recorded.
+ */
+double get_histogram_mean(Histogram* histogram);
+
+#endif
@@ -1,10 +1,32 @@
 #include "list.h"
 
-/* See list.h */
-ListError create_list(List* list, size_t itemSize, 
+/**
+ * Waits for and locks one of a List's semaphores, firing the
+ * list__lock__acquire probe once it is held.
+ */
+static void lock_semaphore(sem_t* semaphore) {
+    sem_wait(semaphore);
+    TRACE1(list__lock__acquire, semaphore);
+}
+
+/**
+ * Unlocks one of a List's semaphores, firing the list__lock__release probe
+ * just before it is released.
+ */
+static void unlock_semaphore(sem_t* semaphore) {
+    TRACE1(list__lock__release, semaphore);
+    sem_post(semaphore);
+}
+
+/**
+ * Sets up the members shared by contiguous and chunked Lists.
+ */
+static void setup_list(List* list, size_t itemSize, 
         ListItemStr toString, ListItemCmp compare) {
-    list->content = calloc(0, itemSize);
+    list->content = NULL;
+    list->chunks = NULL;
     list->length = 0;
+    list->capacity = 0;
     list->itemSize = itemSize;
     list->toString = toString;
     list->compare = compare;
@@ -12,101 +34,439 @@ ListError create_list(List* list, size_t itemSize,
     list->listAccessSemaphore = calloc(1, sizeof(sem_t));
     sem_init(list->listAccessSemaphore,
             SEMAPHORE_THREAD_ONLY, SEMAPHORE_MAX_CONCURRENT);
+}
+
+/* See list.h */
+ListError create_list(List* list, size_t itemSize, 
+        ListItemStr toString, ListItemCmp compare) {
+    setup_list(list, itemSize, toString, compare);
 
     return LIST_OK;
 }
 
+/* See list.h */
+ListError create_chunked_list(List* list, size_t itemSize,
+        ListItemStr toString, ListItemCmp compare) {
+    setup_list(list, itemSize, toString, compare);
+    list->chunks = calloc(LIST_MAX_CHUNKS, sizeof(ListItem*));
+    if (list->chunks == NULL) {
+        destroy_list(list);
+        return LIST_NOT_OK;
+    }
+
+    return LIST_OK;
+}
+
+/**
+ * Finds which chunk of a chunked List holds the item at "index". Adding
+ * the size of the first chunk to the index makes the chunk the position of
+ * the highest set bit (less LIST_FIRST_CHUNK_BITS), and the offset within
+ * the chunk the bits below it.
+ */
+static int get_chunk_index(int index) {
+    unsigned int position = (unsigned int) index + 
+            (1u << LIST_FIRST_CHUNK_BITS);
+    return 31 - __builtin_clz(position) - LIST_FIRST_CHUNK_BITS;
+}
+
+/**
+ * Gets a pointer to where the item at "index" is stored. The index must be
+ * less than list->capacity.
+ */
+static ListItem* get_slot(List* list, int index) {
+    if (list->chunks == NULL) {
+        return &list->content[index];
+    }
+
+    int chunk = get_chunk_index(index);
+    unsigned int chunkStart = 
+            (1u << (chunk + LIST_FIRST_CHUNK_BITS)) -
+            (1u << LIST_FIRST_CHUNK_BITS);
+    return &list->chunks[chunk][index - chunkStart];
+}
+
+/**
+ * Works out how big an array of items should grow to so that it has room
+ * for at least "needed" items, multiplying its capacity by
+ * LIST_GROWTH_FACTOR as many times as needed.
+ */
+static int get_grown_capacity(int capacity, int needed) {
+    int newCapacity = capacity == 0 ? LIST_INITIAL_CAPACITY : capacity;
+    while (newCapacity < needed) {
+        newCapacity *= LIST_GROWTH_FACTOR;
+    }
+
+    return newCapacity;
+}
+
+/**
+ * Grows an array of items so that it has room for at least "needed" items,
+ * see get_grown_capacity.
+ * 
+ * Returns:
+ *  - true -> if the array has room for "needed" items
+ *  - false -> if the memory could not be allocated, in which case the array
+ *      is unchanged
+ */
+static bool grow_items(ListItem** content, int* capacity, int needed,
+        size_t itemSize) {
+    if (needed <= *capacity) {
+        return true;
+    }
+    int newCapacity = get_grown_capacity(*capacity, needed);
+    ListItem* newContent = realloc(*content, newCapacity * itemSize);
+    if (newContent == NULL) {
+        return false;
+    }
+    *content = newContent;
+    *capacity = newCapacity;
+
+    return true;
+}
+
+/**
+ * Makes sure a List has room for at least "needed" items. A contiguous List
+ * grows by LIST_GROWTH_FACTOR at a time so that n adds only copy O(n) items
+ * in total, and a chunked List adds chunks without moving any items.
+ * 
+ * Returns:
+ *  - true -> if the list has room for "needed" items
+ *  - false -> if the memory could not be allocated, in which case the list is
+ *      unchanged
+ */
+static bool reserve_list_capacity(List* list, int needed) {
+    if (list->chunks != NULL) {
+        while (list->capacity < needed) {
+            int chunk = get_chunk_index(list->capacity);
+            if (chunk >= LIST_MAX_CHUNKS) {
+                return false;
+            }
+            int chunkCapacity = 1 << (chunk + LIST_FIRST_CHUNK_BITS);
+            list->chunks[chunk] = calloc(chunkCapacity, list->itemSize);
+            if (list->chunks[chunk] == NULL) {
+                return false;
+            }
+            list->capacity += chunkCapacity;
+        }
+        return true;
+    }
+
+    return grow_items(&list->content, &list->capacity, needed,
+            list->itemSize);
+}
+
 /* See list.h */
 ListError add_list_item(List* list, ListItem item) {
-    sem_wait(list->listAccessSemaphore);
+    lock_semaphore(list->listAccessSemaphore);
 
     // If the item being added is too big or too small (i.e. the incorrect
     // item).
     if (sizeof(item) != list->itemSize) {
-        sem_post(list->listAccessSemaphore);
+        unlock_semaphore(list->listAccessSemaphore);
         return LIST_NOT_OK;
     }
 
-    ListItem* newContent = realloc(
-            list->content, (list->length + 1) * list->itemSize);
-    if (newContent == NULL) {
-        sem_post(list->listAccessSemaphore);
+    if (!reserve_list_capacity(list, list->length + 1)) {
+        unlock_semaphore(list->listAccessSemaphore);
         return LIST_NOT_OK;
     }
 
-    list->content = newContent;
-    list->content[list->length] = item;
+    *get_slot(list, list->length) = item;
     list->length++;
 
-    sem_post(list->listAccessSemaphore);
+    unlock_semaphore(list->listAccessSemaphore);
     return LIST_OK;
 }
 
 /* See list.h */
 ListError get_list_item(List* list, int index, ListItem* buffer) {
-    sem_wait(list->listAccessSemaphore);
-    if (index > list->length - 1) {
-        sem_post(list->listAccessSemaphore);
+    lock_semaphore(list->listAccessSemaphore);
+    if (index < 0 || index > list->length - 1) {
+        unlock_semaphore(list->listAccessSemaphore);
         return LIST_NOT_OK;
     }
-    if (memcpy(buffer, &(list->content[index]), list->itemSize) == NULL) {
-        sem_post(list->listAccessSemaphore);
+    if (memcpy(buffer, get_slot(list, index), list->itemSize) == NULL) {
+        unlock_semaphore(list->listAccessSemaphore);
         return LIST_NOT_OK;
     }
 
-    sem_post(list->listAccessSemaphore);
+    unlock_semaphore(list->listAccessSemaphore);
     return LIST_OK;
 }
 
+/* See list.h */
+ListItem* get_list_item_pointer(List* list, int index) {
+    lock_semaphore(list->listAccessSemaphore);
+    ListItem* item = NULL;
+    if (index >= 0 && index < list->length) {
+        item = get_slot(list, index);
+    }
+
+    unlock_semaphore(list->listAccessSemaphore);
+    return item;
+}
+
 /* See list.h */
 ListError search_list(List* list, ListItem searchKey, ListItem* buffer) {
-    sem_wait(list->listAccessSemaphore);
+    lock_semaphore(list->listAccessSemaphore);
 
     for (int i = 0; i < list->length; i++) {
-        if (list->compare(searchKey, &list->content[i]) == 0) {
-            sem_post(list->listAccessSemaphore);
-            if (get_list_item(list, i, buffer) != LIST_OK) {
-                return LIST_NOT_OK;
-            }
-
-            return LIST_OK;
+        ListItem* slot = get_slot(list, i);
+        if (list->compare(searchKey, slot) == 0) {
+            // Copy while still holding the semaphore so that the item can't
+            // change underneath us
+            memcpy(buffer, slot, list->itemSize);
+            break;
         }
     }
 
-    sem_post(list->listAccessSemaphore);
+    unlock_semaphore(list->listAccessSemaphore);
     return LIST_OK;
 }
 
 /* See list.h */
 ListError sort_list(List* list) {
-    sem_wait(list->listAccessSemaphore);
+    if (list->chunks != NULL) {
+        return LIST_NOT_OK;
+    }
+    lock_semaphore(list->listAccessSemaphore);
     qsort(list->content, list->length, list->itemSize, list->compare);
 
-    sem_post(list->listAccessSemaphore);
+    unlock_semaphore(list->listAccessSemaphore);
     return LIST_OK;
 }
 
 /* See list.h */
 ListError get_list_as_str(List* list, char** buffer, size_t* capacity) {
-    sem_wait(list->listAccessSemaphore);
+    lock_semaphore(list->listAccessSemaphore);
+
+    size_t writePosition = strlen(*buffer);
     for (int i = 0; i < list->length; i++) {
-        int writePosition = strlen(*buffer);
+        ListItem item = *get_slot(list, i);
         int numChars = list->toString(*buffer + writePosition,
-                *capacity - writePosition, list->content[i]) + 2;
+                *capacity - writePosition, item) + 2;
 
         while (numChars > *capacity - writePosition) {
             // Doubling the size is most efficient
             *capacity = *capacity * 2;
             *buffer = realloc(*buffer, *capacity * sizeof(char));
             numChars = list->toString(*buffer + writePosition, 
-                    *capacity - writePosition, list->content[i]) + 2;
+                    *capacity - writePosition, item) + 2;
         }
+        writePosition += numChars - 2;
 
         if (i < list->length - 1) {
-            strcat(*buffer, "\n");
+            (*buffer)[writePosition++] = '\n';
+            (*buffer)[writePosition] = '\0';
+        }
+    }
+
+    unlock_semaphore(list->listAccessSemaphore);
+    return LIST_OK;
+}
+
+/* See list.h */
+ListError destroy_list(List* list) {
+    if (list->chunks != NULL) {
+        for (int i = 0; i < LIST_MAX_CHUNKS; i++) {
+            free(list->chunks[i]);
+        }
+        free(list->chunks);
+    }
+    free(list->content);
+    sem_destroy(list->listAccessSemaphore);
+    free(list->listAccessSemaphore);
+
+    return LIST_OK;
+}
+
+/* See list.h */
+ListError create_sharded_list(ShardedList* list, int numShards,
+        size_t itemSize) {
+    void* shards;
+    if (posix_memalign(&shards, CACHE_LINE_SIZE,
+            numShards * sizeof(ListShard)) != 0) {
+        return LIST_NOT_OK;
+    }
+    memset(shards, 0, numShards * sizeof(ListShard));
+    list->shards = shards;
+    list->numShards = numShards;
+    list->itemSize = itemSize;
+
+    for (int i = 0; i < numShards; i++) {
+        sem_init(&list->shards[i].shardSemaphore,
+                SEMAPHORE_THREAD_ONLY, SEMAPHORE_MAX_CONCURRENT);
+    }
+
+    return LIST_OK;
+}
+
+/* The shard this thread adds to, or -1 if it hasn't added anything yet */
+static __thread int threadShard = -1;
+/* The shard that the next thread to add anything is given */
+static int nextThreadShard = 0;
+
+/**
+ * Gets the shard of a ShardedList that the calling thread adds to, giving the
+ * thread a shard if it doesn't have one yet.
+ */
+static ListShard* get_thread_shard(ShardedList* list) {
+    if (threadShard < 0) {
+        threadShard = __sync_fetch_and_add(&nextThreadShard, 1) & INT_MAX;
+    }
+    return &list->shards[threadShard % list->numShards];
+}
+
+/**
+ * Locks a shard for an add, counting the wait if another thread already has
+ * it locked. The counts are only updated while the shard is held.
+ */
+static void lock_shard_for_add(ListShard* shard) {
+    if (sem_trywait(&shard->shardSemaphore) == 0) {
+        TRACE1(list__lock__acquire, &shard->shardSemaphore);
+        return;
+    }
+
+    long long start = get_monotonic_ns();
+    lock_semaphore(&shard->shardSemaphore);
+    shard->waits++;
+    shard->waitNs += get_monotonic_ns() - start;
+}
+
+/* See list.h */
+ListError add_sharded_list_item(ShardedList* list, ListItem item) {
+    if (sizeof(item) != list->itemSize) {
+        return LIST_NOT_OK;
+    }
+    ListShard* shard = get_thread_shard(list);
+
+    lock_shard_for_add(shard);
+    if (!grow_items(&shard->content, &shard->capacity, shard->length + 1,
+            list->itemSize)) {
+        unlock_semaphore(&shard->shardSemaphore);
+        return LIST_NOT_OK;
+    }
+    shard->content[shard->length++] = item;
+
+    unlock_semaphore(&shard->shardSemaphore);
+    return LIST_OK;
+}
+
+/**
+ * Works out how many bytes of data the next block a shard copies into should
+ * hold. The first block holds LIST_SHARD_FIRST_BLOCK_SIZE bytes and each
+ * later one LIST_GROWTH_FACTOR times as many as the one before, up to
+ * LIST_SHARD_MAX_BLOCK_SIZE, so that a shard only given a few copies stays
+ * small. A copy bigger than that gets a block of its own size.
+ */
+static size_t get_next_block_size(ListShard* shard, size_t size) {
+    size_t blockSize = LIST_SHARD_FIRST_BLOCK_SIZE;
+    if (shard->block != NULL) {
+        blockSize = (shard->blockCapacity - sizeof(char*)) *
+                LIST_GROWTH_FACTOR;
+    }
+    if (blockSize > LIST_SHARD_MAX_BLOCK_SIZE) {
+        blockSize = LIST_SHARD_MAX_BLOCK_SIZE;
+    }
+
+    return size > blockSize ? size : blockSize;
+}
+
+/* See list.h */
+ListError add_sharded_list_copy(ShardedList* list, void* data, size_t size) {
+    if (sizeof(ListItem) != list->itemSize) {
+        return LIST_NOT_OK;
+    }
+    ListShard* shard = get_thread_shard(list);
+
+    lock_shard_for_add(shard);
+    if (!grow_items(&shard->content, &shard->capacity, shard->length + 1,
+            list->itemSize)) {
+        unlock_semaphore(&shard->shardSemaphore);
+        return LIST_NOT_OK;
+    }
+    if (shard->block == NULL || shard->blockCapacity - shard->blockUsed <
+            size) {
+        // Earlier blocks are left where they are, as items still point
+        // into them, and are chained from the new block
+        size_t capacity = sizeof(char*) + get_next_block_size(shard, size);
+        char* block = malloc(capacity);
+        if (block == NULL) {
+            unlock_semaphore(&shard->shardSemaphore);
+            return LIST_NOT_OK;
         }
+        memcpy(block, &shard->block, sizeof(char*));
+        shard->block = block;
+        shard->blockUsed = sizeof(char*);
+        shard->blockCapacity = capacity;
     }
+    char* copy = shard->block + shard->blockUsed;
+    memcpy(copy, data, size);
+    shard->blockUsed += size;
+    shard->content[shard->length++] = copy;
 
-    sem_post(list->listAccessSemaphore);
+    unlock_semaphore(&shard->shardSemaphore);
     return LIST_OK;
-}
\ No newline at end of file
+}
+
+/* See list.h */
+ListError merge_sharded_list(ShardedList* list, ListItem** items,
+        int* numItems) {
+    *items = NULL;
+    *numItems = 0;
+    int capacity = 0;
+    for (int i = 0; i < list->numShards; i++) {
+        ListShard* shard = &list->shards[i];
+        lock_semaphore(&shard->shardSemaphore);
+        if (!grow_items(items, &capacity, *numItems + shard->length,
+                list->itemSize)) {
+            unlock_semaphore(&shard->shardSemaphore);
+            free(*items);
+            *items = NULL;
+            *numItems = 0;
+            return LIST_NOT_OK;
+        }
+        // An empty shard may have no content yet
+        if (shard->length > 0) {
+            memcpy(*items + *numItems, shard->content,
+                    shard->length * list->itemSize);
+        }
+        *numItems += shard->length;
+        unlock_semaphore(&shard->shardSemaphore);
+    }
+
+    return LIST_OK;
+}
+
+/* See list.h */
+void destroy_sharded_list(ShardedList* list) {
+    for (int i = 0; i < list->numShards; i++) {
+        ListShard* shard = &list->shards[i];
+        char* block = shard->block;
+        while (block != NULL) {
+            char* previous;
+            memcpy(&previous, block, sizeof(char*));
+            free(block);
+            block = previous;
+        }
+        free(shard->content);
+        sem_destroy(&shard->shardSemaphore);
+    }
+    free(list->shards);
+}
+
+/* See list.h */
+void get_sharded_list_counts(ShardedList* list, int* length,
+        long long* waits, long long* waitNs) {
+    *length = 0;
+    *waits = 0;
+    *waitNs = 0;
+    for (int i = 0; i < list->numShards; i++) {
+        ListShard* shard = &list->shards[i];
+        lock_semaphore(&shard->shardSemaphore);
+        *length += shard->length;
+        *waits += shard->waits;
+        *waitNs += shard->waitNs;
+        unlock_semaphore(&shard->shardSemaphore);
+    }
+}
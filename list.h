@@ -3,15 +3,40 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include <string.h>
 #include <semaphore.h>
+#include <limits.h>
+
+#include "utils.h"
+#include "trace.h"
 
 /* This semaphore will only be used to regulate threads and not processes */
 #define SEMAPHORE_THREAD_ONLY 0
 /* The number of threads that can concurrently access this List */
 #define SEMAPHORE_MAX_CONCURRENT 1
 
+/* The number of items a contiguous List makes room for on its first add */
+#define LIST_INITIAL_CAPACITY 8
+/* How much a contiguous List's capacity is multiplied by when it's full */
+#define LIST_GROWTH_FACTOR 2
+/* log2 of the number of items in the first chunk of a chunked List */
+#define LIST_FIRST_CHUNK_BITS 4
+/* The number of chunks a chunked List can have. Each chunk is twice the size
+ * of the one before it, so this is enough for as many items as an int can
+ * count (less the size of the first chunk) */
+#define LIST_MAX_CHUNKS (31 - LIST_FIRST_CHUNK_BITS)
+/* The size of a cache line. Each shard of a ShardedList gets its own so that
+ * adds to different shards don't contend for the same line */
+#define CACHE_LINE_SIZE 64
+/* The size of the first block a shard of a ShardedList copies data into */
+#define LIST_SHARD_FIRST_BLOCK_SIZE 256
+/* The most that a shard's blocks grow to */
+#define LIST_SHARD_MAX_BLOCK_SIZE 65536
+
 typedef struct List List;
+typedef struct ListShard ListShard;
+typedef struct ShardedList ShardedList;
 typedef void* ListItem;
 
 /**
@@ -45,9 +70,19 @@ typedef int (*ListItemCmp)(const void* item1, const void* item2);
  * A generic thread-safe List type.
  * For use in mapper2310, control2310 and roc2310.
  * 
+ * A List is either contiguous, where every item is in one array that grows
+ * geometrically (and so moves when it grows), or chunked, where items are
+ * stored in chunks of doubling size that are never moved once allocated. Only
+ * contiguous Lists can be sorted.
+ * 
  * Members:
- *  - content -> contains a pointer to an array of the items in the list.
+ *  - content -> the array of the items in the list, or NULL if the list is
+ *      chunked or hasn't had anything added yet.
+ *  - chunks -> the chunks of a chunked list, or NULL if it is contiguous.
+ *      Chunk k has room for 2^(LIST_FIRST_CHUNK_BITS + k) items and is only
+ *      allocated once the list needs it.
  *  - length -> number of items in the list
+ *  - capacity -> the number of items the list has room for
  *  - itemSize -> the size of each item in the list in bytes
  *  - printer -> a pointer to the function used to convert the item to a
  *      string version of it.
@@ -56,13 +91,61 @@ typedef int (*ListItemCmp)(const void* item1, const void* item2);
  */ 
 struct List {
     ListItem* content;
+    ListItem** chunks;
     int length;
+    int capacity;
     size_t itemSize;
     ListItemStr toString;
     ListItemCmp compare;
     sem_t* listAccessSemaphore;
 };
 
+/**
+ * One shard of a ShardedList, holding the items added by the threads that
+ * were given this shard. Aligned to a cache line so that shards don't share
+ * one.
+ * Members:
+ *  - shardSemaphore -> regulates access to this shard
+ *  - content -> an array of the items in this shard
+ *  - length -> the number of items in this shard
+ *  - capacity -> the number of items content has room for
+ *  - block -> the block that data added with add_sharded_list_copy is
+ *      currently copied into. Each block starts with a pointer to the block
+ *      filled before it, so that they can all be freed.
+ *  - blockUsed -> the number of bytes of block used so far
+ *  - blockCapacity -> the size of block
+ *  - waits -> the number of adds that had to wait for the shard
+ *  - waitNs -> the total time adds spent waiting for the shard
+ */
+struct ListShard {
+    sem_t shardSemaphore;
+    ListItem* content;
+    int length;
+    int capacity;
+    char* block;
+    size_t blockUsed;
+    size_t blockCapacity;
+    long long waits;
+    long long waitNs;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+/**
+ * A thread-safe collection for items that are added often by many threads
+ * but only read occasionally, such as a log. Each thread adds to its own
+ * shard, so adds from different threads rarely wait on each other, and the
+ * shards are only merged when the items are read. The order items were added
+ * in is not kept.
+ * Members:
+ *  - shards -> the shards holding the items
+ *  - numShards -> the number of shards
+ *  - itemSize -> the size of each item in bytes
+ */
+struct ShardedList {
+    ListShard* shards;
+    int numShards;
+    size_t itemSize;
+};
+
 /* The error codes for List-related functions */
 enum ListError {
     LIST_OK,
@@ -87,6 +170,19 @@ typedef enum ListError ListError;
 ListError create_list(List* list, size_t itemSize,
         ListItemStr toString, ListItemCmp compare);
 
+/**
+ * Creates a chunked List in the provided list struct. Items added to a
+ * chunked List are never moved, so the pointers given by
+ * get_list_item_pointer stay valid for as long as the List exists. The
+ * parameters are the same as for create_list.
+ * 
+ * Returns:
+ *  - LIST_OK -> if the list is successfully created
+ *  - LIST_NOT_OK -> if memory for the chunks could not be allocated
+ */
+ListError create_chunked_list(List* list, size_t itemSize,
+        ListItemStr toString, ListItemCmp compare);
+
 /**
  * Get an item at a specific index in this List and write it to the memory
  * at itemBuffer. If the index does not exist then the buffer is unchanged
@@ -104,6 +200,20 @@ ListError create_list(List* list, size_t itemSize,
  */
 ListError get_list_item(List* list, int index, ListItem* itemBuffer);
 
+/**
+ * Gets a pointer to where the item at a specific index in this List is
+ * stored. For a chunked List the pointer stays valid for as long as the List
+ * exists; for a contiguous List only until the next item is added.
+ * 
+ * Parameters:
+ *  - list -> the List being accessed
+ *  - index -> the index to find
+ * 
+ * Returns:
+ *  - A pointer to the item, or NULL if the index does not exist.
+ */
+ListItem* get_list_item_pointer(List* list, int index);
+
 /**
  * Gets the entire list's string representation using the provided 
  * list->compare function. Each item in the list is delimitted by a newline
@@ -138,7 +248,7 @@ ListError get_list_as_str(List* list, char** buffer, size_t* capacity);
 ListError add_list_item(List* list, ListItem item);
 
 /**
- * Searches the list for the provided searchKey using a simple linear scan. 
+ * Searches the list for the provided searchKey using a simple linear scan.
  * For comparisons the specified list->compare function is used.
  * 
  * Parameters:
@@ -167,7 +277,112 @@ ListError search_list(List* list, ListItem searchKey, ListItem* itemBuffer);
  * 
  * Returns:
  *  - LIST_OK -> if the list is successfully sorted.
+ *  - LIST_NOT_OK -> if the list is chunked, in which case it is unchanged.
  */
 ListError sort_list(List* list);
 
+/**
+ * Frees the memory used by a List itself. The items in the List are still
+ * owned by the caller.
+ * 
+ * Parameters:
+ *  - list -> the list to destroy, which must not be used again afterwards
+ * 
+ * Returns:
+ *  - LIST_OK -> once the list has been destroyed.
+ */
+ListError destroy_list(List* list);
+
+/**
+ * Creates a ShardedList in the provided struct.
+ * 
+ * Parameters:
+ *  - list -> the buffer to write the ShardedList to
+ *  - numShards -> the number of shards to spread adds over. Generally a small
+ *      multiple of the number of cores.
+ *  - itemSize -> the size of an item within the list in bytes
+ * 
+ * Returns:
+ *  - LIST_OK -> if the list is successfully created
+ *  - LIST_NOT_OK -> if memory for the shards could not be allocated
+ */
+ListError create_sharded_list(ShardedList* list, int numShards,
+        size_t itemSize);
+
+/**
+ * Adds an item to the calling thread's shard of a ShardedList. Each thread
+ * is given a shard the first time it adds to any ShardedList, round robin.
+ * 
+ * Parameters:
+ *  - list -> the list to add to
+ *  - item -> the item to be added, as for add_list_item
+ * 
+ * Returns:
+ *  - LIST_OK -> if the item is successfully added to the list
+ *  - LIST_NOT_OK -> if there was an issue allocating memory for the shard or
+ *      if the item is not the same size as specified in list->itemSize.
+ */
+ListError add_sharded_list_item(ShardedList* list, ListItem item);
+
+/**
+ * Copies some bytes (such as a string) into memory owned by the calling
+ * thread's shard of a ShardedList, then adds a pointer to the copy to the
+ * same shard. Copies are packed into blocks that start at
+ * LIST_SHARD_FIRST_BLOCK_SIZE bytes and grow geometrically up to
+ * LIST_SHARD_MAX_BLOCK_SIZE, so this only allocates once per block rather
+ * than once per item, and a shard that is rarely added to stays small. A
+ * copy lasts as long as the list.
+ * 
+ * Parameters:
+ *  - list -> the list to add to, which must hold pointers
+ *  - data -> the bytes to copy
+ *  - size -> the number of bytes to copy
+ * 
+ * Returns:
+ *  - LIST_OK -> if the copy is successfully added to the list
+ *  - LIST_NOT_OK -> if there was an issue allocating memory for the shard or
+ *      if the list doesn't hold pointers.
+ */
+ListError add_sharded_list_copy(ShardedList* list, void* data, size_t size);
+
+/**
+ * Copies every item in a ShardedList into one new array. Each shard is only
+ * locked while it is being copied, so adds can carry on meanwhile.
+ * 
+ * Parameters:
+ *  - list -> the list to read
+ *  - items -> where to store the new array, which the caller must free
+ *  - numItems -> where to store the number of items in the array
+ * 
+ * Returns:
+ *  - LIST_OK -> if every item was copied
+ *  - LIST_NOT_OK -> if the array could not be allocated, in which case
+ *      *items is NULL and *numItems is 0
+ */
+ListError merge_sharded_list(ShardedList* list, ListItem** items,
+        int* numItems);
+
+/**
+ * Frees the memory used by a ShardedList, including every copy made by
+ * add_sharded_list_copy. Any other items are still owned by the caller.
+ * 
+ * Parameters:
+ *  - list -> the list to destroy, which must not be used again afterwards
+ */
+void destroy_sharded_list(ShardedList* list);
+
+/**
+ * Adds up the number of items in a ShardedList and how long adds to it have
+ * spent waiting for each other. Time is only measured when an add finds its
+ * shard already locked, so uncontended adds aren't slowed down.
+ * 
+ * Parameters:
+ *  - list -> the list to read
+ *  - length -> where to store the number of items in the list
+ *  - waits -> where to store the number of adds that had to wait
+ *  - waitNs -> where to store the total time adds spent waiting
+ */
+void get_sharded_list_counts(ShardedList* list, int* length,
+        long long* waits, long long* waitNs);
+
 #endif
\ No newline at end of file
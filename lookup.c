@@ -0,0 +1,414 @@
+#include "lookup.h"
+
+/**
+ * Checks that a list of mapper2310 ports, separated by
+ * MAPPER_LIST_SEPARATOR, contains between 1 and MAX_MAPPERS entries which
+ * are all valid ports.
+ *
+ * Parameters:
+ *  - ports -> the list of ports to check, e.g. "2310" or "2310,2311"
+ *
+ * Returns:
+ *  - true -> if every entry is a valid port
+ *  - false -> otherwise
+ */
+bool is_valid_mapper_list(char* ports) {
+    char* copy = calloc(strlen(ports) + 1, sizeof(char));
+    strcpy(copy, ports);
+
+    int numPorts = 0;
+    bool valid = true;
+    char* leftOver = copy;
+    char* port;
+    // strsep is used over strtok_r so that empty entries are caught
+    while (valid &&
+            (port = strsep(&leftOver, MAPPER_LIST_SEPARATOR)) != NULL) {
+        valid = is_valid_port(port) && ++numPorts <= MAX_MAPPERS;
+    }
+
+    free(copy);
+    return valid && numPorts > 0;
+}
+
+/**
+ * Closes the connection to a mapper2310 so that no more lookups are sent to
+ * it.
+ */
+static void disconnect_replica(MapperReplica* replica) {
+    if (!replica->connected) {
+        return;
+    }
+    close_client(&replica->connection);
+    replica->connected = false;
+    replica->numPending = 0;
+}
+
+/**
+ * Connects to every mapper2310 in a list of ports separated by
+ * MAPPER_LIST_SEPARATOR. The list should already have been checked with
+ * is_valid_mapper_list, and pool->hedgeDelayMs set by the caller.
+ *
+ * When there is more than one mapper2310, reads from them are unbuffered so
+ * that polling their sockets shows exactly which have a reply waiting.
+ *
+ * Parameters:
+ *  - pool -> the pool to store the connections in
+ *  - ports -> the list of ports to connect to
+ *  - timeouts -> the limits on how long connecting, and later lookups, may
+ *      block for
+ *
+ * Returns:
+ *  - LOOKUP_OK -> if at least one mapper2310 was connected to
+ *  - LOOKUP_TIMED_OUT -> if none of the mapper2310s could be connected to
+ *      and at least one of them timed out
+ *  - LOOKUP_CONN_FAILURE -> if none of the mapper2310s could be connected to
+ *      otherwise
+ */
+LookupError connect_mapper_pool(MapperPool* pool, char* ports,
+        ClientTimeouts* timeouts) {
+    char* copy = calloc(strlen(ports) + 1, sizeof(char));
+    strcpy(copy, ports);
+
+    pool->numReplicas = 0;
+    pool->preferred = -1;
+    pool->timeouts = *timeouts;
+    pool->nextLookup = 0;
+    bool timedOut = false;
+    char* leftOver = copy;
+    char* port;
+    while ((port = strsep(&leftOver, MAPPER_LIST_SEPARATOR)) != NULL &&
+            pool->numReplicas < MAX_MAPPERS) {
+        MapperReplica* replica = &pool->replicas[pool->numReplicas++];
+        replica->firstPending = 0;
+        replica->numPending = 0;
+        ClientError error = setup_client_with_timeouts(port,
+                &replica->connection, timeouts);
+        replica->connected = error == CLIENT_OK;
+        timedOut = timedOut || error == CLIENT_TIMED_OUT;
+        if (replica->connected && pool->preferred < 0) {
+            pool->preferred = pool->numReplicas - 1;
+        }
+    }
+    free(copy);
+
+    if (pool->numReplicas > 1) {
+        for (int i = 0; i < pool->numReplicas; i++) {
+            if (pool->replicas[i].connected) {
+                setvbuf(pool->replicas[i].connection.readFrom, NULL,
+                        _IONBF, 0);
+            }
+        }
+    }
+
+    if (pool->preferred < 0) {
+        return timedOut ? LOOKUP_TIMED_OUT : LOOKUP_CONN_FAILURE;
+    }
+    return LOOKUP_OK;
+}
+
+/**
+ * Picks the mapper2310 to send a lookup to. Connected mapper2310s with no
+ * pending lookups are picked first, starting from the preferred one. If every
+ * mapper2310 is busy, the one with the fewest pending lookups is picked.
+ *
+ * Parameters:
+ *  - pool -> the pool to pick from
+ *  - exclude -> a replica that must not be picked, or -1
+ *
+ * Returns:
+ *  - The index of the picked replica, or -1 if no replica can take a lookup.
+ */
+static int choose_replica(MapperPool* pool, int exclude) {
+    int chosen = -1;
+    for (int offset = 0; offset < pool->numReplicas; offset++) {
+        int i = (pool->preferred + offset) % pool->numReplicas;
+        MapperReplica* replica = &pool->replicas[i];
+        if (i == exclude || !replica->connected ||
+                replica->numPending == MAX_PENDING_LOOKUPS) {
+            continue;
+        }
+        if (chosen < 0 ||
+                replica->numPending < pool->replicas[chosen].numPending) {
+            chosen = i;
+        }
+    }
+
+    return chosen;
+}
+
+/**
+ * Sends a lookup for "id" to a mapper2310 and records it as pending. If the
+ * send fails the mapper2310 is disconnected.
+ *
+ * Returns:
+ *  - true -> if the lookup was sent
+ *  - false -> if the mapper2310 has been disconnected
+ */
+static bool send_lookup(MapperReplica* replica, char* id, int lookup) {
+    char* queryBuffer = calloc(strlen(id) + 2, sizeof(char));
+    sprintf(queryBuffer, "?%s", id);
+    ClientError error = send_client_message(&replica->connection,
+            queryBuffer);
+    free(queryBuffer);
+    if (error != CLIENT_OK) {
+        disconnect_replica(replica);
+        return false;
+    }
+
+    int slot = (replica->firstPending + replica->numPending) %
+            MAX_PENDING_LOOKUPS;
+    replica->pendingLookups[slot] = lookup;
+    replica->numPending++;
+    return true;
+}
+
+/**
+ * Sends a lookup to the connected mapper2310 picked by choose_replica,
+ * moving on to the next pick whenever a send fails, until one succeeds or
+ * every mapper2310 has been disconnected.
+ *
+ * Parameters:
+ *  - pool -> the pool to send the lookup with
+ *  - id -> the id of the control2310 to look up
+ *  - lookup -> the number of the lookup
+ *  - exclude -> a replica that must not be sent to, or -1
+ *
+ * Returns:
+ *  - The index of the replica the lookup was sent to, or -1 if it couldn't
+ *      be sent to any.
+ */
+static int send_to_any_replica(MapperPool* pool, char* id, int lookup,
+        int exclude) {
+    int chosen;
+    // A failed send disconnects that replica, so it isn't picked again
+    while ((chosen = choose_replica(pool, exclude)) >= 0 &&
+            !send_lookup(&pool->replicas[chosen], id, lookup)) {
+    }
+
+    return chosen;
+}
+
+/**
+ * Checks whether any connected mapper2310 still owes a reply to a lookup.
+ */
+static bool is_lookup_pending(MapperPool* pool, int lookup) {
+    for (int i = 0; i < pool->numReplicas; i++) {
+        MapperReplica* replica = &pool->replicas[i];
+        for (int j = 0; j < replica->numPending; j++) {
+            int slot = (replica->firstPending + j) % MAX_PENDING_LOOKUPS;
+            if (replica->pendingLookups[slot] == lookup) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Reads the reply to the oldest pending lookup on a mapper2310. If the
+ * reply can't be read the mapper2310 is disconnected.
+ *
+ * Parameters:
+ *  - replica -> the mapper2310 to read from
+ *  - response -> the buffer to write the reply to
+ *  - lookup -> where to store the number of the lookup the reply is for
+ *
+ * Returns:
+ *  - true -> if a reply was read
+ *  - false -> if the mapper2310 has been disconnected
+ */
+static bool read_lookup_reply(MapperReplica* replica, char* response,
+        int* lookup) {
+    response[0] = '\0';
+    if (read_client_message(&replica->connection, response) != CLIENT_OK) {
+        disconnect_replica(replica);
+        return false;
+    }
+
+    *lookup = replica->pendingLookups[replica->firstPending];
+    replica->firstPending = (replica->firstPending + 1) % MAX_PENDING_LOOKUPS;
+    replica->numPending--;
+    return true;
+}
+
+/**
+ * Turns a mapper2310's reply into the result of a lookup.
+ */
+static LookupError use_reply(char* response, char* port) {
+    if (strcmp(";", response) == 0 || strlen(response) == 0) {
+        return LOOKUP_NO_ENTRY;
+    }
+    strcpy(port, response);
+    return LOOKUP_OK;
+}
+
+/**
+ * Looks up a control2310's port on the only mapper2310 in a pool. This is
+ * the same exchange as the spec describes for a single mapper2310.
+ */
+static LookupError lookup_on_single_mapper(MapperPool* pool, char* id,
+        char* port) {
+    MapperReplica* replica = &pool->replicas[0];
+    char* queryBuffer = calloc(strlen(id) + 2, sizeof(char));
+    sprintf(queryBuffer, "?%s", id);
+    ClientError error = send_client_message(&replica->connection,
+            queryBuffer);
+    free(queryBuffer);
+
+    char response[MESSAGE_BUFFER_SIZE] = "";
+    if (error == CLIENT_OK) {
+        error = read_client_message(&replica->connection, response);
+    }
+    if (error == CLIENT_TIMED_OUT) {
+        return LOOKUP_TIMED_OUT;
+    }
+
+    return use_reply(response, port);
+}
+
+/**
+ * Waits for any mapper2310 with a pending lookup to have a reply ready.
+ *
+ * Parameters:
+ *  - pool -> the pool to wait on
+ *  - timeoutMs -> the most time to wait, or -1 to wait forever
+ *  - ready -> where to store the index of a replica with a reply ready
+ *
+ * Returns:
+ *  - 1 -> if a replica has a reply ready
+ *  - 0 -> if nothing arrived within the timeout
+ *  - -1 -> if no mapper2310 has a pending lookup to wait for
+ */
+static int wait_for_reply(MapperPool* pool, long timeoutMs, int* ready) {
+    struct pollfd waiting[MAX_MAPPERS];
+    int replicaIndices[MAX_MAPPERS];
+    int numWaiting = 0;
+    for (int i = 0; i < pool->numReplicas; i++) {
+        MapperReplica* replica = &pool->replicas[i];
+        if (replica->connected && replica->numPending > 0) {
+            waiting[numWaiting].fd = replica->connection.socket;
+            waiting[numWaiting].events = POLLIN;
+            waiting[numWaiting].revents = 0;
+            replicaIndices[numWaiting++] = i;
+        }
+    }
+    if (numWaiting == 0) {
+        return -1;
+    }
+
+    int numReady = poll(waiting, numWaiting, timeoutMs);
+    if (numReady <= 0) {
+        return 0;
+    }
+    for (int i = 0; i < numWaiting; i++) {
+        if (waiting[i].revents != 0) {
+            *ready = replicaIndices[i];
+            break;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Works out how long to wait for a reply before giving up on (or hedging)
+ * the current lookup.
+ *
+ * Parameters:
+ *  - pool -> the pool doing the lookup
+ *  - hedgeAtNs -> when to hedge, or NO_TIMEOUT if there's nothing left to
+ *      hedge to
+ *  - timeoutMs -> where to store the time to wait, or -1 to wait forever
+ *
+ * Returns:
+ *  - false -> if the deadline has already passed
+ */
+static bool get_reply_timeout(MapperPool* pool, long long hedgeAtNs,
+        long* timeoutMs) {
+    if (get_timeout_ms(pool->timeouts.ioMs, pool->timeouts.deadlineNs,
+            timeoutMs) != CLIENT_OK) {
+        return false;
+    }
+    if (*timeoutMs == NO_TIMEOUT) {
+        *timeoutMs = -1;
+    }
+
+    if (hedgeAtNs != NO_TIMEOUT) {
+        long long untilHedgeNs = hedgeAtNs - get_monotonic_ns();
+        long hedgeMs = untilHedgeNs <= 0 ? 0 :
+                (untilHedgeNs + NS_PER_MS - 1) / NS_PER_MS;
+        if (*timeoutMs < 0 || hedgeMs < *timeoutMs) {
+            *timeoutMs = hedgeMs;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Looks up the port of the control2310 with the given id.
+ *
+ * The lookup is sent to one mapper2310. If there is more than one mapper2310
+ * and no reply arrives within the pool's hedge delay, the lookup is also sent
+ * to a second mapper2310 and whichever reply arrives first is used. Whenever
+ * every mapper2310 the lookup was sent to has failed or hung up, it is sent
+ * to another one, so a lookup only fails once no mapper2310 is left. Late
+ * replies to earlier lookups are read and thrown away as they arrive.
+ *
+ * Parameters:
+ *  - pool -> the mapper2310s to ask
+ *  - id -> the id of the control2310 to look up
+ *  - port -> the buffer to write the control2310's port to
+ *
+ * Returns:
+ *  - LOOKUP_OK -> if the port was found and written to "port"
+ *  - LOOKUP_NO_ENTRY -> if the first reply says there is no such id
+ *  - LOOKUP_CONN_FAILURE -> if every mapper2310 failed or hung up without
+ *      replying
+ *  - LOOKUP_TIMED_OUT -> if no reply arrived within the timeouts
+ */
+LookupError lookup_control_port(MapperPool* pool, char* id, char* port) {
+    if (pool->numReplicas == 1) {
+        return lookup_on_single_mapper(pool, id, port);
+    }
+
+    int lookup = pool->nextLookup++;
+    int sentTo = -1;
+    long long hedgeAtNs = get_monotonic_ns() + pool->hedgeDelayMs * NS_PER_MS;
+
+    char response[MESSAGE_BUFFER_SIZE];
+    while (true) {
+        if (!is_lookup_pending(pool, lookup)) {
+            // Nothing asked so far can still reply, so ask another mapper
+            sentTo = send_to_any_replica(pool, id, lookup, -1);
+            if (sentTo < 0) {
+                return LOOKUP_CONN_FAILURE;
+            }
+        }
+
+        long timeoutMs;
+        if (!get_reply_timeout(pool, hedgeAtNs, &timeoutMs)) {
+            return LOOKUP_TIMED_OUT;
+        }
+
+        int ready = 0;
+        int waitResult = wait_for_reply(pool, timeoutMs, &ready);
+        if (waitResult == 0 && hedgeAtNs != NO_TIMEOUT) {
+            hedgeAtNs = NO_TIMEOUT;
+            send_to_any_replica(pool, id, lookup, sentTo);
+            continue;
+        } else if (waitResult == 0) {
+            return LOOKUP_TIMED_OUT;
+        } else if (waitResult < 0) {
+            continue;
+        }
+
+        int replyLookup;
+        if (read_lookup_reply(&pool->replicas[ready], response,
+                &replyLookup) && replyLookup == lookup) {
+            pool->preferred = ready;
+            return use_reply(response, port);
+        }
+    }
+}
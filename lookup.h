@@ -0,0 +1,85 @@
+#ifndef LOOKUP_H
+#define LOOKUP_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <poll.h>
+
+#include "client.h"
+#include "utils.h"
+
+/* Separates the ports when more than one mapper2310 is given */
+#define MAPPER_LIST_SEPARATOR ","
+/* The most mapper2310s that lookups can be spread across */
+#define MAX_MAPPERS 16
+/* The most lookups that can be waiting on a reply from one mapper2310 */
+#define MAX_PENDING_LOOKUPS 64
+/* How long to wait for a reply before hedging, if not otherwise set */
+#define DEFAULT_HEDGE_DELAY_MS 20
+
+typedef struct MapperReplica MapperReplica;
+typedef struct MapperPool MapperPool;
+
+/* The results of looking up a control2310's port */
+enum LookupError {
+    LOOKUP_OK,
+    LOOKUP_NO_ENTRY,
+    LOOKUP_CONN_FAILURE,
+    LOOKUP_TIMED_OUT
+};
+typedef enum LookupError LookupError;
+
+/**
+ * A connection to one of a set of replicated mapper2310s.
+ * Members:
+ *  - connection -> the connection to the mapper2310
+ *  - connected -> false once the connection has failed or been closed
+ *  - pendingLookups -> a ring of the numbers of the lookups sent to this
+ *      mapper2310 that it hasn't replied to yet, oldest first. mapper2310
+ *      replies in order, so each reply belongs to the oldest pending lookup.
+ *  - firstPending -> the index of the oldest pending lookup in the ring
+ *  - numPending -> the number of pending lookups
+ */
+struct MapperReplica {
+    Client connection;
+    bool connected;
+    int pendingLookups[MAX_PENDING_LOOKUPS];
+    int firstPending;
+    int numPending;
+};
+
+/**
+ * A set of replicated mapper2310s to send lookups to. Each lookup goes to a
+ * single mapper2310 first and is hedged to a second one if no reply arrives
+ * within hedgeDelayMs, after which the first reply from either is used.
+ * Members:
+ *  - replicas -> the connections to each mapper2310
+ *  - numReplicas -> the number of mapper2310s given
+ *  - preferred -> the mapper2310 that answered the last lookup first, which
+ *      is tried first for the next lookup
+ *  - nextLookup -> the number given to the next lookup
+ *  - hedgeDelayMs -> how long to wait for a reply before hedging
+ *  - timeouts -> the limits on how long any lookup may block for
+ */
+struct MapperPool {
+    MapperReplica replicas[MAX_MAPPERS];
+    int numReplicas;
+    int preferred;
+    int nextLookup;
+    long hedgeDelayMs;
+    ClientTimeouts timeouts;
+};
+
+/* See lookup.c */
+bool is_valid_mapper_list(char* ports);
+
+/* See lookup.c */
+LookupError connect_mapper_pool(MapperPool* pool, char* ports,
+        ClientTimeouts* timeouts);
+
+/* See lookup.c */
+LookupError lookup_control_port(MapperPool* pool, char* id, char* port);
+
+#endif
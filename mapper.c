@@ -0,0 +1,378 @@
+#include "mapper.h"
+
+/* The names each MapperRequest is reported under by the '#' command */
+static const char* const mapperRequestNames[NUM_MAPPER_REQUESTS] = {
+    "search", "add", "print", "bulk_add", "stats", "other"
+};
+
+/* See mapper.h */
+bool create_mapper(Mapper* data) {
+    if (!create_registry(&data->airports)) {
+        return false;
+    }
+    if (!create_server_stats(&data->stats, mapperRequestNames,
+            NUM_MAPPER_REQUESTS)) {
+        destroy_registry(&data->airports);
+        return false;
+    }
+    pthread_mutex_init(&data->airportsLock, NULL);
+
+    return true;
+}
+
+/* See mapper.h */
+int search_mapper(Mapper* data, char* id, RequestStats* request) {
+    lock_counting_waits(&data->airportsLock, request);
+    int port = search_registry(&data->airports, id);
+    unlock_counted(&data->airportsLock);
+
+    return port;
+}
+
+/* See mapper.h */
+bool add_to_mapper(Mapper* data, char* id, int port, RequestStats* request) {
+    lock_counting_waits(&data->airportsLock, request);
+    bool added = add_to_registry(&data->airports, id, port);
+    unlock_counted(&data->airportsLock);
+
+    return added;
+}
+
+/* See mapper.h */
+bool take_mapper_snapshot(Mapper* data, RegistryOrderUpdate* update,
+        RegistrySnapshot* snapshot, RequestStats* request) {
+    lock_counting_waits(&data->airportsLock, request);
+    bool started = start_registry_order_update(&data->airports, update);
+    unlock_counted(&data->airportsLock);
+
+    // If the sort fails, take_registry_snapshot sorts under the lock instead
+    if (started) {
+        sort_registry_order_update(update);
+    }
+
+    lock_counting_waits(&data->airportsLock, request);
+    finish_registry_order_update(&data->airports, update);
+    bool copied = take_registry_snapshot(&data->airports, snapshot);
+    unlock_counted(&data->airportsLock);
+
+    return copied;
+}
+
+/* See mapper.h */
+ServerError parse_new_airport(char* message, MappedAirport* mappingBuffer) {
+    StringView id;
+    int port;
+    if (!parse_id_port(message, &id, &port)) {
+        return SERVER_NOT_OK;
+    }
+
+    id.start[id.length] = '\0';
+    mappingBuffer->id = id.start;
+    mappingBuffer->port = port;
+
+    return SERVER_OK;
+}
+
+/**
+ * Handles an add command from the client. That is a command of the format
+ * "!ID:PORT". If the ID doesn't already exist in this mapper2310 then it
+ * is added to the mapper along with its PORT.
+ * 
+ * If an error is encountered the function returns early rather than returning
+ * an error.
+ * 
+ * Parameters:
+ *  - data -> the mapper2310 data to use to run this command
+ *  - message -> the command received in its entirety (including the '!')
+ *  - request -> the stats of this command
+ */
+static void handle_add_command(Mapper* data, char* message,
+        RequestStats* request) {
+    MappedAirport airport;
+    int errorCode = parse_new_airport(message + 1, &airport);
+    if (errorCode != SERVER_OK) {
+        // Supress any errors with executing the command and continue
+        request->suppressedErrors++;
+        return;
+    }
+
+    // If the airport id already exists within the list then ignore this
+    // new one being added
+    add_to_mapper(data, airport.id, airport.port, request);
+}
+
+/**
+ * Frees the ids copied into a batch of mappings, and the batch itself.
+ */
+static void free_batch(MappedAirport* batch, int batchLength) {
+    for (int i = 0; i < batchLength; i++) {
+        free(batch[i].id);
+    }
+    free(batch);
+}
+
+/**
+ * Adds a mapping to a batch, growing the batch if it's full. The line the
+ * mapping was parsed from is about to be reused, so its id is copied.
+ *
+ * Returns:
+ *  - true -> if the mapping was added
+ *  - false -> if memory for the batch or the id couldn't be allocated
+ */
+static bool add_to_batch(MappedAirport** batch, int* batchLength,
+        int* capacity, MappedAirport airport) {
+    if (*batchLength == *capacity) {
+        MappedAirport* grown = realloc(*batch,
+                2 * *capacity * sizeof(MappedAirport));
+        if (grown == NULL) {
+            return false;
+        }
+        *batch = grown;
+        *capacity *= 2;
+    }
+    airport.id = strdup(airport.id);
+    if (airport.id == NULL) {
+        return false;
+    }
+    (*batch)[(*batchLength)++] = airport;
+
+    return true;
+}
+
+/**
+ * Handles a bulk add command from the client. That is a line containing just
+ * '&', followed by any number of "ID:PORT" lines and finally a line 
+ * containing just '.'. Every valid mapping is then added to this mapper in a
+ * single batch, following the same rules as '!' for IDs that already exist.
+ * 
+ * Invalid lines within the batch are quietly skipped. The batch is only
+ * added once the final '.' is read, so if the client disconnects before
+ * sending it, or memory for the batch runs out, nothing in it is added. In
+ * the latter case the lines up to the '.' are still read, so that they
+ * aren't taken as commands.
+ * 
+ * Parameters:
+ *  - data -> the mapper2310 data to use to run this command
+ *  - connection -> the connection to read the batch of mappings from
+ *  - request -> the stats of this command
+ */
+static void handle_bulk_add_command(Mapper* data, Connection* connection,
+        RequestStats* request) {
+    int capacity = INITIAL_BATCH_CAPACITY;
+    MappedAirport* batch = calloc(capacity, sizeof(MappedAirport));
+    int batchLength = 0;
+    bool failed = batch == NULL;
+
+    bool ended = false;
+    while (!ended && read_connection_line(connection)) {
+        char* line = connection->line;
+        MappedAirport airport;
+        if (strcmp(BULK_ADD_END, line) == 0) {
+            ended = true;
+        } else if (parse_new_airport(line, &airport) != SERVER_OK) {
+            request->suppressedErrors++;
+        } else if (!failed) {
+            failed = !add_to_batch(&batch, &batchLength, &capacity, airport);
+        }
+    }
+
+    if (!ended || failed) {
+        request->suppressedErrors++;
+        free_batch(batch, batchLength);
+        return;
+    }
+    lock_counting_waits(&data->airportsLock, request);
+    for (int i = 0; i < batchLength; i++) {
+        add_to_registry(&data->airports, batch[i].id, batch[i].port);
+    }
+    unlock_counted(&data->airportsLock);
+    free_batch(batch, batchLength);
+}
+
+/**
+ * Handles a search command from the client. That is, a command of the format
+ * '?ID'. If the ID is not in the list of mapped control's then a ';' is
+ * written to the 'to' file.
+ * 
+ * Parameters:
+ *  - data -> the mapper2310 data to use to run this command
+ *  - message -> the command received in its entirety (including the '?')
+ *  - connection -> the connection to write the output of this command to
+ *  - request -> the stats of this command
+ */
+static void handle_search_command(Mapper* data, char* message,
+        Connection* connection, RequestStats* request) {
+    char stringPort[6];
+    int port = search_mapper(data, message + 1, request);
+    if (port == REGISTRY_NOT_FOUND) {
+        strcpy(stringPort, ";");
+    } else {
+        sprintf(stringPort, "%d", port);
+    }
+    send_connection_message(connection, stringPort);
+}
+
+/**
+ * Handles a print command from the client. That is, a command of the format
+ * '@'. Prints each airport as "ID:PORT" on its own line, in order of id.
+ * 
+ * The airports are copied with take_mapper_snapshot, and are formatted
+ * into the connection's scratch once airportsLock is let go of, so neither
+ * sorting new airports, formatting nor a slow client holds up other
+ * commands.
+ * 
+ * Parameters:
+ *  - data -> the mapper2310 data to use to run this command
+ *  - connection -> the connection to write the output of this command to
+ *  - update -> where new airports are sorted, reused by every print on the
+ *      connection
+ *  - snapshot -> where the airports are copied to, reused by every print on
+ *      the connection
+ *  - request -> the stats of this command
+ */
+static void handle_print_command(Mapper* data, Connection* connection,
+        RegistryOrderUpdate* update, RegistrySnapshot* snapshot,
+        RequestStats* request) {
+    take_mapper_snapshot(data, update, snapshot, request);
+
+    for (int i = 0; i < snapshot->length; i++) {
+        if (add_to_connection_scratch(connection, "%s:%d\n",
+                get_snapshot_id(snapshot, i),
+                snapshot->ports[i]) != SERVER_OK) {
+            break;
+        }
+    }
+
+    send_connection_scratch(connection);
+}
+
+/**
+ * Handles a stats command from the client. That is, a command of the format
+ * '#'. Prints a "NAME:VALUE" line for each of this mapper's stats, including
+ * the number of airports it holds, followed by a "." line.
+ * 
+ * Parameters:
+ *  - data -> the mapper2310 data to use to run this command
+ *  - connection -> the connection to write the output of this command to
+ *  - request -> the stats of this command
+ */
+static void handle_stats_command(Mapper* data, Connection* connection,
+        RequestStats* request) {
+    add_server_stats(&data->stats, connection);
+    lock_counting_waits(&data->airportsLock, request);
+    int numAirports = data->airports.length;
+    unlock_counted(&data->airportsLock);
+    add_to_connection_scratch(connection, "airports:%d\n.\n", numAirports);
+
+    send_connection_scratch(connection);
+}
+
+/**
+ * Handles any command read from a client.
+ * 
+ * If any sort of error is encountered while processing a command, it is
+ * quitely ignored and the server continues to wait for new input.
+ * 
+ * There are 5 types of commands denoted by the character they begin with.
+ * These are:
+ *  - '?' -> "?ID" -> Get the Port for the airport with the provided ID
+ *  - '!' -> '!ID:PORT' -> Add the ID and PORT for the aiport to this mapper.
+ *  - '@' -> Print all IDs and Ports stored in this mapper.
+ *  - '&' -> A line of just '&' adds every "ID:PORT" line that follows, up
+ *      to a "." line, in one batch. Any other line starting with '&' is
+ *      ignored.
+ *  - '#' -> Print this mapper's stats.
+ * 
+ * The request__start and request__end probes are fired around every
+ * command, the latter with the name it is counted under in the stats.
+ * 
+ * Parameters:
+ *  - connection -> the connection the command was read from, with the
+ *      command in connection->line. Any output is written back to it.
+ *  - data -> this mapper instance's data
+ *  - update -> where the connection sorts new airports, for '@'
+ *  - snapshot -> the connection's copy of the airports, for '@'
+ *  - stats -> the stats of the thread handling the connection
+ */
+static void handle_mapper_command(Connection* connection, Mapper* data,
+        RegistryOrderUpdate* update, RegistrySnapshot* snapshot,
+        ThreadStats* stats) {
+    char* message = connection->line;
+    RequestStats request;
+    TRACE1(request__start, message);
+    // The command is represented by the first character of the command so
+    // just message[0] can be checked to see what command has been requested.
+    switch (message[0]) {
+        case '?':
+            start_request_stats(&request, MAPPER_SEARCH);
+            handle_search_command(data, message, connection, &request);
+            break;
+        case '!':
+            start_request_stats(&request, MAPPER_ADD);
+            handle_add_command(data, message, &request);
+            break;
+        case '@':
+            start_request_stats(&request, MAPPER_PRINT);
+            handle_print_command(data, connection, update, snapshot,
+                    &request);
+            break;
+        case '&':
+            // Only a line of just '&' starts a batch, as the batch swallows
+            // every line up to the '.'
+            if (strcmp(BULK_ADD_START, message) == 0) {
+                start_request_stats(&request, MAPPER_BULK_ADD);
+                handle_bulk_add_command(data, connection, &request);
+            } else {
+                start_request_stats(&request, MAPPER_OTHER);
+                request.suppressedErrors++;
+            }
+            break;
+        case '#':
+            start_request_stats(&request, MAPPER_STATS);
+            handle_stats_command(data, connection, &request);
+            break;
+        default:
+            start_request_stats(&request, MAPPER_OTHER);
+            request.suppressedErrors++;
+            break;
+    }
+    finish_request_stats(stats, &request, connection);
+    TRACE2(request__end, request.type, mapperRequestNames[request.type]);
+}
+
+/* See mapper.h */
+void* handle_mapper_connection(void* uncastedArgs) {
+    ConnectionHandlerArgs* args = (ConnectionHandlerArgs*) uncastedArgs;
+    Mapper* data = (Mapper*) args->data;
+    Connection connection;
+    ServerError error = open_connection(args->connFd, &connection);
+    free(args);
+    if (error != SERVER_OK) {
+        return NULL;
+    }
+    if (data->capture != NULL) {
+        capture_connection(&connection, data->capture, 0);
+    }
+    ThreadStats stats;
+    open_thread_stats(&data->stats, &stats);
+    RegistryOrderUpdate update = {0};
+    RegistrySnapshot snapshot = {0};
+
+    // Read any commands from the client
+    while (read_connection_line(&connection)) {
+        handle_mapper_command(&connection, data, &update, &snapshot, &stats);
+    }
+
+    destroy_registry_order_update(&update);
+    destroy_registry_snapshot(&snapshot);
+    close_thread_stats(&data->stats, &stats);
+    close_connection(&connection);
+    return NULL;
+}
+
+/* See mapper.h */
+void destroy_mapper(Mapper* data) {
+    destroy_registry(&data->airports);
+    pthread_mutex_destroy(&data->airportsLock);
+    destroy_server_stats(&data->stats);
+}
@@ -0,0 +1,173 @@
+#ifndef MAPPER_H
+#define MAPPER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+
+#include "server.h"
+#include "registry.h"
+#include "stats.h"
+#include "utils.h"
+
+/* The line that starts a batch of registrations */
+#define BULK_ADD_START "&"
+/* The line that ends a batch of registrations started with '&' */
+#define BULK_ADD_END "."
+/* The number of registrations to make room for when a batch starts */
+#define INITIAL_BATCH_CAPACITY 64
+
+/* The types of request a mapper2310 counts in its stats */
+enum MapperRequest {
+    MAPPER_SEARCH,
+    MAPPER_ADD,
+    MAPPER_PRINT,
+    MAPPER_BULK_ADD,
+    MAPPER_STATS,
+    MAPPER_OTHER,
+    NUM_MAPPER_REQUESTS
+};
+typedef enum MapperRequest MapperRequest;
+
+typedef struct Mapper Mapper;
+typedef struct MappedAirport MappedAirport;
+
+/**
+ * A struct to store a mapping between a control2310 id and its port.
+ * Members:
+ *  - id -> the id of the control2310 being stored
+ *  - port -> the port that the control2310 is listening on
+ */
+struct MappedAirport {
+    char* id;
+    int port;
+};
+
+/**
+ * A struct to store all of the data related to a mapper2310 instance for
+ * access to within the a mapper2310 isntance.
+ * Members:
+ *  - airports -> the port of every control2310 id that has been added
+ *  - airportsLock -> regulates access to airports
+ *  - port -> the port that mapper2310 is listening on
+ *  - stats -> the stats of every connection to this mapper2310
+ *  - capture -> where request lines are captured to, or NULL if they
+ *      aren't
+ */
+struct Mapper {
+    Registry airports;
+    pthread_mutex_t airportsLock;
+    int port;
+    ServerStats stats;
+    Capture* capture;
+};
+
+/**
+ * Creates an empty Mapper, with no port and nothing captured, in the
+ * provided struct.
+ *
+ * Returns:
+ *  - true -> if the Mapper was created
+ *  - false -> if memory for its airports or stats couldn't be allocated
+ */
+bool create_mapper(Mapper* data);
+
+/**
+ * Gets the port mapped to an airport id.
+ *
+ * Parameters:
+ *  - data -> the mapper to search
+ *  - id -> the id of the airport to get the port for
+ *  - request -> the stats of the request asking for the port
+ *
+ * Returns:
+ *  - the port mapped to the id
+ *  - REGISTRY_NOT_FOUND -> if the id isn't mapped
+ */
+int search_mapper(Mapper* data, char* id, RequestStats* request);
+
+/**
+ * Maps an airport id to a port, unless the id is already mapped, in which
+ * case the port it already has is kept.
+ *
+ * Parameters:
+ *  - data -> the mapper to add to
+ *  - id -> the id of the airport, which is copied
+ *  - port -> the port of the airport
+ *  - request -> the stats of the request adding the airport
+ *
+ * Returns:
+ *  - true -> if the id was mapped
+ *  - false -> if the id was already mapped or memory couldn't be allocated
+ */
+bool add_to_mapper(Mapper* data, char* id, int port, RequestStats* request);
+
+/**
+ * Copies every airport of a mapper into a snapshot, sorted by id. Airports
+ * added since the last snapshot are copied out and sorted with airportsLock
+ * let go of, so that a large batch of new airports doesn't hold up other
+ * commands while it's sorted. The lock is only held to copy them out, and
+ * then to merge them in and copy the snapshot.
+ *
+ * Parameters:
+ *  - data -> the mapper to copy
+ *  - update -> where new airports are sorted, reused by every snapshot
+ *  - snapshot -> the snapshot to copy into, replacing what it held
+ *  - request -> the stats of the request taking the snapshot
+ *
+ * Returns:
+ *  - true -> if every airport was copied
+ *  - false -> if memory for the sort or the snapshot couldn't be allocated,
+ *      in which case the snapshot is empty
+ */
+bool take_mapper_snapshot(Mapper* data, RegistryOrderUpdate* update,
+        RegistrySnapshot* snapshot, RequestStats* request);
+
+/**
+ * Parses a message of the format ID:PORT into a MappedAirport struct. The id
+ * of the MappedAirport points into the message rather than being copied, so
+ * the ':' is replaced with a terminator.
+ *
+ * Parameters:
+ *  - message -> the "ID:PORT" string
+ *  - mappingBuffer -> the MappedAirport to write the mapping to
+ *
+ * Returns:
+ *  - SERVER_OK -> if the function completes as expected
+ *  - SERVER_NOT_OK -> if the id is empty or contains '\n' or '\r', or if no
+ *      port is provided or the port is invalid in anyway. A port is invalid
+ *      if it contains any non-numeric characters or its value is not >= 1
+ *      and <= 65536.
+ */
+ServerError parse_new_airport(char* message, MappedAirport* mappingBuffer);
+
+/**
+ * Handles a connection to the mapper from a client.
+ *
+ * Takes any input read from the client connected on the server's port and
+ * then parses each of the inputs, see handle_mapper_command in mapper.c.
+ *
+ * Updates data with any new airport ID:Name.
+ *
+ * Every command on the connection reuses the same Connection buffers, so
+ * once they have grown to fit, '?', '!' and '@' don't allocate. Each
+ * connection records its stats into one of the server's StatsSlots, which
+ * are only added up by '#'.
+ *
+ * Made to be called as a function pointer in order to start a new thread,
+ * with a ConnectionHandlerArgs whose data is the Mapper.
+ *
+ * TODO: A void* parameter is kind of ugly
+ */
+void* handle_mapper_connection(void* uncastedArgs);
+
+/**
+ * Frees everything held by a Mapper. It must no longer have any
+ * connections.
+ */
+void destroy_mapper(Mapper* data);
+
+#endif
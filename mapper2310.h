@@ -6,36 +6,14 @@
 #include <stdbool.h>
 #include <string.h>
 #include <ctype.h>
+#include <pthread.h>
 
 #include "error.h"
 #include "server.h"
-#include "list.h"
+#include "mapper.h"
+#include "options.h"
 
-typedef struct MapperData MapperData;
-typedef struct Mapper Mapper;
-typedef struct MappedAirport MappedAirport;
-
-/**
- * A struct to store a mapping between a control2310 id and its port.
- * Members:
- *  - id -> the id of the control2310 being stored
- *  - port -> the port that the control2310 is listening on
- */
-struct MappedAirport {
-    char* id;
-    int port;
-};
-
-/**
- * A struct to store all of the data related to a mapper2310 instance for 
- * access to within the a mapper2310 isntance.
- * Members:
- *  - airports -> a list of MappedAirports
- *  - port -> the port that mapper2310 is listening on
- */
-struct Mapper {
-    List* airports;
-    int port;
-};
+/* The number of options understood by mapper2310 */
+#define NUM_MAPPER_OPTIONS 1
 
 #endif
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include "options.h"
+
+/**
+ * Finds the option matching the argument "arg" of the form "--name[=value]".
+ *
+ * Returns:
+ *  - the index of the matching entry of "options"
+ *  - -1 -> if "arg" is not an option this program understands
+ */
+static int find_option(char* arg, Option* options, int numOptions) {
+    if (strncmp(arg, OPTION_PREFIX, strlen(OPTION_PREFIX)) != 0) {
+        return -1;
+    }
+    char* name = arg + strlen(OPTION_PREFIX);
+    char* equals = strchr(name, '=');
+    size_t nameLength = equals == NULL ? strlen(name) : equals - name;
+
+    for (int i = 0; i < numOptions; i++) {
+        if (strlen(options[i].name) == nameLength &&
+                strncmp(options[i].name, name, nameLength) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Records the first "numArgs" arguments after the program name as present
+ * options, each of which must already be known to match one, then removes
+ * the first "consumed" arguments from the front of argv.
+ */
+static void consume_options(int* argc, char*** argv, Option* options,
+        int numOptions, int numArgs, int consumed) {
+    for (int i = 1; i <= numArgs; i++) {
+        char* arg = (*argv)[i];
+        Option* option = &options[find_option(arg, options, numOptions)];
+        char* equals = strchr(arg + strlen(OPTION_PREFIX), '=');
+        option->present = true;
+        option->value = equals == NULL ? NULL : equals + 1;
+    }
+
+    // Keep the program name in front of the remaining positionals
+    (*argv)[consumed] = (*argv)[0];
+    *argv += consumed;
+    *argc -= consumed;
+}
+
+/**
+ * Counts the arguments after the program name that are options this
+ * program understands, stopping at the first that isn't.
+ */
+static int count_leading_options(int argc, char** argv, Option* options,
+        int numOptions) {
+    int count = 0;
+    while (count + 1 < argc &&
+            find_option(argv[count + 1], options, numOptions) >= 0) {
+        count++;
+    }
+    return count;
+}
+
+/* See options.h */
+int parse_options(int* argc, char*** argv, Option* options, int numOptions) {
+    int numArgs = count_leading_options(*argc, *argv, options, numOptions);
+    int consumed = numArgs;
+    if (consumed + 1 < *argc &&
+            strcmp((*argv)[consumed + 1], OPTION_TERMINATOR) == 0) {
+        consumed++;
+    }
+
+    consume_options(argc, argv, options, numOptions, numArgs, consumed);
+    return consumed;
+}
+
+/* See options.h */
+int parse_terminated_options(int* argc, char*** argv, Option* options,
+        int numOptions) {
+    int numArgs = count_leading_options(*argc, *argv, options, numOptions);
+    if (numArgs == 0 || numArgs + 1 >= *argc ||
+            strcmp((*argv)[numArgs + 1], OPTION_TERMINATOR) != 0) {
+        return 0;
+    }
+
+    consume_options(argc, argv, options, numOptions, numArgs, numArgs + 1);
+    return numArgs + 1;
+}
+
+/* See options.h */
+bool parse_option_long(Option* option, long min, long max, long* result) {
+    if (option->value == NULL || option->value[0] == '\0') {
+        return false;
+    }
+    for (char* c = option->value; *c != '\0'; c++) {
+        if (!isdigit(*c)) {
+            return false;
+        }
+    }
+
+    long parsed = strtol(option->value, NULL, 10);
+    if (parsed < min || parsed > max) {
+        return false;
+    }
+
+    *result = parsed;
+    return true;
+}
@@ -0,0 +1,92 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+
+/* The prefix that marks an argument as an option rather than a positional */
+#define OPTION_PREFIX "--"
+/* An argument of exactly this value ends option parsing and is consumed */
+#define OPTION_TERMINATOR "--"
+
+typedef struct Option Option;
+
+/**
+ * A command line option of the form "--name=value" or "--name". Options
+ * must come before any positional arguments.
+ * Members:
+ *  - name -> the name of the option without the leading "--"
+ *  - value -> the text after the '=' if one was given, otherwise NULL
+ *  - present -> true if the option appeared on the command line
+ */
+struct Option {
+    char* name;
+    char* value;
+    bool present;
+};
+
+/**
+ * Reads any leading options from argv into the matching entries of
+ * "options". Parsing stops at the first argument that is not one of the
+ * provided options (so ids that happen to start with "--" are still treated
+ * as positionals) or after an argument of exactly "--".
+ *
+ * The consumed arguments are removed from the front of argv by shifting
+ * argv[0] forward, so callers can keep indexing their positional arguments
+ * from argv[1] after updating argc and argv.
+ *
+ * Parameters:
+ *  - argc -> a pointer to the argc of this instance
+ *  - argv -> a pointer to the argv of this instance
+ *  - options -> the options this program understands
+ *  - numOptions -> the number of entries in "options"
+ *
+ * Returns:
+ *  - The number of arguments that were consumed as options.
+ */
+int parse_options(int* argc, char*** argv, Option* options, int numOptions);
+
+/**
+ * Reads leading options from argv as parse_options does, but only if they
+ * are ended by an argument of exactly "--", for programs whose positional
+ * arguments are given by the spec. The spec lets any of those be an id that
+ * looks like an option, so otherwise nothing is consumed and every argument
+ * keeps the meaning the spec gives it:
+ *
+ *     roc2310 --parallel=4 -- id mapper {airports}
+ *
+ * A bare "--" with no options before it is also left alone, as it may be an
+ * id itself.
+ *
+ * Parameters:
+ *  - argc -> a pointer to the argc of this instance
+ *  - argv -> a pointer to the argv of this instance
+ *  - options -> the options this program understands
+ *  - numOptions -> the number of entries in "options"
+ *
+ * Returns:
+ *  - The number of arguments that were consumed, including the "--".
+ */
+int parse_terminated_options(int* argc, char*** argv, Option* options,
+        int numOptions);
+
+/**
+ * Parses the value of an option as a base 10 integer in [min, max].
+ *
+ * Parameters:
+ *  - option -> the option to read the value of
+ *  - min -> the lowest accepted value
+ *  - max -> the highest accepted value
+ *  - result -> where to write the parsed value
+ *
+ * Returns:
+ *  - true -> if the option has a value, it is entirely numeric and it is
+ *      within range.
+ *  - false -> otherwise. "result" is left unchanged.
+ */
+bool parse_option_long(Option* option, long min, long max, long* result);
+
+#endif
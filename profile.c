@@ -0,0 +1,34 @@
+#include "profile.h"
+
+/* The signals that stop a server, which are only handled by sigwait */
+static sigset_t stopSignals;
+
+/**
+ * Waits for one of stopSignals, then writes the profile and exits. Only
+ * _exit is called afterwards, as the other threads are still running and
+ * exit would write the profile a second time.
+ */
+static void* write_profile_on_stop(void* unused) {
+    int signal;
+    while (sigwait(&stopSignals, &signal) != 0) {
+    }
+    __gcov_dump();
+    _exit(EXIT_SUCCESS);
+}
+
+/**
+ * Blocks stopSignals before main runs, so that every thread the server
+ * starts inherits the mask and only write_profile_on_stop receives them,
+ * then starts that thread.
+ */
+__attribute__((constructor)) static void start_profile_writer(void) {
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGTERM);
+    sigaddset(&stopSignals, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, NULL);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, write_profile_on_stop, NULL) == 0) {
+        pthread_detach(thread);
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdlib.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/*
+ * Only linked into instrumented servers (see BUILD=pgo-generate in the
+ * Makefile). They only write their profile on a normal exit, but servers
+ * only ever stop by being killed, so SIGTERM and SIGINT are instead waited
+ * for by a thread of their own, which writes the profile and then exits.
+ * Being a separate object, the code of every other object is the same in
+ * the instrumented build and the build that uses its profile.
+ */
+
+/* Writes the profile gathered so far, from libgcov */
+extern void __gcov_dump(void);
+
+#endif
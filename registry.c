@@ -0,0 +1,369 @@
+#include "registry.h"
+
+/* See registry.h */
+bool create_registry(Registry* registry) {
+    memset(registry, 0, sizeof(Registry));
+    registry->slots = calloc(REGISTRY_INITIAL_SLOTS, sizeof(uint64_t));
+    if (registry->slots == NULL) {
+        return false;
+    }
+    registry->numSlots = REGISTRY_INITIAL_SLOTS;
+    return true;
+}
+
+/**
+ * Gets the id held in a RegistryId, wherever it's stored.
+ */
+static char* read_registry_id(RegistryId* id) {
+    return id->inlineId[0] != '\0' ? id->inlineId : id->overflow.id;
+}
+
+/**
+ * Gets the id held in a RegistryId, for sort_strings_by_key.
+ */
+static char* get_registry_id_key(void* id) {
+    return read_registry_id((RegistryId*) id);
+}
+
+/* See registry.h */
+char* get_registry_id(Registry* registry, int index) {
+    return read_registry_id(&registry->ids[index]);
+}
+
+/**
+ * Finds the slot of the hash table that holds an id, or the empty slot it
+ * would go in if it isn't registered.
+ */
+static uint64_t* find_registry_slot(Registry* registry, char* id,
+        uint32_t hash) {
+    uint32_t mask = registry->numSlots - 1;
+    for (uint32_t i = hash & mask; ; i = (i + 1) & mask) {
+        uint64_t slot = registry->slots[i];
+        if (slot == 0) {
+            return &registry->slots[i];
+        }
+        if ((uint32_t) (slot >> 32) == hash && strcmp(id,
+                get_registry_id(registry, (uint32_t) slot - 1)) == 0) {
+            return &registry->slots[i];
+        }
+    }
+}
+
+/* See registry.h */
+int search_registry(Registry* registry, char* id) {
+    uint64_t slot = *find_registry_slot(registry, id,
+            container_hash_string(id));
+    return slot == 0 ? REGISTRY_NOT_FOUND :
+            registry->ports[(uint32_t) slot - 1];
+}
+
+/**
+ * Doubles the size of the hash table. The hashes kept in each slot mean the
+ * ids themselves don't need to be read again.
+ */
+static bool grow_registry_slots(Registry* registry) {
+    int numSlots = registry->numSlots * 2;
+    uint64_t* slots = calloc(numSlots, sizeof(uint64_t));
+    if (slots == NULL) {
+        return false;
+    }
+
+    uint32_t mask = numSlots - 1;
+    for (int i = 0; i < registry->numSlots; i++) {
+        uint64_t slot = registry->slots[i];
+        if (slot == 0) {
+            continue;
+        }
+        uint32_t j = (uint32_t) (slot >> 32) & mask;
+        while (slots[j] != 0) {
+            j = (j + 1) & mask;
+        }
+        slots[j] = slot;
+    }
+
+    free(registry->slots);
+    registry->slots = slots;
+    registry->numSlots = numSlots;
+    return true;
+}
+
+/**
+ * Makes room for at least one more record.
+ */
+static bool grow_registry_records(Registry* registry) {
+    if (registry->length < registry->capacity) {
+        return true;
+    }
+    int capacity = registry->capacity == 0 ? REGISTRY_INITIAL_CAPACITY :
+            registry->capacity * 2;
+
+    RegistryId* ids = realloc(registry->ids, capacity * sizeof(RegistryId));
+    if (ids == NULL) {
+        return false;
+    }
+    registry->ids = ids;
+    int* ports = realloc(registry->ports, capacity * sizeof(int));
+    if (ports == NULL) {
+        return false;
+    }
+    registry->ports = ports;
+    registry->capacity = capacity;
+    return true;
+}
+
+/**
+ * Copies an id that's too long to be inline into the arena, starting a new
+ * block if the current one is full.
+ *
+ * Returns:
+ *  - the copy of the id
+ *  - NULL -> if a new block couldn't be allocated
+ */
+static char* copy_to_registry_arena(Registry* registry, char* id,
+        size_t size) {
+    RegistryArenaBlock* block = registry->arena;
+    if (block == NULL || block->capacity - block->used < size) {
+        size_t capacity = size > REGISTRY_ARENA_BLOCK_SIZE ? size :
+                REGISTRY_ARENA_BLOCK_SIZE;
+        block = malloc(sizeof(RegistryArenaBlock) + capacity);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->next = registry->arena;
+        block->used = 0;
+        block->capacity = capacity;
+        registry->arena = block;
+    }
+
+    char* copy = block->data + block->used;
+    memcpy(copy, id, size);
+    block->used += size;
+    return copy;
+}
+
+/* See registry.h */
+bool add_to_registry(Registry* registry, char* id, int port) {
+    uint32_t hash = container_hash_string(id);
+    uint64_t* slot = find_registry_slot(registry, id, hash);
+    if (*slot != 0) {
+        return false;
+    }
+    // Probing relies on the table always having an empty slot, which only
+    // matters if growing the table has failed
+    if (registry->length + 1 >= registry->numSlots) {
+        return false;
+    }
+    if (!grow_registry_records(registry)) {
+        return false;
+    }
+
+    RegistryId* record = &registry->ids[registry->length];
+    memset(record, 0, sizeof(RegistryId));
+    size_t size = strlen(id) + 1;
+    if (size <= REGISTRY_INLINE_ID_SIZE) {
+        memcpy(record->inlineId, id, size);
+    } else {
+        record->overflow.id = copy_to_registry_arena(registry, id, size);
+        if (record->overflow.id == NULL) {
+            return false;
+        }
+    }
+    registry->ports[registry->length] = port;
+    registry->length++;
+    *slot = ((uint64_t) hash << 32) | (uint32_t) registry->length;
+
+    if (registry->length * 4 >
+            registry->numSlots * REGISTRY_MAX_LOAD_QUARTERS) {
+        // If this fails the table is just fuller than it should be, which
+        // is still correct as long as there's an empty slot left
+        grow_registry_slots(registry);
+    }
+    return true;
+}
+
+/* See registry.h */
+bool start_registry_order_update(Registry* registry,
+        RegistryOrderUpdate* update) {
+    update->first = registry->orderLength;
+    update->length = 0;
+    int numNew = registry->length - registry->orderLength;
+    if (numNew > update->capacity) {
+        RegistryId* ids = realloc(update->ids, numNew * sizeof(RegistryId));
+        if (ids == NULL) {
+            return false;
+        }
+        update->ids = ids;
+        RegistryId** sorted = realloc(update->sorted,
+                numNew * sizeof(RegistryId*));
+        if (sorted == NULL) {
+            return false;
+        }
+        update->sorted = sorted;
+        update->capacity = numNew;
+    }
+
+    // Long ids never move, so copying the records copies every id
+    memcpy(update->ids, &registry->ids[update->first],
+            numNew * sizeof(RegistryId));
+    update->length = numNew;
+    return true;
+}
+
+/* See registry.h */
+bool sort_registry_order_update(RegistryOrderUpdate* update) {
+    if (update->length == 0) {
+        return true;
+    }
+    for (int i = 0; i < update->length; i++) {
+        update->sorted[i] = &update->ids[i];
+    }
+    free(update->merged);
+    update->merged = calloc(update->first + update->length, sizeof(int));
+    if (update->merged == NULL || !sort_strings_by_key(
+            (void**) update->sorted, update->length, get_registry_id_key,
+            sysconf(_SC_NPROCESSORS_ONLN))) {
+        update->length = 0;
+        return false;
+    }
+
+    return true;
+}
+
+/* See registry.h */
+void finish_registry_order_update(Registry* registry,
+        RegistryOrderUpdate* update) {
+    int numOld = update->first;
+    int numNew = update->length;
+    update->length = 0;
+    if (numNew == 0 || registry->orderLength != numOld) {
+        return;
+    }
+
+    int* order = registry->order;
+    int* merged = update->merged;
+    int i = 0;
+    int j = 0;
+    int k = 0;
+    while (i < numOld && j < numNew) {
+        if (strcmp(get_registry_id_key(update->sorted[j]),
+                get_registry_id(registry, order[i])) < 0) {
+            merged[k++] = numOld + (update->sorted[j++] - update->ids);
+        } else {
+            merged[k++] = order[i++];
+        }
+    }
+    while (i < numOld) {
+        merged[k++] = order[i++];
+    }
+    while (j < numNew) {
+        merged[k++] = numOld + (update->sorted[j++] - update->ids);
+    }
+
+    free(order);
+    registry->order = merged;
+    registry->orderLength = numOld + numNew;
+    update->merged = NULL;
+}
+
+/* See registry.h */
+void destroy_registry_order_update(RegistryOrderUpdate* update) {
+    free(update->ids);
+    free(update->sorted);
+    free(update->merged);
+    memset(update, 0, sizeof(RegistryOrderUpdate));
+}
+
+/**
+ * Sorts the records added since the order was last known, then merges them
+ * into the order, all in one go.
+ */
+static bool update_registry_order(Registry* registry) {
+    RegistryOrderUpdate update = {0};
+    bool updated = start_registry_order_update(registry, &update) &&
+            sort_registry_order_update(&update);
+    if (updated) {
+        finish_registry_order_update(registry, &update);
+    }
+    destroy_registry_order_update(&update);
+
+    return updated;
+}
+
+/* See registry.h */
+int* get_registry_order(Registry* registry) {
+    if (registry->orderLength < registry->length &&
+            !update_registry_order(registry)) {
+        return NULL;
+    }
+    return registry->order;
+}
+
+/**
+ * Makes room for at least "needed" records in a snapshot.
+ */
+static bool grow_registry_snapshot(RegistrySnapshot* snapshot, int needed) {
+    if (needed <= snapshot->capacity) {
+        return true;
+    }
+    int capacity = snapshot->capacity == 0 ? REGISTRY_INITIAL_CAPACITY :
+            snapshot->capacity;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+
+    RegistryId* ids = realloc(snapshot->ids, capacity * sizeof(RegistryId));
+    if (ids == NULL) {
+        return false;
+    }
+    snapshot->ids = ids;
+    int* ports = realloc(snapshot->ports, capacity * sizeof(int));
+    if (ports == NULL) {
+        return false;
+    }
+    snapshot->ports = ports;
+    snapshot->capacity = capacity;
+    return true;
+}
+
+/* See registry.h */
+bool take_registry_snapshot(Registry* registry, RegistrySnapshot* snapshot) {
+    snapshot->length = 0;
+    int* order = get_registry_order(registry);
+    if ((order == NULL && registry->length > 0) ||
+            !grow_registry_snapshot(snapshot, registry->length)) {
+        return false;
+    }
+
+    for (int i = 0; i < registry->length; i++) {
+        snapshot->ids[i] = registry->ids[order[i]];
+        snapshot->ports[i] = registry->ports[order[i]];
+    }
+    snapshot->length = registry->length;
+    return true;
+}
+
+/* See registry.h */
+char* get_snapshot_id(RegistrySnapshot* snapshot, int index) {
+    return read_registry_id(&snapshot->ids[index]);
+}
+
+/* See registry.h */
+void destroy_registry_snapshot(RegistrySnapshot* snapshot) {
+    free(snapshot->ids);
+    free(snapshot->ports);
+    memset(snapshot, 0, sizeof(RegistrySnapshot));
+}
+
+/* See registry.h */
+void destroy_registry(Registry* registry) {
+    while (registry->arena != NULL) {
+        RegistryArenaBlock* next = registry->arena->next;
+        free(registry->arena);
+        registry->arena = next;
+    }
+    free(registry->ids);
+    free(registry->ports);
+    free(registry->slots);
+    free(registry->order);
+    memset(registry, 0, sizeof(Registry));
+}
@@ -0,0 +1,307 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "containers.h"
+#include "stringsort.h"
+
+/* The size of the id stored in each record. Ids up to one less than this
+ * (leaving room for the terminator) are stored inline */
+#define REGISTRY_INLINE_ID_SIZE 16
+/* The number of records to make room for on the first add */
+#define REGISTRY_INITIAL_CAPACITY 64
+/* The number of slots in the hash table of an empty Registry */
+#define REGISTRY_INITIAL_SLOTS 128
+/* The hash table grows once more than this many quarters of it are used */
+#define REGISTRY_MAX_LOAD_QUARTERS 3
+/* The size of each block of the arena holding ids too long to be inline */
+#define REGISTRY_ARENA_BLOCK_SIZE 65536
+/* Returned by search_registry when the id isn't registered */
+#define REGISTRY_NOT_FOUND -1
+
+typedef union RegistryId RegistryId;
+typedef struct RegistryArenaBlock RegistryArenaBlock;
+typedef struct Registry Registry;
+typedef struct RegistrySnapshot RegistrySnapshot;
+typedef struct RegistryOrderUpdate RegistryOrderUpdate;
+
+/**
+ * The id of a record in a Registry. Ids are never empty, so an id that
+ * starts with a terminator marks an id too long to fit inline, which is
+ * instead stored in the Registry's arena.
+ * Members:
+ *  - inlineId -> the id itself, if it's shorter than REGISTRY_INLINE_ID_SIZE
+ *  - overflow.marker -> '\0' if the id is stored in the arena
+ *  - overflow.id -> where the id is stored in the arena
+ */
+union RegistryId {
+    char inlineId[REGISTRY_INLINE_ID_SIZE];
+    struct {
+        char marker;
+        char* id;
+    } overflow;
+};
+
+/**
+ * A block of memory that long ids are copied into. Blocks are never moved
+ * or freed until the Registry is destroyed, so ids in them stay put.
+ * Members:
+ *  - next -> the block that was filled before this one
+ *  - used -> the number of bytes of data used so far
+ *  - capacity -> the number of bytes of data
+ *  - data -> the ids in this block
+ */
+struct RegistryArenaBlock {
+    RegistryArenaBlock* next;
+    size_t used;
+    size_t capacity;
+    char data[];
+};
+
+/**
+ * A compact map of ids to ports. Records are stored as parallel arrays in
+ * the order they were added, and found with an open addressing hash table.
+ * Each slot of the table packs an id's hash with the index of its record,
+ * so probing only touches a record once the whole hash has matched.
+ * Members:
+ *  - ids -> the id of each record
+ *  - ports -> the port of each record
+ *  - length -> the number of records
+ *  - capacity -> the number of records there is room for
+ *  - slots -> the hash table. Each slot is empty (0), or holds the hash of
+ *      an id in its top 32 bits and the index of its record plus 1 in its
+ *      bottom 32 bits
+ *  - numSlots -> the size of slots, always a power of 2
+ *  - arena -> the block long ids are currently being copied into
+ *  - order -> the indices of the records sorted by id
+ *  - orderLength -> the number of records in order. Any records added since
+ *      order was last sorted aren't in it yet
+ */
+struct Registry {
+    RegistryId* ids;
+    int* ports;
+    int length;
+    int capacity;
+    uint64_t* slots;
+    int numSlots;
+    RegistryArenaBlock* arena;
+    int* order;
+    int orderLength;
+};
+
+/**
+ * A copy of the records of a Registry sorted by id, so that they can be read
+ * without holding whatever guards the Registry. Ids too long to be inline
+ * are not copied, as they never move, so a snapshot must not outlive its
+ * Registry. A zeroed snapshot is empty, and the memory of a snapshot is
+ * reused each time it is taken again.
+ * Members:
+ *  - ids -> the id of each record, sorted
+ *  - ports -> the port of each record
+ *  - length -> the number of records
+ *  - capacity -> the number of records there is room for
+ */
+struct RegistrySnapshot {
+    RegistryId* ids;
+    int* ports;
+    int length;
+    int capacity;
+};
+
+/**
+ * The records added to a Registry since its order was last updated, copied
+ * out so that they can be sorted without holding whatever guards the
+ * Registry, and then merged into its order. A zeroed update is empty, and
+ * the memory of an update is reused each time it is started again.
+ * Members:
+ *  - ids -> copies of the ids of the new records, in the order they were
+ *      added
+ *  - sorted -> pointers into ids, sorted by id once the update is sorted
+ *  - merged -> the order with the new records merged in, which the
+ *      Registry takes when the update is finished
+ *  - first -> the index in the Registry of the first new record, which is
+ *      also the number of records that were already in its order
+ *  - length -> the number of new records
+ *  - capacity -> the number of new records there is room for
+ */
+struct RegistryOrderUpdate {
+    RegistryId* ids;
+    RegistryId** sorted;
+    int* merged;
+    int first;
+    int length;
+    int capacity;
+};
+
+/**
+ * Initialises an empty Registry.
+ *
+ * Parameters:
+ *  - registry -> the registry to initialise
+ *
+ * Returns:
+ *  - true -> if the registry was initialised
+ *  - false -> if its hash table couldn't be allocated
+ */
+bool create_registry(Registry* registry);
+
+/**
+ * Gets the id of a record in a Registry.
+ *
+ * Parameters:
+ *  - registry -> the registry holding the record
+ *  - index -> the index of the record, as given by get_registry_order
+ *
+ * Returns:
+ *  - the id of the record
+ */
+char* get_registry_id(Registry* registry, int index);
+
+/**
+ * Finds the port registered for an id.
+ *
+ * Parameters:
+ *  - registry -> the registry to search
+ *  - id -> the id to search for
+ *
+ * Returns:
+ *  - the port registered for the id
+ *  - REGISTRY_NOT_FOUND -> if the id isn't registered
+ */
+int search_registry(Registry* registry, char* id);
+
+/**
+ * Registers a port for an id, unless the id is already registered, in which
+ * case the port it already has is kept. The id is copied, so it may be
+ * reused once this returns.
+ *
+ * Parameters:
+ *  - registry -> the registry to add to
+ *  - id -> the id to register, which must not be empty
+ *  - port -> the port to register for the id
+ *
+ * Returns:
+ *  - true -> if the id was registered
+ *  - false -> if the id was already registered or memory couldn't be
+ *      allocated
+ */
+bool add_to_registry(Registry* registry, char* id, int port);
+
+/**
+ * Gets the indices of every record in a Registry, sorted by id. Only records
+ * added since the last call are sorted, and merged into the order already
+ * known.
+ *
+ * Parameters:
+ *  - registry -> the registry to get the order of
+ *
+ * Returns:
+ *  - registry->length indices, sorted by id. These belong to the registry
+ *      and are only valid until it's next added to.
+ *  - NULL -> if the registry is empty or memory for the order couldn't be
+ *      allocated
+ */
+int* get_registry_order(Registry* registry);
+
+/**
+ * Starts updating the order of a Registry by copying out the records added
+ * since it was last updated. Only this and finish_registry_order_update need
+ * whatever guards the registry to be held; sort_registry_order_update, which
+ * does the actual sorting, doesn't.
+ *
+ * Parameters:
+ *  - registry -> the registry whose order is to be updated
+ *  - update -> the update to copy the new records into, replacing what it
+ *      held
+ *
+ * Returns:
+ *  - true -> if every new record was copied
+ *  - false -> if memory for the copies couldn't be allocated, in which case
+ *      the update is empty
+ */
+bool start_registry_order_update(Registry* registry,
+        RegistryOrderUpdate* update);
+
+/**
+ * Sorts the records copied by start_registry_order_update and makes room for
+ * the order they will be merged into. This doesn't touch the registry, so
+ * it may be added to meanwhile.
+ *
+ * Parameters:
+ *  - update -> the update to sort
+ *
+ * Returns:
+ *  - true -> if the update was sorted
+ *  - false -> if memory for the sort couldn't be allocated, in which case
+ *      the update is empty
+ */
+bool sort_registry_order_update(RegistryOrderUpdate* update);
+
+/**
+ * Merges a sorted update into the order of a Registry. If the order was
+ * updated by something else since the update was started, the update is
+ * dropped, and whatever records are still missing from the order are
+ * sorted the next time it's needed. Either way the update is left empty.
+ *
+ * Parameters:
+ *  - registry -> the registry the update was started on
+ *  - update -> the sorted update
+ */
+void finish_registry_order_update(Registry* registry,
+        RegistryOrderUpdate* update);
+
+/**
+ * Frees the memory held by a RegistryOrderUpdate, leaving it empty.
+ */
+void destroy_registry_order_update(RegistryOrderUpdate* update);
+
+/**
+ * Copies every record of a Registry into a snapshot, sorted by id. As with
+ * get_registry_order, only records added since the order was last known
+ * need sorting, and nothing else is done with the registry held, so the
+ * snapshot can be formatted or sent after whatever guards the registry is
+ * let go of.
+ *
+ * Parameters:
+ *  - registry -> the registry to copy
+ *  - snapshot -> the snapshot to copy into, replacing what it held
+ *
+ * Returns:
+ *  - true -> if every record was copied
+ *  - false -> if memory for the order or the snapshot couldn't be allocated,
+ *      in which case the snapshot is empty
+ */
+bool take_registry_snapshot(Registry* registry, RegistrySnapshot* snapshot);
+
+/**
+ * Gets the id of a record in a RegistrySnapshot.
+ *
+ * Parameters:
+ *  - snapshot -> the snapshot holding the record
+ *  - index -> the position of the record in the snapshot
+ *
+ * Returns:
+ *  - the id of the record
+ */
+char* get_snapshot_id(RegistrySnapshot* snapshot, int index);
+
+/**
+ * Frees the memory held by a RegistrySnapshot, leaving it empty.
+ */
+void destroy_registry_snapshot(RegistrySnapshot* snapshot);
+
+/**
+ * Frees everything held by a Registry.
+ *
+ * Parameters:
+ *  - registry -> the registry to destroy
+ */
+void destroy_registry(Registry* registry);
+
+#endif
@@ -1,4 +1,66 @@
 #include "roc2310.h"
+#include "fleet.h"
+
+/**
+ * Writes how long one phase of a flight took as a line of the --timing file,
+ * in the columns named by TIMING_HEADER. Does nothing if timing is off.
+ * 
+ * Parameters:
+ *  - timing -> where to write the timing, or NULL if timing is off
+ *  - phase -> what was timed: "mapper_connect", "lookup", "connect", "send"
+ *      or "response"
+ *  - destination -> the index in the route of the destination the phase
+ *      was for, or -1 (written as an empty column) for the mapper connect
+ *  - target -> the mapper port, airport id or destination port involved
+ *  - startNs -> the get_monotonic_ns() time the phase started at
+ *  - result -> "ok", or how the phase failed
+ */
+void record_timing(Timing* timing, const char* phase, int destination,
+        char* target, long long startNs, const char* result) {
+    if (timing == NULL || timing->to == NULL) {
+        return;
+    }
+    long long endNs = get_monotonic_ns();
+
+    // One fprintf per line keeps lines from concurrent visits whole
+    if (destination < 0) {
+        fprintf(timing->to, "%s,,%s,%lld,%lld,%s\n", phase, target,
+                startNs - timing->startNs, endNs - startNs, result);
+    } else {
+        fprintf(timing->to, "%s,%d,%s,%lld,%lld,%s\n", phase, destination,
+                target, startNs - timing->startNs, endNs - startNs, result);
+    }
+}
+
+/**
+ * Gets the result a --timing line gives for a ClientError.
+ */
+static const char* get_client_result(int error) {
+    switch (error) {
+        case CLIENT_OK:
+            return "ok";
+        case CLIENT_TIMED_OUT:
+            return "timed_out";
+        default:
+            return "failed";
+    }
+}
+
+/**
+ * Gets the result a --timing line gives for a LookupError.
+ */
+static const char* get_lookup_result(int error) {
+    switch (error) {
+        case LOOKUP_OK:
+            return "ok";
+        case LOOKUP_NO_ENTRY:
+            return "no_entry";
+        case LOOKUP_TIMED_OUT:
+            return "timed_out";
+        default:
+            return "failed";
+    }
+}
 
 /**
  * Checks if a mapper2310s port has been provided. 
@@ -9,21 +71,29 @@
  * provided to this plane (roc2310) are checked to make sure they are all 
  * valid ports.
  * 
+ * argv[2] may also be a comma separated list of ports, in which case a
+ * connection is made to each mapper2310 and only one of them needs to
+ * succeed.
+ * 
  * Parameters:
  *  - argc -> the argc of this roc2310 instance
  *  - argv -> the arguments provided to this roc2310 instance
- *  - mapperConnection -> the Client struct representing the connection to the
- *      mapper2310 server.
+ *  - mappers -> the MapperPool to store the connections to the mapper2310
+ *      servers in.
+ *  - timeouts -> the limits on how long the connection may block for
+ *  - timing -> where to report how long connecting took
  * 
  * Returns:
  *  - ROC_OK -> if everything is ok with the mapper and args provided
  *  - ROC_MAPPER_REQUIRED -> if one of the destinations is not a valid port
  *      but no mapper port was provided (i.e. mapper port = "-")
  *  - ROC_INVALID_MAPPER_PORT -> if a port is provided but it is not valid
- *  - ROC_MAPPER_CONN_FAILURE -> if there was an issue connecting to the
- *      given port.
+ *  - ROC_MAPPER_TIMED_OUT -> if connecting to the given port timed out
+ *  - ROC_MAPPER_CONN_FAILURE -> if there was any other issue connecting to
+ *      the given port
  */
-RocError connect_to_mapper(int argc, char** argv, Client* mapperConnection) {
+RocError connect_to_mapper(int argc, char** argv, MapperPool* mappers,
+        ClientTimeouts* timeouts, Timing* timing) {
     // TODO: Check if this return order works according to the spec.
     if (strcmp("-", argv[2]) == 0) {
         for (int i = 3; i < argc; i++) {
@@ -34,11 +104,16 @@ RocError connect_to_mapper(int argc, char** argv, Client* mapperConnection) {
         return ROC_OK;
     }
 
-    if (!is_valid_port(argv[2])) {
+    if (!is_valid_mapper_list(argv[2])) {
         return ROC_INVALID_MAPPER_PORT;
     }
-    int error = setup_client_on_port(argv[2], mapperConnection);
-    if (error != CLIENT_OK) {
+    long long start = get_monotonic_ns();
+    int error = connect_mapper_pool(mappers, argv[2], timeouts);
+    record_timing(timing, "mapper_connect", -1, argv[2], start,
+            get_lookup_result(error));
+    if (error == LOOKUP_TIMED_OUT) {
+        return ROC_MAPPER_TIMED_OUT;
+    } else if (error != LOOKUP_OK) {
         return ROC_MAPPER_CONN_FAILURE;
     }
 
@@ -47,64 +122,82 @@ RocError connect_to_mapper(int argc, char** argv, Client* mapperConnection) {
 
 /**
  * Asks a mapper2310 server for the port to a control2310 with a specific "id".
+ * If several mapper2310s were given the lookup is hedged across them, see
+ * lookup_control_port. The round trip is reported as a "lookup" timing.
  * 
  * Parameters:
  *  - data -> the data for this roc2310 instance
  *  - id -> the id of the control2310 instance which the mapper is being asked
  *      the port for
  *  - port -> the buffer to write the port for the control2310 into
+ *  - destination -> the index in the route of the destination being looked
+ *      up
  * 
  * Returns:
  *  - ROC_MAPPER_NO_ENTRY -> if there is no entry in the mapper2310 for the
  *      given id
+ *  - ROC_MAPPER_TIMED_OUT -> if the mapper2310 didn't answer within this
+ *      roc2310's timeouts
+ *  - ROC_MAPPER_CONN_FAILURE -> if every mapper2310 hung up without
+ *      answering
  *  - ROC_OK -> if the port was successfully retrieved and written to "port"
  */
-RocError ask_for_control_port(Plane* data, char* id, char* port) {
-    char* queryBuffer = calloc(strlen(id) + 2, sizeof(char));
-    sprintf(queryBuffer, "?%s", id);
-    send_message(data->mapperConnection->writeTo, queryBuffer);
-
-    char* responseBuffer = calloc(80, sizeof(char));
-    read_message(data->mapperConnection->readFrom, responseBuffer);
-    if (strcmp(";", responseBuffer) == 0 || strlen(responseBuffer) == 0) {
-        return ROC_MAPPER_NO_ENTRY;
+RocError ask_for_control_port(Plane* data, char* id, char* port,
+        int destination) {
+    long long start = get_monotonic_ns();
+    LookupError error = lookup_control_port(data->mappers, id, port);
+    record_timing(&data->timing, "lookup", destination, id, start,
+            get_lookup_result(error));
+    switch (error) {
+        case LOOKUP_OK:
+            return ROC_OK;
+        case LOOKUP_TIMED_OUT:
+            return ROC_MAPPER_TIMED_OUT;
+        case LOOKUP_CONN_FAILURE:
+            return ROC_MAPPER_CONN_FAILURE;
+        default:
+            return ROC_MAPPER_NO_ENTRY;
     }
-    strcpy(port, responseBuffer);
-
-    free(queryBuffer);
-    free(responseBuffer);
-
-    return ROC_OK;
 }
 
 /**
- * Convert the destination airport ids (control2310 ids) provided in the args 
- * to ports (control2310 ports).
+ * Convert the destination airport ids (control2310 ids) in a batch of
+ * destinations to ports (control2310 ports). Destinations that are already
+ * ports are used as they are.
  * 
  * Parameters:
- *  - argc -> the argc value provided to this roc2310 instance
- *  - argv -> the args provided to this roc2310 instance
+ *  - destinations -> the ids or ports of the destinations in this batch
+ *  - numDestinations -> the number of destinations in this batch, at most
+ *      the capacity given to setup_destination_ports
  *  - data -> the data of this roc2310 instance
  * 
  * Returns:
+ *  - ROC_MAPPER_REQUIRED -> if any destination isn't a port but no mapper
+ *      port was provided
  *  - ROC_MAPPER_NO_ENTRY -> if any of the ids provided in the arguments does
  *      not have a valid mapped port in the mapper2310.
+ *  - ROC_MAPPER_TIMED_OUT -> if the mapper2310 stopped answering within
+ *      this roc2310's timeouts.
  *  - ROC_OK -> if all of the ids are successfully converted.
  */
-RocError convert_destination_airports(int argc, char** argv, Plane* data) {
-    for (int i = 0; i < data->numDestinations; i++) {
-        char* controlPort = argv[i + 3];
-        if (!is_valid_port(argv[i + 3])) {
-            controlPort = calloc(6, sizeof(char));
-            int error = ask_for_control_port(data, argv[i + 3], controlPort);
-            if (error != ROC_OK) {
-                return error;
-            }
+RocError convert_destination_airports(char** destinations,
+        int numDestinations, Plane* data) {
+    data->numDestinations = numDestinations;
+    for (int i = 0; i < numDestinations; i++) {
+        data->destinationPorts[i] = destinations[i];
+        if (is_valid_port(destinations[i])) {
+            continue;
+        }
+        if (data->mappers->numReplicas == 0) {
+            return ROC_MAPPER_REQUIRED;
         }
 
-        data->destinationPorts[i] = calloc(
-                strlen(controlPort) + 1, sizeof(char));
-        strcpy(data->destinationPorts[i], controlPort);
+        data->destinationPorts[i] = data->resolvedPorts[i];
+        int error = ask_for_control_port(data, destinations[i],
+                data->resolvedPorts[i], data->firstDestination + i);
+        if (error != ROC_OK) {
+            return error;
+        }
     }
 
     return ROC_OK;
@@ -112,32 +205,207 @@ RocError convert_destination_airports(int argc, char** argv, Plane* data) {
 
 /**
  * Visit a destination (control2310) with the given port and send this 
- * roc2310's id to it.
+ * roc2310's id to it. The connection is closed again before returning so a
+ * long route only ever holds one connection per concurrent visit. Connecting,
+ * sending the id and waiting for the response are each reported as a timing.
  * 
  * Parameters:
  *  - id -> this roc2310 instance's id
  *  - destinationPort -> the port of the control2310 instance to connect to
  *  - destinationInfo -> a buffer to write the control2310 instance's info to
+ *  - timeouts -> the limits on how long the visit may block for
+ *  - timing -> where to report how long each phase took, or NULL
+ *  - destination -> the index in the route of the destination
  * 
  * Returns:
+ *  - ROC_CONTROL_TIMED_OUT -> if any part of the visit doesn't complete
+ *      within the timeouts
  *  - ROC_CONTROL_CONN_FAILURE -> if connection to the given destinationPort
- *      fails
+ *      fails otherwise
  *  - ROC_OK -> if the control2310 is successfully connected to, this roc2310's
  *      id is sent and the control2310's info read.
  */
 RocError visit_destination(char* id, char* destinationPort,
-        char* destinationInfo) {
-    Client* destinationConnection = calloc(1, sizeof(Client));
-    int error = setup_client_on_port(destinationPort, destinationConnection);
-    if (error != CLIENT_OK) {
+        char* destinationInfo, ClientTimeouts* timeouts, Timing* timing,
+        int destination) {
+    Client destinationConnection;
+    long long start = get_monotonic_ns();
+    int error = setup_client_with_timeouts(destinationPort, 
+            &destinationConnection, timeouts);
+    record_timing(timing, "connect", destination, destinationPort, start,
+            get_client_result(error));
+    if (error == CLIENT_TIMED_OUT) {
+        return ROC_CONTROL_TIMED_OUT;
+    } else if (error != CLIENT_OK) {
         return ROC_CONTROL_CONN_FAILURE;
     }
 
-    char* queryBuffer = calloc(strlen(id) + 2, sizeof(char));
-    sprintf(queryBuffer, "%s", id);
-    send_message(destinationConnection->writeTo, queryBuffer);
+    // A control2310 that hangs up without answering is still counted as
+    // visited, but one that doesn't answer in time is not
+    start = get_monotonic_ns();
+    error = send_client_message(&destinationConnection, id);
+    record_timing(timing, "send", destination, destinationPort, start,
+            get_client_result(error));
+    if (error != CLIENT_TIMED_OUT) {
+        start = get_monotonic_ns();
+        error = read_client_message(&destinationConnection, destinationInfo);
+        record_timing(timing, "response", destination, destinationPort,
+                start, get_client_result(error));
+    }
+    close_client(&destinationConnection);
+    if (error == CLIENT_TIMED_OUT) {
+        return ROC_CONTROL_TIMED_OUT;
+    }
 
-    read_message(destinationConnection->readFrom, destinationInfo);
+    return ROC_OK;
+}
+
+/**
+ * Prints the info of an airport (control2310) as soon as it has been
+ * visited, so that the log of a long route streams out instead of being held
+ * until the end.
+ * 
+ * The infos are printed one per line, except that a route whose only visited
+ * airport has an empty info prints nothing at all. So an empty first info is
+ * held back until a second info arrives.
+ * 
+ * Parameters:
+ *  - data -> this roc2310 instance's data
+ *  - info -> the info of the airport just visited, in route order
+ */
+void print_airport_info(Plane* data, char* info) {
+    data->numVisited++;
+    if (data->numVisited == 1 && strlen(info) == 0) {
+        data->holdingEmptyInfo = true;
+        return;
+    }
+    if (data->holdingEmptyInfo) {
+        data->holdingEmptyInfo = false;
+        send_message(stdout, "");
+    }
+
+    send_message(stdout, info);
+}
+
+/**
+ * Prints the infos of every destination at the front of a VisitQueue that
+ * has finished being visited, stopping at the first one still being visited
+ * so that infos are printed in route order. The queue's lock must be held.
+ * 
+ * Parameters:
+ *  - queue -> the VisitQueue shared by all of the visiting threads
+ */
+void print_finished_visits(VisitQueue* queue) {
+    while (queue->nextToPrint < queue->plane->numDestinations &&
+            queue->finished[queue->nextToPrint]) {
+        VisitedAirportInfo info = queue->destinationInfos[queue->nextToPrint];
+        if (info == NULL) {
+            queue->connFailure = true;
+        } else {
+            print_airport_info(queue->plane, info);
+            free(info);
+        }
+        queue->nextToPrint++;
+    }
+}
+
+/**
+ * Visits destinations from a shared VisitQueue until none are left. Made to
+ * be called as a function pointer in order to start a new thread.
+ * 
+ * Parameters:
+ *  - uncastedQueue -> the VisitQueue shared by all of the visiting threads
+ * 
+ * Return:
+ *  NULL - once every destination has been taken from the queue.
+ */
+void* visit_queued_destinations(void* uncastedQueue) {
+    VisitQueue* queue = (VisitQueue*) uncastedQueue;
+    Plane* data = queue->plane;
+    while (true) {
+        pthread_mutex_lock(&queue->lock);
+        int destination = queue->nextDestination++;
+        pthread_mutex_unlock(&queue->lock);
+        if (destination >= data->numDestinations) {
+            return NULL;
+        }
+
+        char* destinationInfo = calloc(MESSAGE_BUFFER_SIZE, sizeof(char));
+        int error = visit_destination(data->id, 
+                data->destinationPorts[destination], destinationInfo,
+                &data->timeouts, &data->timing,
+                data->firstDestination + destination);
+        if (error != ROC_OK) {
+            free(destinationInfo);
+            destinationInfo = NULL;
+        }
+
+        pthread_mutex_lock(&queue->lock);
+        queue->timedOut = queue->timedOut || error == ROC_CONTROL_TIMED_OUT;
+        queue->destinationInfos[destination] = destinationInfo;
+        queue->finished[destination] = true;
+        print_finished_visits(queue);
+        pthread_mutex_unlock(&queue->lock);
+    }
+}
+
+/**
+ * Visit all of the destinations (control2310s) loaded by this roc2310, up to
+ * data->maxParallelVisits at a time. Each destination's info is printed once
+ * it and every destination before it have been visited so that the log
+ * stays in route order.
+ * 
+ * Parameters:
+ *  - data -> this roc2310 instance's data
+ * 
+ * Returns:
+ *  - ROC_CONTROL_TIMED_OUT -> if visiting any of the provided control2310's
+ *      timed out.
+ *  - ROC_CONTROL_CONN_FAILURE -> if connecting to any of the provided
+ *      control2310's otherwise fails.
+ *  - ROC_OK -> if a connection has been made to each provided control2310
+ *      port and the communication is successful.
+ */
+RocError visit_destinations_in_parallel(Plane* data) {
+    VisitQueue queue;
+    queue.plane = data;
+    queue.nextDestination = 0;
+    queue.nextToPrint = 0;
+    queue.connFailure = false;
+    queue.timedOut = false;
+    queue.destinationInfos = calloc(data->numDestinations, 
+            sizeof(VisitedAirportInfo));
+    queue.finished = calloc(data->numDestinations, sizeof(bool));
+    pthread_mutex_init(&queue.lock, NULL);
+
+    int numThreads = data->maxParallelVisits < data->numDestinations ?
+            data->maxParallelVisits : data->numDestinations;
+    pthread_t* threads = calloc(numThreads, sizeof(pthread_t));
+    int numStarted = 0;
+    for (; numStarted < numThreads; numStarted++) {
+        if (pthread_create(&threads[numStarted], NULL,
+                visit_queued_destinations, &queue)) {
+            break;
+        }
+    }
+    // If no thread could be started, visit everything on this one
+    if (numStarted == 0) {
+        visit_queued_destinations(&queue);
+    }
+    for (int i = 0; i < numStarted; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&queue.lock);
+    free(queue.destinationInfos);
+    free(queue.finished);
+    free(threads);
+
+    if (queue.timedOut) {
+        return ROC_CONTROL_TIMED_OUT;
+    } else if (queue.connFailure == true) {
+        return ROC_CONTROL_CONN_FAILURE;
+    }
 
     return ROC_OK;
 }
@@ -150,34 +418,47 @@ RocError visit_destination(char* id, char* destinationPort,
  * ports. After an attempt has been made to connect to all of the ports, this
  * function returns with an error (ROC_CONTROL_CONN_FAILURE).
  * 
- * After connecting to a control2310, its info is requested and added to a log
- * of all control2310 infos within "data".
+ * After connecting to a control2310, its info is requested and printed
+ * straight away. If data->maxParallelVisits is more than 1 the destinations
+ * are visited concurrently instead, see visit_destinations_in_parallel.
  * 
  * Parameters:
  *  - data -> this roc2310 instance's data. Also contains an array of
  *      destination ports which are used for to connect to
  * 
  * Returns:
+ *  - ROC_CONTROL_TIMED_OUT -> if visiting any of the provided control2310's
+ *      timed out.
  *  - ROC_CONTROL_CONN_FAILURE -> if connecting to any of the provided
- *      control2310's fails.
+ *      control2310's otherwise fails.
  *  - ROC_OK -> if a connection has been made to each provided control2310
  *      port and the communication is successful.
  */
 RocError visit_destinations(Plane* data) {
+    if (data->maxParallelVisits > 1) {
+        return visit_destinations_in_parallel(data);
+    }
+
     bool connFailureFlag = false;
+    bool timedOut = false;
+    char destinationInfo[MESSAGE_BUFFER_SIZE];
     for (int i = 0; i < data->numDestinations; i++) {
-        char* destinationInfo = calloc(80, sizeof(char));
+        destinationInfo[0] = '\0';
         int error = visit_destination(data->id, data->destinationPorts[i], 
-                destinationInfo);
+                destinationInfo, &data->timeouts, &data->timing,
+                data->firstDestination + i);
         if (error != ROC_OK) {
             connFailureFlag = true;
+            timedOut = timedOut || error == ROC_CONTROL_TIMED_OUT;
             continue;
         }
 
-        add_list_item(data->visitedAirportInfos, destinationInfo);
+        print_airport_info(data, destinationInfo);
     }
 
-    if (connFailureFlag == true) {
+    if (timedOut) {
+        return ROC_CONTROL_TIMED_OUT;
+    } else if (connFailureFlag == true) {
         return ROC_CONTROL_CONN_FAILURE;
     }
 
@@ -185,60 +466,190 @@ RocError visit_destinations(Plane* data) {
 }
 
 /**
- * A wrapper around snprintf. 
+ * Makes room in this roc2310's data for a batch of destinations.
  * 
- * For use with printing List structs of type VisitedAirportInfo (aka char*).
+ * Parameters:
+ *  - data -> this roc2310 instance's data
+ *  - capacity -> the most destinations that will be in one batch
+ */
+void setup_destination_ports(Plane* data, int capacity) {
+    data->destinationPorts = calloc(capacity, sizeof(char*));
+    data->resolvedPorts = calloc(capacity, sizeof(char*));
+    for (int i = 0; i < capacity; i++) {
+        data->resolvedPorts[i] = calloc(6, sizeof(char));
+    }
+}
+
+/**
+ * Reads the next batch of destinations from a route file, one destination per
+ * line. Blank lines are skipped.
  * 
  * Parameters:
- *  - buffer -> the buffer to write to using snprintf
- *  - capacity -> the size of the buffer
- *  - toConvert -> the item to be converted to a string
+ *  - route -> the route file being read
  * 
  * Returns:
- *  - The output of snprintf. Which is the number of characters written to the
- *      buffer excluding the null terminator. If the number of characters to be
- *      written is greater than the capacity then, the write is truncated and
- *      the number of characters that would have been written is returned.
+ *  - The number of destinations read into route->destinations, which is 0
+ *      once the whole route has been read.
  */
-int visited_airport_info_to_string(char* buffer, size_t capacity, 
-        void* toConvert) {
-    return snprintf(buffer, capacity, "%s", (char*) toConvert);
+int read_route_batch(Route* route) {
+    int numRead = 0;
+    while (route->moreInput && numRead < ROUTE_BATCH_SIZE) {
+        route->moreInput = get_line(&route->destinations[numRead],
+                &route->capacities[numRead], route->from);
+        if (strlen(route->destinations[numRead]) > 0) {
+            numRead++;
+        }
+    }
+
+    return numRead;
 }
 
 /**
- * A wrapper around strcmp. 
+ * Flies a route read from a file (or stdin) rather than from the args. The
+ * route is read, converted and visited ROUTE_BATCH_SIZE destinations at a
+ * time, so a route of any length uses the same memory and the first infos
+ * are printed before the rest of the route has been read.
  * 
- * For use with searching and sorting List structs of type VisitedAirportInfo
- * (aka char*).
+ * Unlike a route given in the args, the destinations in batches before one
+ * that can't be converted to a port have already been visited by the time it
+ * is found.
  * 
  * Parameters:
- *  - item1 -> the first item to compare
- *  - item2 -> the second item to compare
+ *  - data -> this roc2310 instance's data
+ *  - route -> the route file to read
  * 
  * Returns:
- *  - negative integer -> if item1 < item2
- *  - zero -> if item1 == item2
- *  - positive integer -> if item1 > item2
+ *  - ROC_CONTROL_TIMED_OUT or ROC_CONTROL_CONN_FAILURE -> if visiting any of
+ *      the control2310s failed, as for visit_destinations, but the whole
+ *      route was flown
+ *  - ROC_OK -> if every destination was visited
+ *  - any error from convert_destination_airports, as soon as it happens
  */
-int visited_airport_info_compare(const void* item1, const void* item2) {
-    return strcmp(*(char* const*) item1, *(char* const*) item2);
+RocError fly_route_file(Plane* data, Route* route) {
+    setup_destination_ports(data, ROUTE_BATCH_SIZE);
+    route->destinations = calloc(ROUTE_BATCH_SIZE, sizeof(char*));
+    route->capacities = calloc(ROUTE_BATCH_SIZE, sizeof(size_t));
+    for (int i = 0; i < ROUTE_BATCH_SIZE; i++) {
+        route->capacities[i] = 80;
+        route->destinations[i] = calloc(route->capacities[i], sizeof(char));
+    }
+    route->moreInput = true;
+
+    RocError visitError = ROC_OK;
+    int numDestinations;
+    while ((numDestinations = read_route_batch(route)) > 0) {
+        RocError error = convert_destination_airports(route->destinations,
+                numDestinations, data);
+        if (error != ROC_OK) {
+            return error;
+        }
+        // A timeout is reported over any other failed visit
+        error = visit_destinations(data);
+        if (error != ROC_OK && visitError != ROC_CONTROL_TIMED_OUT) {
+            visitError = error;
+        }
+        data->firstDestination += numDestinations;
+    }
+
+    return visitError;
 }
 
 /**
- * Prints the infos for all of the airports (control2310s) visited by this
- * roc2310. As stored in data.
+ * Reads the options given to this roc2310 instance into its data. Any
+ * deadline is counted from when this function is called.
  * 
  * Parameters:
- *  - data -> this roc2310 instance's data
+ *  - argc -> a pointer to the argc of this roc2310 instance
+ *  - argv -> a pointer to the args of this roc2310 instance. The options are
+ *      removed from the front of the args.
+ *  - data -> the data of this roc2310 instance
+ *  - fleet -> where to store the fleet simulation options
+ *  - fleetPath -> where to store the fleet file, or NULL if no fleet is to
+ *      be simulated
+ *  - routePath -> where to store the route file, or NULL if the route is in
+ *      the args
+ *  - timingPath -> where to store the timing file, or NULL if timings
+ *      aren't wanted
+ * 
+ * Returns:
+ *  - ROC_INVALID_NUM_ARGS -> if an option is given an invalid value, or
+ *      "--fast-open" is given with "--connect-timeout"
+ *  - ROC_OK -> if every option given is valid
  */
-void print_airport_infos(Plane* data) {
-    char* buffer = calloc(1, sizeof(char));
-    size_t capacity = 1;
-    get_list_as_str(data->visitedAirportInfos, &buffer, &capacity);
+RocError parse_roc_options(int* argc, char*** argv, Plane* data,
+        Fleet* fleet, char** fleetPath, char** routePath, char** timingPath) {
+    Option options[NUM_ROC_OPTIONS] = {
+        [ROC_PARALLEL_OPTION] = {"parallel", NULL, false},
+        [ROC_CONNECT_TIMEOUT_OPTION] = {"connect-timeout", NULL, false},
+        [ROC_IO_TIMEOUT_OPTION] = {"io-timeout", NULL, false},
+        [ROC_DEADLINE_OPTION] = {"deadline", NULL, false},
+        [ROC_HEDGE_DELAY_OPTION] = {"hedge-delay", NULL, false},
+        [ROC_CONCURRENCY_OPTION] = {"concurrency", NULL, false},
+        [ROC_RATE_OPTION] = {"rate", NULL, false},
+        [ROC_FAST_OPEN_OPTION] = {"fast-open", NULL, false},
+        [ROC_FLEET_OPTION] = {"fleet", NULL, false},
+        [ROC_ROUTE_OPTION] = {"route", NULL, false},
+        [ROC_TIMING_OPTION] = {"timing", NULL, false}
+    };
+    parse_terminated_options(argc, argv, options, NUM_ROC_OPTIONS);
+
+    long values[NUM_ROC_OPTIONS] = {1, NO_TIMEOUT, NO_TIMEOUT, NO_TIMEOUT,
+            DEFAULT_HEDGE_DELAY_MS, DEFAULT_FLEET_CONCURRENCY, 0};
+    long maximums[NUM_ROC_OPTIONS] = {MAX_PARALLEL_VISITS, MAX_TIMEOUT_MS,
+            MAX_TIMEOUT_MS, MAX_TIMEOUT_MS, MAX_TIMEOUT_MS,
+            MAX_FLEET_CONCURRENCY, MAX_FLEET_RATE};
+    for (int i = 0; i <= ROC_LAST_NUMERIC_OPTION; i++) {
+        if (options[i].present && !parse_option_long(&options[i], 1,
+                maximums[i], &values[i])) {
+            return ROC_INVALID_NUM_ARGS;
+        }
+    }
+
+    if (options[ROC_FAST_OPEN_OPTION].present) {
+        // A Fast Open connect returns before the handshake, so a connect
+        // timeout would never be applied
+        if (options[ROC_FAST_OPEN_OPTION].value != NULL ||
+                options[ROC_CONNECT_TIMEOUT_OPTION].present) {
+            return ROC_INVALID_NUM_ARGS;
+        }
+        set_client_fast_open(true);
+    }
+    *fleetPath = NULL;
+    if (options[ROC_FLEET_OPTION].present) {
+        if (options[ROC_FLEET_OPTION].value == NULL) {
+            return ROC_INVALID_NUM_ARGS;
+        }
+        *fleetPath = options[ROC_FLEET_OPTION].value;
+    }
+    *routePath = NULL;
+    if (options[ROC_ROUTE_OPTION].present) {
+        if (options[ROC_ROUTE_OPTION].value == NULL) {
+            return ROC_INVALID_NUM_ARGS;
+        }
+        *routePath = options[ROC_ROUTE_OPTION].value;
+    }
+    *timingPath = NULL;
+    if (options[ROC_TIMING_OPTION].present) {
+        if (options[ROC_TIMING_OPTION].value == NULL) {
+            return ROC_INVALID_NUM_ARGS;
+        }
+        *timingPath = options[ROC_TIMING_OPTION].value;
+    }
 
-    if (strlen(buffer) > 0) {
-        send_message(stdout, buffer);
+    data->maxParallelVisits = values[ROC_PARALLEL_OPTION];
+    data->timeouts.connectMs = values[ROC_CONNECT_TIMEOUT_OPTION];
+    data->timeouts.ioMs = values[ROC_IO_TIMEOUT_OPTION];
+    data->mappers = calloc(1, sizeof(MapperPool));
+    data->mappers->hedgeDelayMs = values[ROC_HEDGE_DELAY_OPTION];
+    data->timeouts.deadlineNs = NO_TIMEOUT;
+    if (options[ROC_DEADLINE_OPTION].present) {
+        data->timeouts.deadlineNs = get_monotonic_ns() +
+                values[ROC_DEADLINE_OPTION] * NS_PER_MS;
     }
+    fleet->concurrency = values[ROC_CONCURRENCY_OPTION];
+    fleet->rate = values[ROC_RATE_OPTION];
+
+    return ROC_OK;
 }
 
 /**
@@ -246,46 +657,105 @@ void print_airport_infos(Plane* data) {
  * 
  * Starts a roc2310 instance, connects to the mapper2310's provided port and
  * converts all of the control2310 provided ports. Then, connects to each
- * provided control2310 and prints their "info" strings.
+ * provided control2310 and prints their "info" strings as they arrive.
+ * 
+ * Options go before the spec's arguments and are ended by "--", as in
+ * "roc2310 --parallel=4 -- id mapper {airports}", see
+ * parse_terminated_options. Without the "--" every argument means what the
+ * spec says, even if it looks like an option.
+ *
+ * If "--parallel=N" is given then up to N control2310s are visited at once.
+ * Their infos are still printed in route order. If the mapper is given as a
+ * comma separated list of ports, lookups are hedged across those mappers
+ * after "--hedge-delay=MS". With "--route=FILE" the destinations are read
+ * from FILE (or stdin if FILE is "-") instead of the args, see
+ * fly_route_file. With "--fleet=FILE" the only positional argument is the
+ * mapper, and every plane in FILE is simulated (see fleet.c). With
+ * "--timing=FILE" a line is written to FILE (or stderr if FILE is "-") for
+ * each phase of the flight, see record_timing; it can't be used with
+ * "--fleet", which reports its own latencies. The timeout
+ * options are described in roc2310.h; a mapper2310 that times out is treated
+ * as a failed mapper connection and a control2310 that times out as a failed
+ * destination.
+ *
+ * SIGPIPE is ignored, so that writing to a mapper2310 or control2310 that
+ * has gone away fails that write instead of killing the roc2310.
  */
 int main(int argc, char** argv) {
     int error = ROC_OK;
+    signal(SIGPIPE, SIG_IGN);
 
+    Plane* data = calloc(1, sizeof(Plane));
+    data->timing.startNs = get_monotonic_ns();
+    Fleet* fleet = calloc(1, sizeof(Fleet));
+    char* fleetPath;
+    char* routePath;
+    char* timingPath;
+    error = parse_roc_options(&argc, &argv, data, fleet, &fleetPath,
+            &routePath, &timingPath);
+    if (error != ROC_OK) {
+        handle_roc_error(error);
+    }
+
+    // Timings are written as they happen, so they're there even if the
+    // flight fails part way
+    if (timingPath != NULL) {
+        data->timing.to = strcmp("-", timingPath) == 0 ? stderr :
+                fopen(timingPath, "w");
+        if (data->timing.to == NULL || fleetPath != NULL) {
+            handle_roc_error(ROC_INVALID_NUM_ARGS);
+        }
+        fprintf(data->timing.to, "%s\n", TIMING_HEADER);
+    }
+
+    // A fleet simulation only takes the mapper as a positional argument
+    if (fleetPath != NULL) {
+        if (argc != 2) {
+            handle_roc_error(ROC_INVALID_NUM_ARGS);
+        }
+        handle_roc_error(fly_fleet(fleetPath, argv[1], fleet, data));
+        return ROC_OK;
+    }
+
+    // A route file replaces the destinations in the args
+    Route route;
+    if (routePath != NULL) {
+        if (argc != 3) {
+            handle_roc_error(ROC_INVALID_NUM_ARGS);
+        }
+        route.from = strcmp("-", routePath) == 0 ? stdin :
+                fopen(routePath, "r");
+        if (route.from == NULL) {
+            handle_roc_error(ROC_INVALID_NUM_ARGS);
+        }
+    }
     if (argc < 3) {
         handle_roc_error(ROC_INVALID_NUM_ARGS);
     }
 
-    Client* mapperConnection = calloc(1, sizeof(Client));
-    error = connect_to_mapper(argc, argv, mapperConnection);
+    error = connect_to_mapper(argc, argv, data->mappers, &data->timeouts,
+            &data->timing);
     if (error != ROC_OK) {
         handle_roc_error(error);
     }
-
-    Plane* data = calloc(1, sizeof(Plane));
     data->id = argv[1];
-    data->numDestinations = argc - 3;
-    data->destinationPorts = calloc(data->numDestinations, sizeof(char*));
-    data->mapperConnection = mapperConnection;
-
-    data->visitedAirportInfos = calloc(1, sizeof(List));
-    create_list(data->visitedAirportInfos, sizeof(VisitedAirportInfo),
-            visited_airport_info_to_string, visited_airport_info_compare);
 
-    error = convert_destination_airports(argc, argv, data);
-    if (error != ROC_OK) {
-        handle_roc_error(ROC_MAPPER_NO_ENTRY);
+    if (routePath != NULL) {
+        error = fly_route_file(data, &route);
+    } else {
+        setup_destination_ports(data, argc - 3);
+        error = convert_destination_airports(argv + 3, argc - 3, data);
+        if (error != ROC_OK) {
+            handle_roc_error(error);
+        }
+        // Keep visiting destinations even if connecting to one of them
+        // fails, and only then exit with the error
+        error = visit_destinations(data);
     }
 
-    // Exit with error after printing a log of the destinations visited if
-    // an error is encountered in visit_destinations.
-    // This is so that the roc continues to visit destinations even if
-    // connecting to one of the provided control2310s fails.
-    error = visit_destinations(data);
-    print_airport_infos(data);
-
     if (error != ROC_OK) {
-        handle_roc_error(ROC_CONTROL_CONN_FAILURE);
+        handle_roc_error(error);
     }
 
     return ROC_OK;
-}
\ No newline at end of file
+}
@@ -1,36 +1,168 @@
 #ifndef ROC_2310_H
+#define ROC_2310_H
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <pthread.h>
+#include <signal.h>
 
 #include "error.h"
 #include "client.h"
-#include "list.h"
 #include "utils.h"
+#include "options.h"
+#include "lookup.h"
 
+/* The most destinations that may be visited at once */
+#define MAX_PARALLEL_VISITS 256
+/* The longest timeout or deadline in milliseconds (one day) */
+#define MAX_TIMEOUT_MS 86400000
+/* The number of destinations read from a route file at a time */
+#define ROUTE_BATCH_SIZE 256
+/* The first line written to a --timing file, naming its columns */
+#define TIMING_HEADER "phase,destination,target,start_ns,elapsed_ns,result"
+
+/**
+ * The options understood by roc2310, as indices into its Option array.
+ *  - --parallel=N -> visit up to N destinations at once
+ *  - --connect-timeout=MS -> give up on a connection after MS milliseconds
+ *  - --io-timeout=MS -> give up on a single read or write after MS
+ *      milliseconds
+ *  - --deadline=MS -> give up on anything still blocking MS milliseconds
+ *      after the roc2310 started
+ *  - --hedge-delay=MS -> when several mappers are given, also ask a second
+ *      mapper if the first hasn't replied within MS milliseconds
+ *  - --concurrency=N -> with --fleet, fly up to N planes at once
+ *  - --rate=N -> with --fleet, launch N planes per second
+ *  - --fast-open -> use TCP Fast Open for connections where available. It
+ *      can't be used with --connect-timeout, as the handshake is only done
+ *      once the first message is written, which --io-timeout covers instead.
+ *  - --fleet=FILE -> simulate every plane in FILE instead, see fleet.c
+ *  - --route=FILE -> read the destinations from FILE, one per line, instead
+ *      of the args. FILE may be "-" for stdin.
+ *  - --timing=FILE -> write how long each phase of the flight took to FILE,
+ *      see record_timing. FILE may be "-" for stderr.
+ * The options after ROC_LAST_NUMERIC_OPTION don't take numeric values.
+ */
+enum RocOption {
+    ROC_PARALLEL_OPTION,
+    ROC_CONNECT_TIMEOUT_OPTION,
+    ROC_IO_TIMEOUT_OPTION,
+    ROC_DEADLINE_OPTION,
+    ROC_HEDGE_DELAY_OPTION,
+    ROC_CONCURRENCY_OPTION,
+    ROC_RATE_OPTION,
+    ROC_LAST_NUMERIC_OPTION = ROC_RATE_OPTION,
+    ROC_FAST_OPEN_OPTION,
+    ROC_FLEET_OPTION,
+    ROC_ROUTE_OPTION,
+    ROC_TIMING_OPTION,
+    NUM_ROC_OPTIONS
+};
+
+typedef struct Timing Timing;
 typedef struct Plane Plane;
+typedef struct VisitQueue VisitQueue;
+typedef struct Route Route;
 typedef char* VisitedAirportInfo;
 
+/**
+ * Where a roc2310 reports how long each phase of its flight took, one line
+ * per phase. See record_timing.
+ * Members:
+ *  - to -> the file to write the timings to, or NULL if they aren't wanted
+ *  - startNs -> the get_monotonic_ns() time that every phase's start is
+ *      given relative to
+ */
+struct Timing {
+    FILE* to;
+    long long startNs;
+};
+
 /**
  * A struct to store all of the data for a roc2310 instance.
  * Members:
  *  - id -> the id of this roc2310 instance
- *  - numDestinations -> the total number of control2310s that this roc2310
- *      has to visit/connect to
- *  - destinationPorts -> the ports for all of the control2310s this roc2310
- *      has to connect to
- *  - mapperConnection -> contains the file descriptors and files after
- *      a connection to a mapper2310 is made.
- *  - visitedAirportInfos -> a list of all visited airports' info strings.
- *      That is, a list of all control2310s' infos that were connected to.
+ *  - numDestinations -> the number of control2310s in the batch of the
+ *      route currently being flown
+ *  - destinationPorts -> the ports of the control2310s in the current batch
+ *  - resolvedPorts -> buffers for the ports given by the mapper2310 for the
+ *      current batch. destinationPorts points into these for any destination
+ *      given as an id.
+ *  - mappers -> contains the connections to each mapper2310 once they are
+ *      made. More than one mapper2310 can be given as a comma separated list
+ *      of ports, in which case lookups are hedged across them.
+ *  - numVisited -> the number of airports whose info has been printed
+ *  - holdingEmptyInfo -> whether an empty first info is waiting to be
+ *      printed, see print_airport_info
+ *  - maxParallelVisits -> the most destinations that may be visited at the
+ *      same time. 1 visits each destination one after another.
+ *  - timeouts -> the limits on how long any connection to a mapper2310 or
+ *      control2310 may block for
+ *  - timing -> where to report how long each phase of the flight took
+ *  - firstDestination -> the index in the whole route of the first
+ *      destination in the current batch
  */
 struct Plane {
     char* id;
     int numDestinations;
     char** destinationPorts;
-    Client* mapperConnection;
-    List* visitedAirportInfos;
+    char** resolvedPorts;
+    MapperPool* mappers;
+    int numVisited;
+    bool holdingEmptyInfo;
+    int maxParallelVisits;
+    ClientTimeouts timeouts;
+    Timing timing;
+    int firstDestination;
 };
 
+/**
+ * The destinations left to visit, shared between the threads visiting
+ * destinations concurrently.
+ * Members:
+ *  - plane -> the roc2310 instance's data
+ *  - nextDestination -> the index of the next destination to be visited
+ *  - nextToPrint -> the index of the next destination whose info is to be
+ *      printed
+ *  - destinationInfos -> each destination's info, in route order. An entry
+ *      is left NULL if connecting to that destination failed.
+ *  - finished -> whether each destination has finished being visited
+ *  - connFailure -> whether connecting to any destination failed
+ *  - timedOut -> whether visiting any destination timed out
+ *  - lock -> regulates access to every other member
+ */
+struct VisitQueue {
+    Plane* plane;
+    int nextDestination;
+    int nextToPrint;
+    VisitedAirportInfo* destinationInfos;
+    bool* finished;
+    bool connFailure;
+    bool timedOut;
+    pthread_mutex_t lock;
+};
+
+/**
+ * A route file being read a batch at a time.
+ * Members:
+ *  - from -> the file the route is read from
+ *  - moreInput -> false once the end of the file has been reached
+ *  - destinations -> buffers for the ids or ports of the current batch
+ *  - capacities -> the capacity of each buffer in destinations
+ */
+struct Route {
+    FILE* from;
+    bool moreInput;
+    char** destinations;
+    size_t* capacities;
+};
+
+/* See roc2310.c */
+void record_timing(Timing* timing, const char* phase, int destination,
+        char* target, long long startNs, const char* result);
+RocError visit_destination(char* id, char* destinationPort,
+        char* destinationInfo, ClientTimeouts* timeouts, Timing* timing,
+        int destination);
+
 #endif
\ No newline at end of file
@@ -27,8 +27,10 @@ ServerError setup_server(Server* server) {
         // create a socket and bind it to a port
     int serv = socket(AF_INET, SOCK_STREAM, 0); // 0 == use default protocol
     if (bind(serv, (struct sockaddr*)ai->ai_addr, sizeof(struct sockaddr))) {
+        freeaddrinfo(ai);
         return SERVER_NOT_OK;
     }
+    freeaddrinfo(ai);
     
         // Which port did we get?
     struct sockaddr_in ad;
@@ -38,6 +40,11 @@ ServerError setup_server(Server* server) {
         return SERVER_NOT_OK;
     }
 
+    // Let clients that use TCP Fast Open send their first message with the
+    // SYN. This is a no-op if the kernel doesn't allow it.
+    int fastOpenQueue = FAST_OPEN_QUEUE_LENGTH;
+    setsockopt(serv, IPPROTO_TCP, TCP_FASTOPEN, &fastOpenQueue, sizeof(int));
+
     if (listen(serv, 10)) {     // allow up to 10 connection requests to queue
         return SERVER_NOT_OK;
     }
@@ -48,12 +55,88 @@ ServerError setup_server(Server* server) {
     return SERVER_OK;
 }
 
+/**
+ * Sets the options used on every connection accepted on "port", then fires
+ * the connection__accept probe. Replies are short lines that are flushed as
+ * soon as they're written, so Nagle's algorithm is turned off to stop them
+ * being held back.
+ */
+static int set_connection_options(int connFd, int port) {
+    if (connFd >= 0) {
+        int enabled = 1;
+        setsockopt(connFd, IPPROTO_TCP, TCP_NODELAY, &enabled, sizeof(int));
+        TRACE2(connection__accept, connFd, port);
+    }
+    return connFd;
+}
+
 /**
  * Blocks until a connection is received on the socket stored in the
  * server->socket.
  */
 int connection_received(Server* server) {
-    return accept(server->socket, 0, 0);
+    return set_connection_options(accept(server->socket, 0, 0),
+            server->port);
+}
+
+/**
+ * Sets up "numServers" Servers, each on its own ephemeral port, and a single
+ * epoll instance that watches all of their sockets. This lets one thread
+ * accept connections for every Server in the group.
+ *
+ * If any Server fails to be set up then SERVER_NOT_OK is returned, otherwise
+ * SERVER_OK is returned.
+ */
+ServerError setup_server_group(ServerGroup* group, int numServers) {
+    group->servers = calloc(numServers, sizeof(Server));
+    group->numServers = numServers;
+    group->pollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (group->servers == NULL || group->pollFd < 0) {
+        return SERVER_NOT_OK;
+    }
+
+    for (int i = 0; i < numServers; i++) {
+        if (setup_server(&group->servers[i]) != SERVER_OK) {
+            return SERVER_NOT_OK;
+        }
+
+        // Remember which Server the socket belongs to so the accept loop
+        // doesn't need to search for it
+        struct epoll_event event;
+        memset(&event, 0, sizeof(struct epoll_event));
+        event.events = EPOLLIN;
+        event.data.u32 = i;
+        if (epoll_ctl(group->pollFd, EPOLL_CTL_ADD,
+                group->servers[i].socket, &event)) {
+            return SERVER_NOT_OK;
+        }
+    }
+
+    return SERVER_OK;
+}
+
+/**
+ * Blocks until a connection is received on any of the Servers in the group.
+ * The index of the Server that accepted the connection is written to
+ * serverIndex.
+ *
+ * Returns the file descriptor of the accepted connection, or a negative
+ * value if waiting for connections failed.
+ */
+int group_connection_received(ServerGroup* group, int* serverIndex) {
+    struct epoll_event event;
+    int numReady;
+    while (numReady = epoll_wait(group->pollFd, &event, 1, -1),
+            numReady <= 0) {
+        if (numReady < 0 && errno != EINTR) {
+            return -1;
+        }
+    }
+
+    *serverIndex = event.data.u32;
+    Server* server = &group->servers[*serverIndex];
+    return set_connection_options(accept(server->socket, 0, 0),
+            server->port);
 }
 
 /**
@@ -69,8 +152,200 @@ ServerError start_connection_handling_thread(
     args->data = data;
     args->connFd = connFd;
 
+    // Nothing ever joins the handler so let its resources be released as
+    // soon as it returns
     pthread_t tid;
-    pthread_create(&tid, NULL, handler, args);
+    if (pthread_create(&tid, NULL, handler, args)) {
+        free(args);
+        return SERVER_NOT_OK;
+    }
+    pthread_detach(tid);
+
+    return SERVER_OK;
+}
+
+/**
+ * Opens a Connection on an accepted socket: a file to read requests from, a
+ * file to write responses to, and the buffers reused by every request.
+ * 
+ * Returns SERVER_OK if the Connection was opened. Otherwise SERVER_NOT_OK is
+ * returned and the socket is closed.
+ */
+ServerError open_connection(int connFd, Connection* connection) {
+    memset(connection, 0, sizeof(Connection));
+    int readFd = dup(connFd);
+    connection->from = readFd < 0 ? NULL : fdopen(readFd, "r");
+    connection->to = fdopen(connFd, "w");
+    connection->line = calloc(CONNECTION_LINE_CAPACITY, sizeof(char));
+    connection->lineCapacity = CONNECTION_LINE_CAPACITY;
+    connection->scratch = malloc(CONNECTION_SCRATCH_CAPACITY);
+    connection->scratchCapacity = CONNECTION_SCRATCH_CAPACITY;
+    if (connection->from == NULL || connection->to == NULL ||
+            connection->line == NULL || connection->scratch == NULL) {
+        if (connection->from == NULL && readFd >= 0) {
+            close(readFd);
+        }
+        if (connection->to == NULL) {
+            close(connFd);
+        }
+        close_connection(connection);
+        return SERVER_NOT_OK;
+    }
+
+    return SERVER_OK;
+}
+
+/**
+ * Starts recording every line read from a Connection to a capture file,
+ * see capture.h. "server" is the index of the server (or airport) the
+ * connection was accepted by.
+ */
+void capture_connection(Connection* connection, Capture* capture,
+        int server) {
+    connection->capture = capture;
+    connection->captureId = record_capture_open(capture, server);
+}
+
+/**
+ * Captures the last line read from a Connection, if it's being captured,
+ * along with the number of lines sent in reply to it.
+ */
+static void capture_pending_line(Connection* connection) {
+    if (connection->capture == NULL || !connection->linePending) {
+        return;
+    }
+    record_capture_line(connection->capture, connection->captureId,
+            connection->lineReadNs, connection->pendingLine,
+            connection->replyLines);
+    connection->linePending = false;
+}
+
+/**
+ * Reads the next line from a Connection into connection->line, growing it
+ * if the line doesn't fit.
+ * 
+ * Returns true if there may be more lines to read, or false once the
+ * connection has been closed.
+ */
+bool read_connection_line(Connection* connection) {
+    // Every reply to the last line has been sent by the time the next one
+    // is wanted
+    capture_pending_line(connection);
+
+    bool moreInput = get_line(&connection->line, &connection->lineCapacity,
+            connection->from);
+    // The newline ending the line was read too
+    connection->bytesIn += strlen(connection->line) + (moreInput ? 1 : 0);
+    if (connection->capture != NULL && moreInput) {
+        connection->lineReadNs = get_monotonic_ns();
+        size_t length = strlen(connection->line) + 1;
+        if (length > connection->pendingLineCapacity) {
+            char* pendingLine = realloc(connection->pendingLine, length);
+            if (pendingLine == NULL) {
+                return moreInput;
+            }
+            connection->pendingLine = pendingLine;
+            connection->pendingLineCapacity = length;
+        }
+        memcpy(connection->pendingLine, connection->line, length);
+        connection->linePending = true;
+        connection->replyLines = 0;
+    }
+    return moreInput;
+}
+
+/**
+ * Adds printf style formatted output to the end of a Connection's scratch,
+ * growing it if the output doesn't fit. Nothing is written to the
+ * connection until send_connection_scratch is called.
+ * 
+ * Returns SERVER_OK if the output was added, or SERVER_NOT_OK if the scratch
+ * couldn't be grown to fit it.
+ */
+ServerError add_to_connection_scratch(Connection* connection,
+        const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    size_t available = connection->scratchCapacity - connection->scratchLength;
+    int length = vsnprintf(connection->scratch + connection->scratchLength,
+            available, format, args);
+    va_end(args);
+    if (length < 0) {
+        return SERVER_NOT_OK;
+    }
+
+    if ((size_t) length >= available) {
+        // Doubling the size is most efficient
+        size_t capacity = connection->scratchCapacity;
+        while (capacity - connection->scratchLength <= (size_t) length) {
+            capacity *= 2;
+        }
+        char* scratch = realloc(connection->scratch, capacity);
+        if (scratch == NULL) {
+            return SERVER_NOT_OK;
+        }
+        connection->scratch = scratch;
+        connection->scratchCapacity = capacity;
+
+        va_start(args, format);
+        vsnprintf(connection->scratch + connection->scratchLength,
+                capacity - connection->scratchLength, format, args);
+        va_end(args);
+    }
+    connection->scratchLength += length;
 
     return SERVER_OK;
-}
\ No newline at end of file
+}
+
+/**
+ * Writes everything in a Connection's scratch to the connection, flushes it
+ * and then empties the scratch, keeping its memory for the next response.
+ */
+void send_connection_scratch(Connection* connection) {
+    fwrite(connection->scratch, sizeof(char), connection->scratchLength,
+            connection->to);
+    fflush(connection->to);
+    connection->bytesOut += connection->scratchLength;
+    if (connection->capture != NULL) {
+        char* end = connection->scratch + connection->scratchLength;
+        for (char* next = connection->scratch;
+                (next = memchr(next, '\n', end - next)) != NULL; next++) {
+            connection->replyLines++;
+        }
+    }
+    connection->scratchLength = 0;
+}
+
+/**
+ * Writes a message to a Connection followed by a newline, then flushes it.
+ * Any output already in the connection's scratch is left there.
+ */
+void send_connection_message(Connection* connection, char* message) {
+    send_message(connection->to, message);
+    connection->bytesOut += strlen(message) + 1;
+    connection->replyLines++;
+}
+
+/**
+ * Closes a Connection and frees its buffers, firing the connection__close
+ * probe with the number of bytes read and written on it.
+ */
+void close_connection(Connection* connection) {
+    TRACE3(connection__close,
+            connection->to == NULL ? -1 : fileno(connection->to),
+            connection->bytesIn, connection->bytesOut);
+    if (connection->capture != NULL) {
+        capture_pending_line(connection);
+        record_capture_close(connection->capture, connection->captureId);
+    }
+    if (connection->from != NULL) {
+        fclose(connection->from);
+    }
+    if (connection->to != NULL) {
+        fclose(connection->to);
+    }
+    free(connection->line);
+    free(connection->scratch);
+    free(connection->pendingLine);
+    memset(connection, 0, sizeof(Connection));
+}
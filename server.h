@@ -1,4 +1,5 @@
 #ifndef PARALLEL_SERVER_H
+#define PARALLEL_SERVER_H
 
 #include <pthread.h>
 #include <netdb.h>
@@ -6,8 +7,23 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+/* The most TCP Fast Open connections that may wait to be accepted */
+#define FAST_OPEN_QUEUE_LENGTH 16
+/* The number of characters a Connection's line starts with room for */
+#define CONNECTION_LINE_CAPACITY 80
+/* The number of bytes a Connection's scratch starts with room for */
+#define CONNECTION_SCRATCH_CAPACITY 4096
 
 #include "utils.h"
+#include "trace.h"
+#include "capture.h"
 
 enum ServerError {
     SERVER_OK,
@@ -21,12 +37,70 @@ struct Server {
 };
 typedef struct Server Server;
 
+/**
+ * A ServerGroup is a set of Servers that share a single accept loop.
+ * Members:
+ *  - servers -> the Servers in this group, each on its own port
+ *  - numServers -> the number of Servers in this group
+ *  - pollFd -> the epoll instance watching every Server's socket
+ */
+struct ServerGroup {
+    Server* servers;
+    int numServers;
+    int pollFd;
+};
+typedef struct ServerGroup ServerGroup;
+
 struct ConnectionHandlerArgs {
     int connFd;
     void* data;
 };
 typedef struct ConnectionHandlerArgs ConnectionHandlerArgs;
 
+/**
+ * A Connection is an accepted connection along with the buffers that every
+ * request on it reuses, so that once they have grown to fit, handling a
+ * request doesn't need to allocate.
+ * Members:
+ *  - from -> the file to read requests from
+ *  - to -> the file to write responses to
+ *  - line -> the line most recently read from the connection
+ *  - lineCapacity -> the size of line
+ *  - scratch -> where a response is built up before it is sent
+ *  - scratchLength -> the number of bytes of scratch in use
+ *  - scratchCapacity -> the size of scratch
+ *  - bytesIn -> the number of bytes read from the connection so far
+ *  - bytesOut -> the number of bytes written to the connection so far
+ *  - capture -> where the lines read are recorded, or NULL if they aren't
+ *  - captureId -> the id the connection's lines are captured under
+ *  - linePending -> whether the last line read is still to be captured,
+ *      which happens once its reply has been sent
+ *  - pendingLine -> a copy of the last line read, as handling it may change
+ *      connection->line
+ *  - pendingLineCapacity -> the size of pendingLine
+ *  - lineReadNs -> the get_monotonic_ns() time the last line was read at
+ *  - replyLines -> the number of lines sent since the last line was read
+ */
+struct Connection {
+    FILE* from;
+    FILE* to;
+    char* line;
+    size_t lineCapacity;
+    char* scratch;
+    size_t scratchLength;
+    size_t scratchCapacity;
+    long long bytesIn;
+    long long bytesOut;
+    Capture* capture;
+    uint64_t captureId;
+    bool linePending;
+    char* pendingLine;
+    size_t pendingLineCapacity;
+    long long lineReadNs;
+    uint64_t replyLines;
+};
+typedef struct Connection Connection;
+
 /**
  * A ClientHandler takes a char* message to update and a void* struct 
  * to update using this message. It should return a server error.
@@ -35,7 +109,18 @@ typedef void* (*ConnectionHandler)(void*);
 
 ServerError setup_server(Server* server);
 int connection_received(Server* server);
+ServerError setup_server_group(ServerGroup* group, int numServers);
+int group_connection_received(ServerGroup* group, int* serverIndex);
 ServerError start_connection_handling_thread(
         ConnectionHandler handler, void* data, int connFd);
+ServerError open_connection(int connFd, Connection* connection);
+void capture_connection(Connection* connection, Capture* capture,
+        int server);
+bool read_connection_line(Connection* connection);
+ServerError add_to_connection_scratch(Connection* connection,
+        const char* format, ...);
+void send_connection_scratch(Connection* connection);
+void send_connection_message(Connection* connection, char* message);
+void close_connection(Connection* connection);
 
 #endif
\ No newline at end of file
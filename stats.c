@@ -0,0 +1,227 @@
+#include "stats.h"
+
+/* The percentiles of each request type's latency that are reported */
+static const double statsPercentiles[NUM_STATS_PERCENTILES] = {
+    50, 90, 99, 99.9
+};
+/* The names the percentiles in statsPercentiles are reported under */
+static const char* const statsPercentileNames[NUM_STATS_PERCENTILES] = {
+    "p50", "p90", "p99", "p999"
+};
+
+/* See stats.h */
+bool create_server_stats(ServerStats* stats, const char* const* requestNames,
+        int numRequestTypes) {
+    if (numRequestTypes > MAX_REQUEST_TYPES) {
+        return false;
+    }
+    memset(stats, 0, sizeof(ServerStats));
+    long numSlots = sysconf(_SC_NPROCESSORS_ONLN) * STATS_SLOTS_PER_CPU;
+    if (numSlots < 1) {
+        numSlots = 1;
+    } else if (numSlots > MAX_STATS_SLOTS) {
+        numSlots = MAX_STATS_SLOTS;
+    }
+    void* slots;
+    if (posix_memalign(&slots, STATS_CACHE_LINE_SIZE,
+            numSlots * sizeof(StatsSlot)) != 0) {
+        return false;
+    }
+    memset(slots, 0, numSlots * sizeof(StatsSlot));
+    stats->slots = slots;
+    stats->numSlots = numSlots;
+    for (int i = 0; i < numSlots; i++) {
+        pthread_mutex_init(&stats->slots[i].lock, NULL);
+    }
+    stats->requestNames = requestNames;
+    stats->numRequestTypes = numRequestTypes;
+
+    return true;
+}
+
+/* See stats.h */
+void open_thread_stats(ServerStats* stats, ThreadStats* thread) {
+    long long connection = __atomic_fetch_add(&stats->totalConnections, 1,
+            __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats->currentConnections, 1, __ATOMIC_RELAXED);
+
+    thread->slot = &stats->slots[connection % stats->numSlots];
+    thread->bytesIn = 0;
+    thread->bytesOut = 0;
+}
+
+/* See stats.h */
+void close_thread_stats(ServerStats* stats, ThreadStats* thread) {
+    __atomic_sub_fetch(&stats->currentConnections, 1, __ATOMIC_RELAXED);
+    thread->slot = NULL;
+}
+
+/**
+ * Adds every count and latency in "from" to "into". The caller must hold the
+ * lock of "from".
+ *
+ * Returns false if a latency Histogram couldn't be allocated in "into", in
+ * which case those latencies are left out.
+ */
+static bool add_slot_stats(StatsSlot* into, StatsSlot* from) {
+    bool added = true;
+    for (int i = 0; i < MAX_REQUEST_TYPES; i++) {
+        into->requests[i] += from->requests[i];
+        if (from->latencies[i] == NULL) {
+            continue;
+        }
+        if (into->latencies[i] == NULL) {
+            into->latencies[i] = malloc(sizeof(Histogram));
+            if (into->latencies[i] == NULL) {
+                added = false;
+                continue;
+            }
+            reset_histogram(into->latencies[i]);
+        }
+        merge_histogram(into->latencies[i], from->latencies[i]);
+    }
+    into->lockWaits += from->lockWaits;
+    into->lockWaitNs += from->lockWaitNs;
+    into->suppressedErrors += from->suppressedErrors;
+    into->bytesIn += from->bytesIn;
+    into->bytesOut += from->bytesOut;
+
+    return added;
+}
+
+/**
+ * Frees the latency Histograms of a StatsSlot.
+ */
+static void free_slot_latencies(StatsSlot* slot) {
+    for (int i = 0; i < MAX_REQUEST_TYPES; i++) {
+        free(slot->latencies[i]);
+    }
+}
+
+/* See stats.h */
+void start_request_stats(RequestStats* request, int type) {
+    memset(request, 0, sizeof(RequestStats));
+    request->type = type;
+    request->startNs = get_monotonic_ns();
+}
+
+/* See stats.h */
+void lock_counting_waits(pthread_mutex_t* lock, RequestStats* request) {
+    if (pthread_mutex_trylock(lock) != EBUSY) {
+        TRACE1(mutex__lock__acquire, lock);
+        return;
+    }
+
+    long long start = get_monotonic_ns();
+    pthread_mutex_lock(lock);
+    TRACE1(mutex__lock__acquire, lock);
+    request->lockWaits++;
+    request->lockWaitNs += get_monotonic_ns() - start;
+}
+
+/* See stats.h */
+void unlock_counted(pthread_mutex_t* lock) {
+    TRACE1(mutex__lock__release, lock);
+    pthread_mutex_unlock(lock);
+}
+
+/* See stats.h */
+void finish_request_stats(ThreadStats* thread, RequestStats* request,
+        Connection* connection) {
+    StatsSlot* slot = thread->slot;
+    if (slot == NULL) {
+        return;
+    }
+    long long elapsedNs = get_monotonic_ns() - request->startNs;
+
+    pthread_mutex_lock(&slot->lock);
+    slot->requests[request->type]++;
+    if (slot->latencies[request->type] == NULL) {
+        // Slots last as long as the server, so this only happens the first
+        // time a slot sees each type of request
+        Histogram* latencies = malloc(sizeof(Histogram));
+        if (latencies != NULL) {
+            reset_histogram(latencies);
+        }
+        slot->latencies[request->type] = latencies;
+    }
+    if (slot->latencies[request->type] != NULL) {
+        record_histogram_value(slot->latencies[request->type], elapsedNs);
+    }
+    slot->lockWaits += request->lockWaits;
+    slot->lockWaitNs += request->lockWaitNs;
+    slot->suppressedErrors += request->suppressedErrors;
+    slot->bytesIn += connection->bytesIn - thread->bytesIn;
+    slot->bytesOut += connection->bytesOut - thread->bytesOut;
+    pthread_mutex_unlock(&slot->lock);
+    thread->bytesIn = connection->bytesIn;
+    thread->bytesOut = connection->bytesOut;
+}
+
+/**
+ * Writes the count and latencies of one type of request to a Connection's
+ * scratch.
+ */
+static ServerError add_request_stats(Connection* connection, const char* name,
+        long long count, Histogram* latencies) {
+    ServerError error = add_to_connection_scratch(connection,
+            "requests_%s:%lld\n", name, count);
+    if (latencies == NULL || latencies->count == 0) {
+        return error;
+    }
+
+    error |= add_to_connection_scratch(connection, "latency_%s_mean_ns:%.0f\n",
+            name, get_histogram_mean(latencies));
+    for (int i = 0; i < NUM_STATS_PERCENTILES; i++) {
+        error |= add_to_connection_scratch(connection,
+                "latency_%s_%s_ns:%lld\n", name, statsPercentileNames[i],
+                get_histogram_percentile(latencies, statsPercentiles[i]));
+    }
+    error |= add_to_connection_scratch(connection, "latency_%s_max_ns:%lld\n",
+            name, latencies->max);
+
+    return error == SERVER_OK ? SERVER_OK : SERVER_NOT_OK;
+}
+
+/* See stats.h */
+ServerError add_server_stats(ServerStats* stats, Connection* connection) {
+    StatsSlot total;
+    memset(&total, 0, sizeof(StatsSlot));
+
+    long long currentConnections = __atomic_load_n(
+            &stats->currentConnections, __ATOMIC_RELAXED);
+    long long totalConnections = __atomic_load_n(&stats->totalConnections,
+            __ATOMIC_RELAXED);
+    for (int i = 0; i < stats->numSlots; i++) {
+        pthread_mutex_lock(&stats->slots[i].lock);
+        add_slot_stats(&total, &stats->slots[i]);
+        pthread_mutex_unlock(&stats->slots[i].lock);
+    }
+
+    // Every open connection has its own thread, as does the accept loop
+    ServerError error = add_to_connection_scratch(connection,
+            "connections_current:%lld\nconnections_total:%lld\n"
+            "threads:%lld\n", currentConnections, totalConnections,
+            currentConnections + 1);
+    for (int i = 0; i < stats->numRequestTypes; i++) {
+        error |= add_request_stats(connection, stats->requestNames[i],
+                total.requests[i], total.latencies[i]);
+    }
+    error |= add_to_connection_scratch(connection,
+            "lock_waits:%lld\nlock_wait_ns:%lld\nsuppressed_errors:%lld\n"
+            "bytes_in:%lld\nbytes_out:%lld\n", total.lockWaits,
+            total.lockWaitNs, total.suppressedErrors, total.bytesIn,
+            total.bytesOut);
+    free_slot_latencies(&total);
+
+    return error == SERVER_OK ? SERVER_OK : SERVER_NOT_OK;
+}
+
+/* See stats.h */
+void destroy_server_stats(ServerStats* stats) {
+    for (int i = 0; i < stats->numSlots; i++) {
+        free_slot_latencies(&stats->slots[i]);
+        pthread_mutex_destroy(&stats->slots[i].lock);
+    }
+    free(stats->slots);
+}
@@ -0,0 +1,197 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "server.h"
+#include "histogram.h"
+#include "utils.h"
+#include "trace.h"
+
+/* The most request types a server can count separately */
+#define MAX_REQUEST_TYPES 8
+/* The percentiles of each request type's latency that are reported */
+#define NUM_STATS_PERCENTILES 4
+/* The number of StatsSlots a server has per core */
+#define STATS_SLOTS_PER_CPU 2
+/* The most StatsSlots a server may have */
+#define MAX_STATS_SLOTS 64
+/* The size of a cache line, which each StatsSlot is aligned to */
+#define STATS_CACHE_LINE_SIZE 64
+
+typedef struct RequestStats RequestStats;
+typedef struct StatsSlot StatsSlot;
+typedef struct ThreadStats ThreadStats;
+typedef struct ServerStats ServerStats;
+
+/**
+ * What happened while a single request was being handled. It is only seen
+ * by the thread handling the request, so it can be updated freely and is
+ * added to the thread's StatsSlot in one go once the request is done.
+ * Members:
+ *  - type -> the index of the request's type in ServerStats.requestNames
+ *  - startNs -> the get_monotonic_ns() time the request started at
+ *  - lockWaits -> the number of times the request had to wait for a lock
+ *  - lockWaitNs -> the total time spent waiting for locks
+ *  - suppressedErrors -> the number of errors that were quietly ignored
+ */
+struct RequestStats {
+    int type;
+    long long startNs;
+    long long lockWaits;
+    long long lockWaitNs;
+    long long suppressedErrors;
+};
+
+/**
+ * The stats of some of a server's connections. A server has a fixed set of
+ * slots that last as long as it does, and each connection records into one
+ * of them, so opening or closing a connection doesn't allocate and the
+ * connections of different slots don't wait on each other.
+ * Members:
+ *  - lock -> regulates access to the rest of the members
+ *  - requests -> the number of requests handled of each type
+ *  - latencies -> the time taken to handle each type of request, or NULL
+ *      if no request of that type has been handled in this slot yet
+ *  - lockWaits -> the number of times a request had to wait for a lock
+ *  - lockWaitNs -> the total time requests spent waiting for locks
+ *  - suppressedErrors -> the number of errors that were quietly ignored
+ *  - bytesIn -> the number of bytes read from the connections
+ *  - bytesOut -> the number of bytes written to the connections
+ */
+struct StatsSlot {
+    pthread_mutex_t lock;
+    long long requests[MAX_REQUEST_TYPES];
+    Histogram* latencies[MAX_REQUEST_TYPES];
+    long long lockWaits;
+    long long lockWaitNs;
+    long long suppressedErrors;
+    long long bytesIn;
+    long long bytesOut;
+} __attribute__((aligned(STATS_CACHE_LINE_SIZE)));
+
+/**
+ * The stats of one connection handling thread, kept by that thread.
+ * Members:
+ *  - slot -> the StatsSlot the connection records into, or NULL if it
+ *      doesn't record anything
+ *  - bytesIn -> the number of bytes read that have been recorded so far
+ *  - bytesOut -> the number of bytes written that have been recorded so far
+ */
+struct ThreadStats {
+    StatsSlot* slot;
+    long long bytesIn;
+    long long bytesOut;
+};
+
+/**
+ * The stats of a whole server, kept in StatsSlots that every connection,
+ * open or closed, has recorded into. Nothing is added up until the stats are
+ * read.
+ * Members:
+ *  - requestNames -> the name of each type of request the server counts
+ *  - numRequestTypes -> the number of request types, at most
+ *      MAX_REQUEST_TYPES
+ *  - slots -> the slots connections record into
+ *  - numSlots -> the number of slots
+ *  - currentConnections -> the number of connections currently open
+ *  - totalConnections -> the number of connections ever opened, which also
+ *      picks the slot of the next connection
+ */
+struct ServerStats {
+    const char* const* requestNames;
+    int numRequestTypes;
+    StatsSlot* slots;
+    int numSlots;
+    long long currentConnections;
+    long long totalConnections;
+};
+
+/**
+ * Creates a ServerStats in the provided struct.
+ *
+ * Parameters:
+ *  - stats -> the buffer to write the ServerStats to
+ *  - requestNames -> the name of each type of request, as printed. These
+ *      aren't copied so must outlive the ServerStats.
+ *  - numRequestTypes -> the number of names in requestNames
+ *
+ * Returns:
+ *  - true if the ServerStats was created, or false if there are more than
+ *      MAX_REQUEST_TYPES request types or its slots couldn't be allocated.
+ */
+bool create_server_stats(ServerStats* stats, const char* const* requestNames,
+        int numRequestTypes);
+
+/**
+ * Counts a newly opened connection and gives it the next StatsSlot, round
+ * robin, to record into. Only the connection counts are updated, and with
+ * atomics, so this neither locks nor allocates.
+ *
+ * Parameters:
+ *  - stats -> the stats of the server the connection was made to
+ *  - thread -> where to set up the connection's ThreadStats
+ */
+void open_thread_stats(ServerStats* stats, ThreadStats* thread);
+
+/**
+ * Counts a connection as closed. Everything it did is already in its
+ * StatsSlot.
+ */
+void close_thread_stats(ServerStats* stats, ThreadStats* thread);
+
+/**
+ * Starts timing a request of the given type.
+ */
+void start_request_stats(RequestStats* request, int type);
+
+/**
+ * Locks a mutex, recording how long the request had to wait for it. Time is
+ * only measured if the mutex is already locked, so an uncontended lock costs
+ * no more than usual. The mutex__lock__acquire probe is fired once it is
+ * held.
+ */
+void lock_counting_waits(pthread_mutex_t* lock, RequestStats* request);
+
+/**
+ * Unlocks a mutex locked with lock_counting_waits, firing the
+ * mutex__lock__release probe just before it is released.
+ */
+void unlock_counted(pthread_mutex_t* lock);
+
+/**
+ * Adds a finished request to its thread's StatsSlot, along with the bytes the
+ * connection has read and written since the last request was added. The
+ * first request of each type in a slot allocates its latency Histogram.
+ *
+ * Parameters:
+ *  - thread -> the stats of the thread that handled the request
+ *  - request -> the request, as started by start_request_stats
+ *  - connection -> the connection the request was read from
+ */
+void finish_request_stats(ThreadStats* thread, RequestStats* request,
+        Connection* connection);
+
+/**
+ * Adds up the stats of every StatsSlot and writes them to a Connection's
+ * scratch as "NAME:VALUE" lines. Latencies are in nanoseconds.
+ *
+ * Returns:
+ *  - SERVER_OK if every line was added, or SERVER_NOT_OK if the scratch
+ *      couldn't be grown to fit them.
+ */
+ServerError add_server_stats(ServerStats* stats, Connection* connection);
+
+/**
+ * Frees everything held by a ServerStats. Every connection it was opened for
+ * must have been closed.
+ */
+void destroy_server_stats(ServerStats* stats);
+
+#endif
@@ -0,0 +1,280 @@
+#include "stringsort.h"
+
+/**
+ * Packs up to KEY_PREFIX_BYTES bytes of a string into a prefix, big endian,
+ * with any bytes after the end of the string left as 0.
+ */
+static uint64_t load_prefix(char* key) {
+    uint64_t prefix = 0;
+    bool ended = false;
+    for (int i = 0; i < KEY_PREFIX_BYTES; i++) {
+        unsigned char byte = ended ? 0 : (unsigned char) key[i];
+        ended = byte == '\0';
+        prefix = (prefix << 8) | byte;
+    }
+    return prefix;
+}
+
+/**
+ * Checks if a prefix reaches the end of its key. Keys can't contain a 0
+ * byte, so the key ended within the prefix exactly when its last byte is 0.
+ */
+static bool is_final_prefix(uint64_t prefix) {
+    return (prefix & 0xff) == 0;
+}
+
+/**
+ * Compares two entries whose prefixes were both loaded at "depth", only
+ * falling back to strcmp when the prefixes are equal.
+ */
+static int compare_entries(SortEntry* entry1, SortEntry* entry2, int depth) {
+    if (entry1->prefix != entry2->prefix) {
+        return entry1->prefix < entry2->prefix ? -1 : 1;
+    }
+    if (is_final_prefix(entry1->prefix)) {
+        return 0;
+    }
+    return strcmp(entry1->key + depth + KEY_PREFIX_BYTES,
+            entry2->key + depth + KEY_PREFIX_BYTES);
+}
+
+/**
+ * Swaps two entries.
+ */
+static void swap_entries(SortEntry* entry1, SortEntry* entry2) {
+    SortEntry swap = *entry1;
+    *entry1 = *entry2;
+    *entry2 = swap;
+}
+
+/**
+ * Insertion sorts a short range of entries whose prefixes were loaded at
+ * "depth".
+ */
+static void insertion_sort_entries(SortEntry* entries, int numEntries,
+        int depth) {
+    for (int i = 1; i < numEntries; i++) {
+        SortEntry entry = entries[i];
+        int j = i;
+        for (; j > 0 && compare_entries(&entry, &entries[j - 1], depth) < 0;
+                j--) {
+            entries[j] = entries[j - 1];
+        }
+        entries[j] = entry;
+    }
+}
+
+/**
+ * Gets the median of three prefixes, to use as a partition's pivot.
+ */
+static uint64_t median_prefix(uint64_t a, uint64_t b, uint64_t c) {
+    if (a < b) {
+        return b < c ? b : (a < c ? c : a);
+    }
+    return a < c ? a : (b < c ? c : b);
+}
+
+/**
+ * Multikey quicksort (Bentley and Sedgewick) working a whole cached prefix
+ * at a time instead of a single character. Each range is split three ways
+ * on its prefixes; the entries less than and greater than the pivot are
+ * sorted at the same depth, and the entries equal to it (which share their
+ * first depth + KEY_PREFIX_BYTES bytes) move on to the next prefix of their
+ * keys. Almost every comparison is between two integers in the entries
+ * themselves rather than through pointers to the keys.
+ *
+ * Parameters:
+ *  - entries -> the entries to sort, with prefixes loaded at "depth"
+ *  - numEntries -> the number of entries
+ *  - depth -> how many bytes of every key in the range are already known to
+ *      be the same
+ */
+static void multikey_quicksort(SortEntry* entries, int numEntries,
+        int depth) {
+    while (numEntries > STRING_SORT_INSERTION_LIMIT) {
+        uint64_t pivot = median_prefix(entries[0].prefix,
+                entries[numEntries / 2].prefix,
+                entries[numEntries - 1].prefix);
+
+        int less = 0;
+        int i = 0;
+        int greater = numEntries;
+        while (i < greater) {
+            if (entries[i].prefix < pivot) {
+                swap_entries(&entries[less++], &entries[i++]);
+            } else if (entries[i].prefix > pivot) {
+                swap_entries(&entries[i], &entries[--greater]);
+            } else {
+                i++;
+            }
+        }
+
+        multikey_quicksort(entries, less, depth);
+        multikey_quicksort(entries + greater, numEntries - greater, depth);
+        if (is_final_prefix(pivot)) {
+            return;
+        }
+
+        // The equal keys all carry on past this prefix, so move on to the
+        // next one without recursing
+        depth += KEY_PREFIX_BYTES;
+        for (int j = less; j < greater; j++) {
+            entries[j].prefix = load_prefix(entries[j].key + depth);
+        }
+        entries += less;
+        numEntries = greater - less;
+    }
+
+    insertion_sort_entries(entries, numEntries, depth);
+}
+
+/**
+ * Sorts the range of a SortTask from scratch, leaving the prefixes loaded at
+ * depth 0 so that the range can be merged afterwards. Made to be called as
+ * a function pointer in order to start a new thread.
+ */
+static void* sort_task_range(void* uncastedTask) {
+    SortTask* task = (SortTask*) uncastedTask;
+    SortEntry* entries = task->entries + task->start;
+    int numEntries = task->end - task->start;
+
+    multikey_quicksort(entries, numEntries, 0);
+    for (int i = 0; i < numEntries; i++) {
+        entries[i].prefix = load_prefix(entries[i].key);
+    }
+    return NULL;
+}
+
+/**
+ * Merges the two sorted ranges of a SortTask into scratch. Made to be called
+ * as a function pointer in order to start a new thread.
+ */
+static void* merge_task_ranges(void* uncastedTask) {
+    SortTask* task = (SortTask*) uncastedTask;
+    SortEntry* from = task->entries;
+    SortEntry* to = task->scratch;
+    int i = task->start;
+    int j = task->middle;
+    int k = task->start;
+    while (i < task->middle && j < task->end) {
+        if (compare_entries(&from[j], &from[i], 0) < 0) {
+            to[k++] = from[j++];
+        } else {
+            to[k++] = from[i++];
+        }
+    }
+    memcpy(to + k, from + i, (task->middle - i) * sizeof(SortEntry));
+    k += task->middle - i;
+    memcpy(to + k, from + j, (task->end - j) * sizeof(SortEntry));
+    return NULL;
+}
+
+/**
+ * Runs a function over every task, each on its own thread where possible.
+ * Any task whose thread couldn't be started is run on this thread instead.
+ */
+static void run_sort_tasks(void* (*run)(void*), SortTask* tasks,
+        int numTasks) {
+    pthread_t threads[MAX_SORT_THREADS];
+    bool started[MAX_SORT_THREADS];
+    for (int i = 1; i < numTasks; i++) {
+        started[i] = pthread_create(&threads[i], NULL, run, &tasks[i]) == 0;
+    }
+    run(&tasks[0]);
+    for (int i = 1; i < numTasks; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        } else {
+            run(&tasks[i]);
+        }
+    }
+}
+
+/**
+ * Sorts entries across several threads: each thread sorts an equal part,
+ * then neighbouring parts are merged in rounds (also in parallel) until one
+ * sorted range is left.
+ *
+ * Returns:
+ *  - true -> if the entries were sorted
+ *  - false -> if the scratch memory couldn't be allocated
+ */
+static bool parallel_sort_entries(SortEntry* entries, int numEntries,
+        int numThreads) {
+    SortEntry* scratch = calloc(numEntries, sizeof(SortEntry));
+    if (scratch == NULL) {
+        return false;
+    }
+
+    int bounds[MAX_SORT_THREADS + 1];
+    SortTask tasks[MAX_SORT_THREADS];
+    for (int i = 0; i <= numThreads; i++) {
+        bounds[i] = (int) ((long long) numEntries * i / numThreads);
+    }
+    for (int i = 0; i < numThreads; i++) {
+        tasks[i] = (SortTask) {entries, scratch, bounds[i], bounds[i],
+                bounds[i + 1]};
+    }
+    run_sort_tasks(sort_task_range, tasks, numThreads);
+
+    // Each round merges pairs of neighbouring parts, halving the number of
+    // parts. A part without a partner is merged on its own (just copied).
+    SortEntry* from = entries;
+    SortEntry* to = scratch;
+    for (int numParts = numThreads; numParts > 1;
+            numParts = (numParts + 1) / 2) {
+        int numTasks = 0;
+        for (int i = 0; i < numParts; i += 2) {
+            int end = i + 2 <= numParts ? bounds[i + 2] : bounds[i + 1];
+            tasks[numTasks++] = (SortTask) {from, to, bounds[i],
+                    bounds[i + 1], end};
+        }
+        run_sort_tasks(merge_task_ranges, tasks, numTasks);
+
+        for (int i = 0; i < numTasks; i++) {
+            bounds[i] = tasks[i].start;
+        }
+        bounds[numTasks] = numEntries;
+        SortEntry* swap = from;
+        from = to;
+        to = swap;
+    }
+
+    if (from != entries) {
+        memcpy(entries, from, numEntries * sizeof(SortEntry));
+    }
+    free(scratch);
+    return true;
+}
+
+/* See stringsort.h */
+bool sort_strings_by_key(void** items, int numItems, SortKey getKey,
+        int numThreads) {
+    SortEntry* entries = calloc(numItems, sizeof(SortEntry));
+    if (entries == NULL && numItems != 0) {
+        return false;
+    }
+    for (int i = 0; i < numItems; i++) {
+        entries[i].key = getKey(items[i]);
+        entries[i].prefix = load_prefix(entries[i].key);
+        entries[i].item = items[i];
+    }
+
+    if (numThreads > MAX_SORT_THREADS) {
+        numThreads = MAX_SORT_THREADS;
+    }
+    if (numThreads > 1 && numItems >= PARALLEL_SORT_THRESHOLD) {
+        if (!parallel_sort_entries(entries, numItems, numThreads)) {
+            free(entries);
+            return false;
+        }
+    } else {
+        multikey_quicksort(entries, numItems, 0);
+    }
+
+    for (int i = 0; i < numItems; i++) {
+        items[i] = entries[i].item;
+    }
+    free(entries);
+    return true;
+}
@@ -0,0 +1,85 @@
+#ifndef STRING_SORT_H
+#define STRING_SORT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+/* Below this many items a string sort runs on a single thread */
+#define PARALLEL_SORT_THRESHOLD 100000
+/* The most threads a string sort splits its work over */
+#define MAX_SORT_THREADS 64
+/* Ranges shorter than this are insertion sorted */
+#define STRING_SORT_INSERTION_LIMIT 16
+/* The number of bytes of each key cached alongside its item */
+#define KEY_PREFIX_BYTES 8
+
+typedef struct SortEntry SortEntry;
+typedef struct SortTask SortTask;
+
+/**
+ * A SortKey gets the string that an item is sorted by.
+ */
+typedef char* (*SortKey)(void* item);
+
+/**
+ * An item being sorted, along with its key and a cached prefix of the key.
+ * Members:
+ *  - prefix -> KEY_PREFIX_BYTES bytes of the key starting at the depth
+ *      currently being sorted on, packed big endian so that comparing
+ *      prefixes compares the bytes in order. Bytes past the end of the key
+ *      are 0.
+ *  - key -> the item's key
+ *  - item -> the item
+ */
+struct SortEntry {
+    uint64_t prefix;
+    char* key;
+    void* item;
+};
+
+/**
+ * A part of a parallel sort handed to one thread: either sorting a range of
+ * entries, or merging two sorted ranges that sit next to each other.
+ * Members:
+ *  - entries -> the entries to sort, or to merge from
+ *  - scratch -> where to merge to
+ *  - start -> the index of the first entry in the range
+ *  - middle -> where the second range to merge starts
+ *  - end -> the index after the last entry in the range
+ */
+struct SortTask {
+    SortEntry* entries;
+    SortEntry* scratch;
+    int start;
+    int middle;
+    int end;
+};
+
+/**
+ * Sorts an array of items into ascending order of their string keys (the
+ * same order as strcmp), using a multikey quicksort on cached key prefixes.
+ * Items with equal keys may be reordered.
+ *
+ * If there are at least PARALLEL_SORT_THRESHOLD items and numThreads is more
+ * than 1, the array is split between up to numThreads threads which each
+ * sort a part, and the parts are then merged together, again in parallel.
+ *
+ * Parameters:
+ *  - items -> the items to sort
+ *  - numItems -> the number of items
+ *  - getKey -> gets the key of an item
+ *  - numThreads -> the most threads to use, up to MAX_SORT_THREADS
+ *
+ * Returns:
+ *  - true -> if the items were sorted
+ *  - false -> if the memory for the sort couldn't be allocated, in which case
+ *      the items are unchanged
+ */
+bool sort_strings_by_key(void** items, int numItems, SortKey getKey,
+        int numThreads);
+
+#endif
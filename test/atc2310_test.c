@@ -0,0 +1,206 @@
+#include "atc2310_test.h"
+
+/* The number of checks that have failed */
+static int failures = 0;
+
+/**
+ * Reports a check that failed, unless "passed" is true.
+ *
+ * Parameters:
+ *  - passed -> whether the check passed
+ *  - description -> what was checked, as printed on failure
+ */
+static void check(bool passed, char* description) {
+    if (!passed) {
+        fprintf(stderr, "FAIL: %s\n", description);
+        failures++;
+    }
+}
+
+/**
+ * Checks that "text" was returned and is "expected", then frees it.
+ */
+static void check_text(char* text, char* expected, char* description) {
+    bool passed = text != NULL && strcmp(text, expected) == 0;
+    if (!passed) {
+        fprintf(stderr, "FAIL: %s: got \"%s\", expected \"%s\"\n",
+                description, text == NULL ? "(null)" : text, expected);
+        failures++;
+    }
+    free(text);
+}
+
+/**
+ * Counts the lines of "text", each of which ends with '\n', checking that
+ * they are in ascending order, then frees it.
+ *
+ * Returns:
+ *  - the number of lines, or -1 if text is NULL or out of order
+ */
+static int count_sorted_lines(char* text) {
+    if (text == NULL) {
+        return -1;
+    }
+    int lines = 0;
+    char* previous = NULL;
+    for (char* line = strtok(text, "\n"); line != NULL;
+            line = strtok(NULL, "\n")) {
+        if (previous != NULL && strcmp(previous, line) >= 0) {
+            free(text);
+            return -1;
+        }
+        previous = line;
+        lines++;
+    }
+    free(text);
+    return lines;
+}
+
+/**
+ * Tests adding to and searching an in-process mapper, and the rules it
+ * shares with "!ID:PORT" and "?ID".
+ */
+static void test_mapper(void) {
+    AtcMapper* mapper = atc_create_mapper();
+    check(mapper != NULL, "atc_create_mapper");
+    check_text(atc_get_mapper_airports(mapper), "", "an empty mapper");
+
+    check(atc_add_to_mapper(mapper, "BNE", 2310), "adding BNE");
+    check(atc_add_to_mapper(mapper, "ADL", 65536), "adding the top port");
+    check(!atc_add_to_mapper(mapper, "BNE", 2311), "adding BNE again");
+    check(!atc_add_to_mapper(mapper, "", 1), "adding an empty id");
+    check(!atc_add_to_mapper(mapper, "A:B", 1), "adding an id with ':'");
+    check(!atc_add_to_mapper(mapper, "A\nB", 1), "adding an id with '\\n'");
+    check(!atc_add_to_mapper(mapper, "SYD", 0), "adding port 0");
+    check(!atc_add_to_mapper(mapper, "SYD", 65537), "adding port 65537");
+    // Ids too long to be stored inline are kept elsewhere by the mapper
+    check(atc_add_to_mapper(mapper, "AIRPORT-WITH-A-VERY-LONG-ID", 7),
+            "adding a long id");
+
+    check(atc_search_mapper(mapper, "BNE") == 2310,
+            "BNE keeps the first port added");
+    check(atc_search_mapper(mapper, "ADL") == 65536, "searching for ADL");
+    check(atc_search_mapper(mapper, "AIRPORT-WITH-A-VERY-LONG-ID") == 7,
+            "searching for a long id");
+    check(atc_search_mapper(mapper, "SYD") == ATC_NOT_FOUND,
+            "searching for an id that was never added");
+    check(atc_search_mapper(mapper, "BN") == ATC_NOT_FOUND,
+            "searching for a prefix of an id");
+    check_text(atc_get_mapper_airports(mapper),
+            "ADL:65536\nAIRPORT-WITH-A-VERY-LONG-ID:7\nBNE:2310\n",
+            "the mapper's airports");
+
+    // Airports added after they were last listed are merged into the order
+    check(atc_add_to_mapper(mapper, "AAA", 1), "adding AAA");
+    check_text(atc_get_mapper_airports(mapper),
+            "AAA:1\nADL:65536\nAIRPORT-WITH-A-VERY-LONG-ID:7\nBNE:2310\n",
+            "the mapper's airports after another add");
+    atc_destroy_mapper(mapper);
+}
+
+/**
+ * Tests checking in to an in-process control and its visitor log, and the
+ * rules it shares with control2310.
+ */
+static void test_control(void) {
+    check(atc_create_control("A:B", "info") == NULL,
+            "creating a control with ':' in its id");
+    check(atc_create_control("BNE", "in\rfo") == NULL,
+            "creating a control with '\\r' in its info");
+
+    AtcControl* control = atc_create_control("BNE", "info");
+    check(control != NULL, "atc_create_control");
+    check_text(atc_get_visitor_log(control), "", "an empty visitor log");
+
+    const char* info = atc_check_in(control, "P2");
+    check(info != NULL && strcmp(info, "info") == 0,
+            "checking in gives the info");
+    check(atc_check_in(control, "P:3") == NULL, "checking in with ':'");
+    check(atc_check_in(control, "P1") != NULL, "checking in P1");
+    check(atc_check_in(control, "P2") != NULL, "checking in P2 again");
+    check_text(atc_get_visitor_log(control), "P1\nP2\nP2\n",
+            "the visitor log");
+    atc_destroy_control(control);
+
+    // As with "log", a log holding only an empty id has no lines
+    control = atc_create_control("BNE", "info");
+    check(atc_check_in(control, "") != NULL, "checking in an empty id");
+    check_text(atc_get_visitor_log(control), "",
+            "a log of only an empty id");
+    atc_destroy_control(control);
+}
+
+/**
+ * Adds and checks in TEST_IDS_PER_THREAD ids of its own, listing the
+ * mapper's airports part way through so that reads race with the adds.
+ */
+static void* add_test_ids(void* uncastedThread) {
+    TestThread* thread = (TestThread*) uncastedThread;
+    char id[TEST_ID_SIZE];
+    for (int i = 0; i < TEST_IDS_PER_THREAD; i++) {
+        // Every other id is too long to be inline
+        sprintf(id, i % 2 == 0 ? "T%d-%05d" : "THREAD-%d-WITH-LONG-ID-%05d",
+                thread->thread, i);
+        if (!atc_add_to_mapper(thread->mapper, id, i + 1) ||
+                atc_check_in(thread->control, id) == NULL) {
+            thread->failed = true;
+        }
+        if (i == TEST_IDS_PER_THREAD / 2 &&
+                count_sorted_lines(atc_get_mapper_airports(thread->mapper))
+                < i) {
+            thread->failed = true;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Tests that a mapper and control used by many threads at once lose
+ * nothing and stay sorted.
+ */
+static void test_concurrent(void) {
+    AtcMapper* mapper = atc_create_mapper();
+    AtcControl* control = atc_create_control("BNE", "info");
+    pthread_t threads[TEST_THREADS];
+    TestThread args[TEST_THREADS];
+    for (int i = 0; i < TEST_THREADS; i++) {
+        args[i] = (TestThread) {mapper, control, i, false};
+        pthread_create(&threads[i], NULL, add_test_ids, &args[i]);
+    }
+    for (int i = 0; i < TEST_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        check(!args[i].failed, "adding from many threads");
+    }
+
+    int total = TEST_THREADS * TEST_IDS_PER_THREAD;
+    check(count_sorted_lines(atc_get_mapper_airports(mapper)) == total,
+            "every airport added from many threads is listed in order");
+    check(count_sorted_lines(atc_get_visitor_log(control)) == total,
+            "every plane checked in from many threads is logged in order");
+    check(atc_search_mapper(mapper, "THREAD-3-WITH-LONG-ID-01999") == 2000,
+            "searching for an id added from another thread");
+    atc_destroy_control(control);
+    atc_destroy_mapper(mapper);
+}
+
+/**
+ * atc2310_test.
+ *
+ * Checks that the in-process mapper and control of libatc2310 behave as
+ * atc2310.h says, on their own and when used from many threads at once.
+ * Prints each check that fails.
+ *
+ * Returns EXIT_SUCCESS if every check passed.
+ */
+int main(int argc, char** argv) {
+    test_mapper();
+    test_control();
+    test_concurrent();
+
+    if (failures > 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("All checks passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,35 @@
+#ifndef ATC_2310_TEST_H
+#define ATC_2310_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "../atc2310.h"
+
+/* The number of threads the concurrent tests use */
+#define TEST_THREADS 4
+/* The number of ids each thread of the concurrent tests adds */
+#define TEST_IDS_PER_THREAD 2000
+/* The size of the buffer each id is written to */
+#define TEST_ID_SIZE 32
+
+/**
+ * The arguments of one thread of the concurrent tests.
+ * Members:
+ *  - mapper -> the mapper the thread adds to
+ *  - control -> the control the thread checks in to
+ *  - thread -> which thread this is, so that each adds different ids
+ *  - failed -> set by the thread if any of its calls failed
+ */
+struct TestThread {
+    AtcMapper* mapper;
+    AtcControl* control;
+    int thread;
+    bool failed;
+};
+typedef struct TestThread TestThread;
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+ * Statically defined tracepoints (USDT probes) that bpftrace, perf or
+ * SystemTap can attach to in a running mapper2310, control2310 or roc2310.
+ * Each probe is a single nop in the code until something attaches to it, so
+ * they are left in every build. If <sys/sdt.h> isn't available, or NO_TRACE
+ * is defined, the probes compile to nothing.
+ *
+ * Every probe is under the "atc2310" provider, for example
+ * "usdt:./mapper2310:atc2310:request__start". See trace/ for scripts that
+ * use them.
+ */
+
+#if defined(__has_include) && !defined(NO_TRACE)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define TRACE_ENABLED
+#endif
+#endif
+
+#ifdef TRACE_ENABLED
+#define TRACE1(name, arg1) DTRACE_PROBE1(atc2310, name, arg1)
+#define TRACE2(name, arg1, arg2) DTRACE_PROBE2(atc2310, name, arg1, arg2)
+#define TRACE3(name, arg1, arg2, arg3) \
+        DTRACE_PROBE3(atc2310, name, arg1, arg2, arg3)
+#else
+#define TRACE1(name, arg1) ((void) 0)
+#define TRACE2(name, arg1, arg2) ((void) 0)
+#define TRACE3(name, arg1, arg2, arg3) ((void) 0)
+#endif
+
+#endif
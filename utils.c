@@ -24,9 +24,17 @@ bool get_line(char** buffer, size_t* capacity, FILE* from) {
 
 /* See utils.h */
 bool read_message(FILE* from, char* messageBuffer) {
-    size_t cap = 80;
-    bool hasInput = get_line(&messageBuffer, &cap, from);
-    return hasInput;
+    size_t current = 0;
+    messageBuffer[0] = '\0';
+    int input;
+    while (input = fgetc(from), input != EOF && input != '\n') {
+        if (current < MESSAGE_BUFFER_SIZE - 1) {
+            messageBuffer[current] = (char) input;
+            messageBuffer[++current] = '\0';
+        }
+    }
+
+    return input != EOF;
 }
 
 /* See utils.h */
@@ -35,33 +43,111 @@ void send_message(FILE* to, char* message) {
     fflush(to);
 }
 
+/**
+ * Parses the digits at the start of text as a port.
+ * 
+ * Parameters:
+ *  - text -> the string starting with the port
+ *  - end -> where to write a pointer to the first character after the
+ *      digits
+ * 
+ * Returns:
+ *  - the port, which is 0 if there were no digits and more than HIGH_PORT
+ *      if it is too big to be valid
+ */
+static int parse_port_digits(char* text, char** end) {
+    int port = 0;
+    char* current = text;
+    for (; *current >= '0' && *current <= '9'; current++) {
+        // Stop adding digits once the port is too big to be valid, so that
+        // a long enough string can't overflow back into the valid range
+        if (port <= HIGH_PORT) {
+            port = port * BASE_10 + (*current - '0');
+        }
+    }
+
+    *end = current;
+    return port;
+}
+
 /* See utils.h */
 bool is_valid_port(char* unparsedPort) {
-    for (int i = 0; i < strlen(unparsedPort); i++) {
-        if (!isdigit(unparsedPort[i])) {
-            return false;
-        }
+    char* end;
+    int port = parse_port_digits(unparsedPort, &end);
+    return *end == '\0' && port >= LOW_PORT && port <= HIGH_PORT;
+}
+
+/* See utils.h */
+bool string_contains_invalid_char(char* checkString) {
+    return *find_invalid_char(checkString) != '\0';
+}
+
+#ifdef SCAN_IN_BLOCKS
+/**
+ * Gets a bit mask of the characters in a block that are '\n', '\r', ':' or
+ * '\0', with bit i set if character i is one of them.
+ */
+static unsigned int get_invalid_char_mask(__m128i block) {
+    __m128i matches = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('\n')),
+            _mm_cmpeq_epi8(block, _mm_set1_epi8('\r'))),
+            _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(':')),
+            _mm_cmpeq_epi8(block, _mm_setzero_si128())));
+    return (unsigned int) _mm_movemask_epi8(matches);
+}
+#endif
+
+/* See utils.h */
+char* find_invalid_char(char* text) {
+#ifdef SCAN_IN_BLOCKS
+    // Only aligned blocks are loaded. Memory is mapped in whole pages, and
+    // an aligned block never crosses into the next page, so a block holding
+    // any byte of the string lies entirely in mapped memory: reading past
+    // the terminator (or before text) can't fault. The bytes read past the
+    // terminator are never used, as the scan stops at the terminator's block,
+    // and any characters before text in the first block are masked off.
+    size_t offset = (uintptr_t) text % SCAN_BLOCK_SIZE;
+    __m128i* block = (__m128i*) (text - offset);
+    unsigned int mask = get_invalid_char_mask(_mm_load_si128(block)) >>
+            offset << offset;
+    while (mask == 0) {
+        block++;
+        mask = get_invalid_char_mask(_mm_load_si128(block));
     }
 
-    int parsedPort = strtol(unparsedPort, NULL, BASE_10);
-    if (parsedPort < LOW_PORT || parsedPort > HIGH_PORT) {
-        return false;
+    return (char*) block + __builtin_ctz(mask);
+#else
+    while (*text != '\0' && *text != '\n' && *text != '\r' &&
+            *text != ':') {
+        text++;
     }
 
-    return true; 
+    return text;
+#endif
 }
 
 /* See utils.h */
-bool string_contains_invalid_char(char* checkString) {
-    for (int i = 0; i < strlen(checkString); i++) {
-        if (checkString[i] == '\n') {
-            return true;
-        } else if (checkString[i] == '\r') {
-            return true;
-        } else if (checkString[i] == ':') {
-            return true;
-        }
+bool parse_id_port(char* text, StringView* id, int* port) {
+    char* separator = find_invalid_char(text);
+    if (*separator != ':' || separator == text) {
+        return false;
     }
 
-    return false;
+    char* end;
+    int parsedPort = parse_port_digits(separator + 1, &end);
+    if (*end != '\0' || parsedPort < LOW_PORT || parsedPort > HIGH_PORT) {
+        return false;
+    }
+
+    id->start = text;
+    id->length = separator - text;
+    *port = parsedPort;
+    return true;
 }
+
+/* See utils.h */
+long long get_monotonic_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * NS_PER_SECOND + now.tv_nsec;
+}
\ No newline at end of file
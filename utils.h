@@ -6,6 +6,23 @@
 #include <stdbool.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <time.h>
+
+/* find_invalid_char reads whole aligned blocks, which may run past the end
+ * of the string. That can't fault, but AddressSanitizer reports it, so
+ * sanitized builds check one character at a time instead */
+#ifdef __SANITIZE_ADDRESS__
+#define SCAN_SANITIZED
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define SCAN_SANITIZED
+#endif
+#endif
+#if defined(__SSE2__) && !defined(SCAN_SANITIZED)
+#define SCAN_IN_BLOCKS
+#include <emmintrin.h>
+#endif
 
 /* The lowest valid port */
 #define LOW_PORT 1
@@ -14,11 +31,22 @@
 /* strtol should use base 10 */
 #define BASE_10 10
 
+/* The size of the buffers read_message reads into */
+#define MESSAGE_BUFFER_SIZE 80
+
 /* Offset for get_line checking when it is about to reach buffer capacity */
 #define STRING_BUFFER_OFFSET 2
 /* How much to resize the buffer by when it reaches capacity */
 #define STRING_RESIZE_MULTIPLIER 1.5
 
+/* The number of bytes find_invalid_char looks at in one go */
+#define SCAN_BLOCK_SIZE 16
+
+/* The number of nanoseconds in a second */
+#define NS_PER_SECOND 1000000000LL
+/* The number of nanoseconds in a millisecond */
+#define NS_PER_MS 1000000LL
+
 /**
  * Gets a line from the provided file and writes it to the provided buffer
  * resizing the buffer as necessary.
@@ -35,11 +63,18 @@
 bool get_line(char** buffer, size_t* capacity, FILE* from);
 
 /**
- * Reads a message from the provided file.
+ * Reads a message from the provided file. The buffer is never resized, so
+ * only the first MESSAGE_BUFFER_SIZE - 1 characters of a longer line are
+ * kept and the rest of it is skipped.
  * 
  * Parameters:
  *  - from -> file to read input from
- *  - messageBuffer -> buffer to write single line of input to
+ *  - messageBuffer -> buffer of MESSAGE_BUFFER_SIZE characters to write a
+ *      single line of input to
+ * 
+ * Returns:
+ *  - true -> if there is more input to read
+ *  - false -> if eof has been reached
  */
 bool read_message(FILE* from, char* messageBuffer);
 
@@ -53,6 +88,19 @@ bool read_message(FILE* from, char* messageBuffer);
  */
 void send_message(FILE* to, char* message);
 
+/**
+ * A run of characters within a larger string. The run isn't necessarily
+ * terminated where it ends.
+ * Members:
+ *  - start -> the first character of the run
+ *  - length -> the number of characters in the run
+ */
+struct StringView {
+    char* start;
+    size_t length;
+};
+typedef struct StringView StringView;
+
 /**
  * Checks if the given port is a valid port. That is, unparsedPort > 0 
  * and <= 65536, and unparsedPort does not contain any non-numerical 
@@ -76,4 +124,38 @@ bool is_valid_port(char* unparsedPort);
  */
 bool string_contains_invalid_char(char* checkString);
 
+/**
+ * Finds the first character in a string that is invalid for airport IDs or
+ * airport info strings (see string_contains_invalid_char), or else the
+ * string's terminator. Where SSE2 is available SCAN_BLOCK_SIZE characters
+ * are checked at a time, unless built with AddressSanitizer.
+ * 
+ * Returns:
+ *  - a pointer to the first '\n', '\r', ':' or '\0' in text
+ */
+char* find_invalid_char(char* text);
+
+/**
+ * Parses an "ID:PORT" string in a single pass, checking that the ID is
+ * not empty and has no invalid characters and that the PORT is valid (see
+ * is_valid_port). Nothing is copied or changed: the ID is given as a view
+ * into text.
+ * 
+ * Parameters:
+ *  - text -> the "ID:PORT" string
+ *  - id -> where to write the view of the ID
+ *  - port -> where to write the parsed PORT
+ * 
+ * Returns:
+ *  - true -> if text is a valid "ID:PORT" and id and port were written
+ *  - false -> otherwise, in which case id and port are unchanged
+ */
+bool parse_id_port(char* text, StringView* id, int* port);
+
+/**
+ * Gets the current time of the monotonic clock in nanoseconds. Only the
+ * difference between two of these timestamps is meaningful.
+ */
+long long get_monotonic_ns(void);
+
 #endif
\ No newline at end of file